@@ -6,44 +6,219 @@
 #include <stdlib.h>
 
 #include "error.h"
+#include "frame_stats.h"
+#include "image.h"
 #include "log.h"
+#include "log_file.h"
 #include "memory.h"
+#include "metrics.h"
+#include "profile.h"
+#include "texture_cache.h"
 
-void start_application(void)
+#define FRAME_METRICS_WINDOW 120 // Frames the frame time metrics cover, two seconds at 60 Hz.
+
+static bool g_image_loader_started; // Only then does the frame loop dispatch image callbacks.
+
+// Puts name in the per-user preferences folder. Leaves path empty when SDL cannot provide the folder.
+static void get_pref_file_path(const char *name, char *path, const size_t path_size)
+{
+    path[0] = '\0';
+    char *pref_path = SDL_GetPrefPath("bodies", "bodies");
+    if (pref_path != NULL) {
+        SDL_snprintf(path, path_size, "%s%s", pref_path, name);
+        SDL_free(pref_path);
+    }
+}
+
+typedef struct frame_metric_t frame_metric_t;
+struct frame_metric_t
+{
+    const char *name;
+    frame_stat_t stat;
+    int32_t percentile; // 100 for the maximum.
+};
+
+static const frame_metric_t g_frame_metrics[] = {
+    { "frame_interval_p50_us", FRAME_STAT_INTERVAL, 50 },
+    { "frame_interval_p99_us", FRAME_STAT_INTERVAL, 99 },
+    { "frame_interval_max_us", FRAME_STAT_INTERVAL, 100 },
+    { "frame_cpu_p99_us", FRAME_STAT_CPU, 99 },
+    { "frame_swapchain_wait_p99_us", FRAME_STAT_SWAPCHAIN_WAIT, 99 },
+};
+
+static int64_t sample_frame_metric(void *user)
+{
+    const frame_metric_t *metric = user;
+
+    frame_stats_summary_t summary;
+    if (!frame_stats_summary(metric->stat, FRAME_METRICS_WINDOW, &summary)) {
+        return 0;
+    }
+
+    switch (metric->percentile) {
+    case 50:
+        return (int64_t)(summary.p50_ms * 1000.0);
+    case 95:
+        return (int64_t)(summary.p95_ms * 1000.0);
+    case 99:
+        return (int64_t)(summary.p99_ms * 1000.0);
+    default:
+        return (int64_t)(summary.max_ms * 1000.0);
+    }
+}
+
+static int64_t sample_frame_count(void *user)
+{
+    (void)user;
+    return (int64_t)frame_stats_frame_count();
+}
+
+static int64_t sample_log_dropped(void *user)
+{
+    (void)user;
+    return log_dropped_count();
+}
+
+static int64_t sample_system_heap_committed(void *user)
+{
+    (void)user;
+    return (int64_t)heap_committed_size(mem_system_allocator());
+}
+
+static int64_t sample_frame_memory(void *user)
 {
+    (void)user;
+    return (int64_t)mem_frame_stats().last_frame_size;
+}
+
+static void register_application_metrics(void)
+{
+    metrics_register("frames_total", sample_frame_count, NULL);
+    for (int32_t i = 0; i < (int32_t)SDL_arraysize(g_frame_metrics); ++i) {
+        metrics_register(g_frame_metrics[i].name, sample_frame_metric, (void *)&g_frame_metrics[i]);
+    }
+    metrics_register("log_dropped_total", sample_log_dropped, NULL);
+    metrics_register("memory_system_heap_committed_bytes", sample_system_heap_committed, NULL);
+    metrics_register("memory_frame_bytes", sample_frame_memory, NULL);
+}
+
+void start_application(const application_desc_t desc)
+{
+    profile_set_thread_name("main");
+
     if (!start_memory_system((memory_system_desc_t){
-            .system_memory_size = GB(1),
+            .system_reserve_size = GB(64),
+            .system_pool_size = MB(4),
             .scratch_memory_size = MB(5),
+            .scratch_reserve_size = MB(256),
+            .frame_memory_size = MB(2),
+            .frame_reserve_size = MB(256),
+            .huge_pages = true,
+            .frame_arena_count = 2,
+            .stats_dump_interval = 600,
+            .handle_reserve_size = GB(4),
+            .handle_compact_budget = MB(1),
         })) {
         log_error(LOG_CATEGORY_APPLICATION, "Failed to initialize memory system.");
         exit_application(APPLICATION_INITIALIZATION_ERROR);
     }
 
-    if (!SDL_Init(SDL_INIT_VIDEO)) {
+    if (!SDL_Init(desc.headless ? 0 : SDL_INIT_VIDEO)) {
         log_error(LOG_CATEGORY_APPLICATION, "Failed to initialize SDL: %s", SDL_GetError());
         exit_application(APPLICATION_INITIALIZATION_ERROR);
     }
 
-    start_log_system();
+    // The log file lives in the per-user preferences folder, next to the rotated logs of earlier runs.
+    char log_path[LOG_FILE_PATH_MAX];
+    get_pref_file_path("bodies.log", log_path, sizeof(log_path));
+
+    start_log_system((log_system_desc_t){
+        .async = true,
+        .overflow = LOG_OVERFLOW_DROP,
+        .file_path = log_path[0] != '\0' ? log_path : NULL,
+    });
+
+    // Headless runs report their own summary at the end.
+    start_frame_stats((frame_stats_desc_t){ .log_interval = desc.headless ? 0 : 600 });
+
+    // Metrics are published either way, the server only runs when BODIES_METRICS_SOCKET names a socket to listen on.
+    register_application_metrics();
+    if (!start_metrics_system((metrics_system_desc_t){ .socket_path = SDL_getenv("BODIES_METRICS_SOCKET") })) {
+        log_warn(LOG_CATEGORY_APPLICATION, "Failed to start the metrics server, %s.", SDL_GetError());
+    }
+
+    // Textures are loaded through the texture cache, which maps cooked files without decoding, so nothing at startup
+    // needs the loader's workers. Applications that queue many images with load_image_async opt in.
+    if (desc.image_loader) {
+        if (!start_image_loader((image_loader_desc_t){ 0 })) {
+            log_error(LOG_CATEGORY_APPLICATION, "Failed to start the image loader.");
+            exit_application(APPLICATION_INITIALIZATION_ERROR);
+        }
+        g_image_loader_started = true;
+    }
+
+    // Cooked textures are kept in the per-user preferences folder too, without it every run cooks them again.
+    char texture_cache_path[LOG_FILE_PATH_MAX];
+    get_pref_file_path("textures", texture_cache_path, sizeof(texture_cache_path));
+    start_texture_cache((texture_cache_desc_t){ .directory = texture_cache_path[0] != '\0' ? texture_cache_path : NULL });
 
     log_info(LOG_CATEGORY_APPLICATION, "Started application.");
 
 #if FEATURE_MEMORY_STATS
     log_debug(LOG_CATEGORY_MEMORY, "FEATURE_MEMORY_STATS: enabled.");
-#elif
+#else
     log_debug(LOG_CATEGORY_MEMORY, "FEATURE_MEMORY_STATS: disabled.");
 #endif
+#if FEATURE_PROFILER
+    log_debug(LOG_CATEGORY_APPLICATION, "FEATURE_PROFILER: enabled.");
+#else
+    log_debug(LOG_CATEGORY_APPLICATION, "FEATURE_PROFILER: disabled.");
+#endif
 }
 
 void stop_application(void)
 {
     log_info(LOG_CATEGORY_APPLICATION, "Shutdown application.");
 
+    // Loader threads use their own scratch arenas and the log, so they exit before either system stops.
+    stop_image_loader();
+    g_image_loader_started = false;
+    stop_texture_cache();
+    stop_frame_stats();
+    stop_metrics_system();
+
+#if FEATURE_PROFILER
+    // The trace holds the last PROFILE_EVENT_COUNT zones of each thread, open it in chrome://tracing or Perfetto.
+    char trace_path[LOG_FILE_PATH_MAX];
+    get_pref_file_path("bodies.trace.json", trace_path, sizeof(trace_path));
+    if (trace_path[0] != '\0') {
+        if (profile_dump_chrome_trace(trace_path)) {
+            log_info(LOG_CATEGORY_APPLICATION, "Wrote profile trace to %s.", trace_path);
+        } else {
+            log_warn(LOG_CATEGORY_APPLICATION, "Failed to write profile trace, %s.", SDL_GetError());
+        }
+    }
+#endif
+
+    stop_log_system();
     stop_memory_system();
 }
 
+void begin_application_frame(void)
+{
+    PROFILE_BEGIN("begin_application_frame");
+    frame_stats_begin_frame();
+    mem_begin_frame();
+    metrics_publish();
+    if (g_image_loader_started) {
+        dispatch_image_requests();
+    }
+    PROFILE_END();
+}
+
 void exit_application(const int32_t exit_code)
 {
     log_error(LOG_CATEGORY_APPLICATION, "Exited application.");
+    flush_log_system();
     exit(exit_code);
 }
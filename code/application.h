@@ -1,12 +1,24 @@
 #ifndef APPLICATION_H
 #define APPLICATION_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
-void start_application(void);
+typedef struct application_desc_t application_desc_t;
+struct application_desc_t
+{
+    bool headless;     // No video subsystem, for running the frame loop without a display or GPU.
+    bool image_loader; // Starts the image loader's workers for load_image_async, the frame loop then runs its callbacks.
+};
+
+void start_application(application_desc_t desc);
 
 void stop_application(void);
 
+// Starts a frame of the systems the application runs: frame stats, frame memory, metrics and, with the image loader
+// started, image callbacks. Called first thing every frame, by run_window_event_loop or by the headless loop.
+void begin_application_frame(void);
+
 void exit_application(int32_t exit_code);
 
 #endif // APPLICATION_H
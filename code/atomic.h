@@ -0,0 +1,85 @@
+#ifndef ATOMIC_H
+#define ATOMIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// SDL's atomics stop at 32-bit integers and pointers, these cover 64-bit counters. All operations are relaxed unless
+// named otherwise; they are meant for statistics and counters, not for publishing data between threads.
+
+static inline int32_t atomic_add_i32(int32_t volatile *a, int32_t v)
+{
+#if defined(_MSC_VER)
+    return _InterlockedExchangeAdd((long volatile *)a, v);
+#else
+    return __atomic_fetch_add(a, v, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline int32_t atomic_exchange_i32(int32_t volatile *a, int32_t v)
+{
+#if defined(_MSC_VER)
+    return _InterlockedExchange((long volatile *)a, v);
+#else
+    return __atomic_exchange_n(a, v, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline int32_t atomic_load_i32(int32_t volatile *a)
+{
+#if defined(_MSC_VER)
+    return *a;
+#else
+    return __atomic_load_n(a, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline int64_t atomic_add_i64(int64_t volatile *a, int64_t v)
+{
+#if defined(_MSC_VER)
+    return _InterlockedExchangeAdd64(a, v);
+#else
+    return __atomic_fetch_add(a, v, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline int64_t atomic_load_i64(int64_t volatile *a)
+{
+#if defined(_MSC_VER)
+    return *a; // Aligned 64-bit loads are atomic on x64.
+#else
+    return __atomic_load_n(a, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline void atomic_store_i64(int64_t volatile *a, int64_t v)
+{
+#if defined(_MSC_VER)
+    *a = v;
+#else
+    __atomic_store_n(a, v, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline bool atomic_cas_i64(int64_t volatile *a, int64_t expected, int64_t desired)
+{
+#if defined(_MSC_VER)
+    return _InterlockedCompareExchange64(a, desired, expected) == expected;
+#else
+    return __atomic_compare_exchange_n(a, &expected, desired, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline void atomic_max_i64(int64_t volatile *a, int64_t v)
+{
+    int64_t current = atomic_load_i64(a);
+    while (v > current && !atomic_cas_i64(a, current, v)) {
+        current = atomic_load_i64(a);
+    }
+}
+
+#endif // ATOMIC_H
@@ -0,0 +1,52 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+uint64_t bench_now_ns(void);
+
+uint64_t bench_rand(uint64_t *state);
+
+// Results are printed as tables on stdout. When bodies_bench is given --json <path>, every result is also written as
+// one object in a JSON array so runs can be compared between releases.
+void bench_report_begin(const char *suite, const char *name);
+void bench_report_string(const char *key, const char *value);
+void bench_report_number(const char *key, double value);
+void bench_report_end(void);
+
+void bench_alloc_sizes(void);
+
+void bench_alloc_stb_realloc(void);
+
+void bench_alloc_log_churn(void);
+
+void bench_file_read(void);
+
+void bench_heap_contention(void);
+
+void bench_heap_footprint(void);
+
+void bench_heap_fragmentation(void);
+
+void bench_image_load(void);
+
+void bench_image_decode(void);
+
+void bench_image_heap(void);
+
+void bench_pool_churn(void);
+
+void bench_log_latency(void);
+
+// Must run before the log system starts, bench_log_startup reports what it measured.
+void bench_log_startup_prepare(void);
+
+void bench_log_startup(void);
+
+void bench_profile_zones(void);
+
+void bench_texture_startup(void);
+
+void bench_vm_tlb(void);
+
+#endif // BENCH_H
@@ -0,0 +1,487 @@
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "memory.h"
+
+#define SIZES_MAX_LIVE          4096
+#define SIZES_LINEAR_ARENA_SIZE MB(64)
+#define SIZES_STACK_DEPTH       16
+
+#define STB_IMAGES              64
+#define STB_IDATA_CHUNK_SIZE    KB(8)
+#define STB_IDATA_SIZE          MB(1)
+#define STB_IMAGE_SIZE          MB(4) // 1024x1024 RGBA.
+#define STB_INITIAL_SIZE        KB(4)
+
+#define LOG_CHURN_ENTRIES       1000000
+#define LOG_CHURN_STASH_DEPTH   64
+
+typedef enum alloc_kind_t alloc_kind_t;
+enum alloc_kind_t
+{
+    ALLOC_KIND_HEAP,
+    ALLOC_KIND_MALLOC,
+};
+
+static const char *g_alloc_kind_names[] = { "heap", "malloc" };
+
+typedef struct size_distribution_t size_distribution_t;
+struct size_distribution_t
+{
+    const char *name;
+    size_t (*sample)(uint64_t *rng);
+    int32_t live_count;
+    int32_t churn_ops;
+};
+
+// Log messages, small strings and records.
+static size_t sample_small(uint64_t *rng)
+{
+    return 16 + bench_rand(rng) % (256 - 16);
+}
+
+// Mostly small with a tail of buffers, roughly what the system heap sees while running.
+static size_t sample_mixed(uint64_t *rng)
+{
+    uint64_t r = bench_rand(rng);
+    uint64_t bucket = r % 100;
+    r >>= 8;
+    if (bucket < 80) {
+        return 16 + r % (256 - 16);
+    }
+    if (bucket < 95) {
+        return 256 + r % (KB(4) - 256);
+    }
+    return KB(4) + r % (KB(64) - KB(4));
+}
+
+// File and image buffers.
+static size_t sample_large(uint64_t *rng)
+{
+    return KB(64) + bench_rand(rng) % (MB(1) - KB(64));
+}
+
+static const size_distribution_t g_distributions[] = {
+    { "small", sample_small, SIZES_MAX_LIVE, 1000000 },
+    { "mixed", sample_mixed, 1024, 500000 },
+    { "large", sample_large, 64, 20000 },
+};
+
+typedef struct alloc_target_t alloc_target_t;
+struct alloc_target_t
+{
+    alloc_kind_t kind;
+    heap_allocator_t heap;
+};
+
+static void alloc_target_init(alloc_target_t *target, alloc_kind_t kind)
+{
+    target->kind = kind;
+    if (kind == ALLOC_KIND_HEAP) {
+        heap_init(&target->heap, GB(4), MB(1), 1, false);
+    }
+}
+
+static void alloc_target_deinit(alloc_target_t *target)
+{
+    if (target->kind == ALLOC_KIND_HEAP) {
+        heap_deinit(&target->heap);
+    }
+}
+
+static void *target_alloc(alloc_target_t *target, size_t size)
+{
+    if (target->kind == ALLOC_KIND_HEAP) {
+        return heap_alloc(&target->heap, size, MEM_DEFAULT_ALIGN);
+    }
+    return malloc(size);
+}
+
+static void *target_calloc(alloc_target_t *target, size_t count, size_t size)
+{
+    if (target->kind == ALLOC_KIND_HEAP) {
+        return heap_calloc(&target->heap, count, size, MEM_DEFAULT_ALIGN);
+    }
+    return calloc(count, size);
+}
+
+static void *target_realloc(alloc_target_t *target, void *mem, size_t size)
+{
+    if (target->kind == ALLOC_KIND_HEAP) {
+        return heap_realloc(&target->heap, mem, size, MEM_DEFAULT_ALIGN);
+    }
+    return realloc(mem, size);
+}
+
+static void target_dealloc(alloc_target_t *target, void *mem)
+{
+    if (target->kind == ALLOC_KIND_HEAP) {
+        heap_dealloc(&target->heap, mem);
+    } else {
+        free(mem);
+    }
+}
+
+// Only the heap can report how its memory is laid out; malloc reports zeroes.
+static void target_usage(alloc_target_t *target, size_t *peak_committed, double *fragmentation)
+{
+    *peak_committed = 0;
+    *fragmentation = 0.0;
+    if (target->kind != ALLOC_KIND_HEAP) {
+        return;
+    }
+
+    heap_usage_t usage;
+    heap_usage(&target->heap, &usage);
+    *peak_committed = usage.committed_size;
+    if (usage.free_size > 0) {
+        *fragmentation = 1.0 - (double)usage.largest_free_size / (double)usage.free_size;
+    }
+}
+
+// O--------------------------------------------------------------------------O
+// | Size Distributions                                                       |
+// O--------------------------------------------------------------------------O
+
+typedef struct sizes_result_t sizes_result_t;
+struct sizes_result_t
+{
+    double alloc_ns;
+    double churn_ns;
+    double dealloc_ns;
+    size_t peak_committed;
+    double fragmentation;
+};
+
+// Fills the live set, churns it by freeing and replacing random blocks, then frees everything in random order. The
+// usage is sampled after the churn, which is when the heap is both at its peak and at its most fragmented.
+static sizes_result_t run_sizes(alloc_kind_t kind, const size_distribution_t *distribution)
+{
+    static void *live[SIZES_MAX_LIVE];
+    static int32_t order[SIZES_MAX_LIVE];
+
+    alloc_target_t target;
+    alloc_target_init(&target, kind);
+
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    const int32_t live_count = distribution->live_count;
+    sizes_result_t result = { 0 };
+
+    uint64_t begin = bench_now_ns();
+    for (int32_t i = 0; i < live_count; ++i) {
+        live[i] = target_alloc(&target, distribution->sample(&rng));
+    }
+    result.alloc_ns = (double)(bench_now_ns() - begin) / live_count;
+
+    begin = bench_now_ns();
+    for (int32_t op = 0; op < distribution->churn_ops; ++op) {
+        int32_t slot = (int32_t)(bench_rand(&rng) % live_count);
+        target_dealloc(&target, live[slot]);
+        live[slot] = target_alloc(&target, distribution->sample(&rng));
+    }
+    result.churn_ns = (double)(bench_now_ns() - begin) / distribution->churn_ops;
+
+    target_usage(&target, &result.peak_committed, &result.fragmentation);
+
+    for (int32_t i = 0; i < live_count; ++i) {
+        order[i] = i;
+    }
+    for (int32_t i = live_count - 1; i > 0; --i) {
+        int32_t j = (int32_t)(bench_rand(&rng) % (i + 1));
+        int32_t tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+
+    begin = bench_now_ns();
+    for (int32_t i = 0; i < live_count; ++i) {
+        target_dealloc(&target, live[order[i]]);
+    }
+    result.dealloc_ns = (double)(bench_now_ns() - begin) / live_count;
+
+    alloc_target_deinit(&target);
+    return result;
+}
+
+static double run_linear_sizes(const size_distribution_t *distribution, linear_allocator_t *linear)
+{
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    const int32_t ops = distribution->churn_ops;
+
+    uint64_t begin = bench_now_ns();
+    for (int32_t op = 0; op < ops; ++op) {
+        // Reset like a frame arena would, well before a large block could overflow it.
+        if (linear->total_size - linear->allocated_size < MB(1)) {
+            linear_reset(linear);
+        }
+        linear_alloc(linear, distribution->sample(&rng), MEM_DEFAULT_ALIGN);
+    }
+    uint64_t elapsed = bench_now_ns() - begin;
+
+    linear_reset(linear);
+    return (double)elapsed / ops;
+}
+
+static double run_stack_sizes(const size_distribution_t *distribution)
+{
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    const int32_t ops = distribution->churn_ops;
+
+    // Scopes of SIZES_STACK_DEPTH allocations, like a loader building a path and a few buffers. Large blocks use a
+    // smaller depth so a whole scope fits in the scratch arena.
+    const int32_t depth = distribution->sample == sample_large ? 2 : SIZES_STACK_DEPTH;
+
+    uint64_t begin = bench_now_ns();
+    for (int32_t op = 0; op < ops; op += depth) {
+        temp_memory_t temp = temp_begin();
+        for (int32_t i = 0; i < depth; ++i) {
+            stack_alloc(temp.stack, distribution->sample(&rng), MEM_DEFAULT_ALIGN);
+        }
+        temp_end(temp);
+    }
+    uint64_t elapsed = bench_now_ns() - begin;
+
+    return (double)elapsed / ops;
+}
+
+void bench_alloc_sizes(void)
+{
+    heap_allocator_t *system = mem_system_allocator();
+    linear_allocator_t linear;
+    void *linear_mem = heap_alloc(system, SIZES_LINEAR_ARENA_SIZE, CACHE_LINE_SIZE);
+    linear_init(&linear, SIZES_LINEAR_ARENA_SIZE, linear_mem);
+
+    printf("alloc sizes: fill, random churn and random order free of a live set\n");
+    printf("%-8s %-8s %10s %10s %12s %12s %10s\n", "dist", "alloc", "alloc ns", "churn ns", "dealloc ns", "peak MB", "frag");
+
+    for (int32_t d = 0; d < (int32_t)SDL_arraysize(g_distributions); ++d) {
+        const size_distribution_t *distribution = &g_distributions[d];
+
+        for (int32_t k = 0; k < (int32_t)SDL_arraysize(g_alloc_kind_names); ++k) {
+            sizes_result_t result = run_sizes((alloc_kind_t)k, distribution);
+            printf("%-8s %-8s %10.2f %10.2f %12.2f %12.2f %10.3f\n", distribution->name, g_alloc_kind_names[k], result.alloc_ns, result.churn_ns, result.dealloc_ns, (double)result.peak_committed / MB(1), result.fragmentation);
+
+            bench_report_begin("alloc_sizes", distribution->name);
+            bench_report_string("allocator", g_alloc_kind_names[k]);
+            bench_report_number("live_count", distribution->live_count);
+            bench_report_number("alloc_ns_per_op", result.alloc_ns);
+            bench_report_number("churn_ns_per_op", result.churn_ns);
+            bench_report_number("dealloc_ns_per_op", result.dealloc_ns);
+            bench_report_number("peak_committed_bytes", (double)result.peak_committed);
+            bench_report_number("fragmentation", result.fragmentation);
+            bench_report_end();
+        }
+
+        double linear_ns = run_linear_sizes(distribution, &linear);
+        double stack_ns = run_stack_sizes(distribution);
+        printf("%-8s %-8s %10.2f\n", distribution->name, "linear", linear_ns);
+        printf("%-8s %-8s %10.2f\n", distribution->name, "stack", stack_ns);
+
+        bench_report_begin("alloc_sizes", distribution->name);
+        bench_report_string("allocator", "linear");
+        bench_report_number("alloc_ns_per_op", linear_ns);
+        bench_report_end();
+
+        bench_report_begin("alloc_sizes", distribution->name);
+        bench_report_string("allocator", "stack");
+        bench_report_number("alloc_ns_per_op", stack_ns);
+        bench_report_end();
+    }
+
+    heap_dealloc(system, linear_deinit(&linear));
+}
+
+// O--------------------------------------------------------------------------O
+// | stb_image Realloc Growth                                                 |
+// O--------------------------------------------------------------------------O
+
+typedef struct growth_buffer_t growth_buffer_t;
+struct growth_buffer_t
+{
+    uint8_t *data;
+    size_t size;
+    size_t limit;
+};
+
+// Appends the way stb_image grows its buffers: the limit doubles whenever an append would overflow it.
+static int32_t growth_append(alloc_target_t *target, growth_buffer_t *buffer, size_t size)
+{
+    int32_t realloc_count = 0;
+    if (buffer->size + size > buffer->limit) {
+        size_t limit = buffer->limit == 0 ? STB_INITIAL_SIZE : buffer->limit;
+        while (buffer->size + size > limit) {
+            limit *= 2;
+        }
+        buffer->data = target_realloc(target, buffer->data, limit);
+        buffer->limit = limit;
+        realloc_count = 1;
+    }
+
+    // Touch every page of the appended range like a decoder writing its output would.
+    for (size_t offset = 0; offset < size; offset += KB(4)) {
+        buffer->data[buffer->size + offset] = (uint8_t)offset;
+    }
+    buffer->size += size;
+    return realloc_count;
+}
+
+// Each image accumulates its compressed IDAT chunks, then inflates into an output buffer that starts from a guess
+// and doubles, then both are released. A small allocation per image keeps blocks from simply coalescing back.
+static void run_stb_realloc(alloc_kind_t kind, double *ns_per_realloc, double *ns_per_image, size_t *peak_committed, double *fragmentation)
+{
+    alloc_target_t target;
+    alloc_target_init(&target, kind);
+
+    void *residents[STB_IMAGES];
+    int32_t realloc_count = 0;
+    size_t peak = 0;
+    double frag = 0.0;
+
+    uint64_t elapsed = 0;
+    for (int32_t image = 0; image < STB_IMAGES; ++image) {
+        uint64_t begin = bench_now_ns();
+
+        growth_buffer_t idata = { 0 };
+        for (size_t size = 0; size < STB_IDATA_SIZE; size += STB_IDATA_CHUNK_SIZE) {
+            realloc_count += growth_append(&target, &idata, STB_IDATA_CHUNK_SIZE);
+        }
+
+        growth_buffer_t out = { 0 };
+        for (size_t size = 0; size < STB_IMAGE_SIZE; size += KB(32)) {
+            realloc_count += growth_append(&target, &out, KB(32));
+        }
+
+        target_dealloc(&target, idata.data);
+        residents[image] = target_alloc(&target, 64 + image * 16);
+
+        elapsed += bench_now_ns() - begin;
+
+        // The decoded image is what the caller keeps, sample the heap while it is still alive.
+        if (image == STB_IMAGES - 1) {
+            target_usage(&target, &peak, &frag);
+        }
+        target_dealloc(&target, out.data);
+    }
+
+    for (int32_t image = 0; image < STB_IMAGES; ++image) {
+        target_dealloc(&target, residents[image]);
+    }
+
+    alloc_target_deinit(&target);
+
+    *ns_per_realloc = (double)elapsed / realloc_count;
+    *ns_per_image = (double)elapsed / STB_IMAGES;
+    *peak_committed = peak;
+    *fragmentation = frag;
+}
+
+void bench_alloc_stb_realloc(void)
+{
+    printf("stb_image realloc growth: %d images, %llu KB compressed, %llu KB decoded\n", STB_IMAGES, (unsigned long long)STB_IDATA_SIZE / KB(1), (unsigned long long)STB_IMAGE_SIZE / KB(1));
+    printf("%-8s %12s %12s %12s %10s\n", "alloc", "realloc ns", "image us", "peak MB", "frag");
+
+    for (int32_t k = 0; k < (int32_t)SDL_arraysize(g_alloc_kind_names); ++k) {
+        double ns_per_realloc, ns_per_image, fragmentation;
+        size_t peak_committed;
+        run_stb_realloc((alloc_kind_t)k, &ns_per_realloc, &ns_per_image, &peak_committed, &fragmentation);
+        printf("%-8s %12.2f %12.2f %12.2f %10.3f\n", g_alloc_kind_names[k], ns_per_realloc, ns_per_image / 1000.0, (double)peak_committed / MB(1), fragmentation);
+
+        bench_report_begin("stb_realloc", "png_decode");
+        bench_report_string("allocator", g_alloc_kind_names[k]);
+        bench_report_number("realloc_ns_per_op", ns_per_realloc);
+        bench_report_number("ns_per_image", ns_per_image);
+        bench_report_number("peak_committed_bytes", (double)peak_committed);
+        bench_report_number("fragmentation", fragmentation);
+        bench_report_end();
+    }
+}
+
+// O--------------------------------------------------------------------------O
+// | Log Entry Churn                                                          |
+// O--------------------------------------------------------------------------O
+
+typedef struct bench_log_entry_t bench_log_entry_t;
+struct bench_log_entry_t
+{
+    int32_t category;
+    int32_t priority;
+    char *message;
+    bench_log_entry_t *next;
+};
+
+// Mirrors the log stash: a zeroed entry and a formatted message per line, flushed in order every so often.
+static double run_log_churn(alloc_kind_t kind, size_t *peak_committed, double *fragmentation)
+{
+    alloc_target_t target;
+    alloc_target_init(&target, kind);
+
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    bench_log_entry_t *head = NULL;
+    bench_log_entry_t *tail = NULL;
+    int32_t stashed = 0;
+
+    uint64_t begin = bench_now_ns();
+    for (int32_t i = 0; i < LOG_CHURN_ENTRIES; ++i) {
+        bench_log_entry_t *entry = target_calloc(&target, 1, sizeof(bench_log_entry_t));
+        size_t len = 24 + bench_rand(&rng) % 160;
+        entry->message = target_alloc(&target, len);
+        entry->message[0] = '\0';
+
+        if (tail != NULL) {
+            tail->next = entry;
+        } else {
+            head = entry;
+        }
+        tail = entry;
+
+        if (++stashed == LOG_CHURN_STASH_DEPTH) {
+            if (i == LOG_CHURN_ENTRIES - 1 || i == LOG_CHURN_STASH_DEPTH - 1) {
+                target_usage(&target, peak_committed, fragmentation);
+            }
+
+            while (head != NULL) {
+                bench_log_entry_t *next = head->next;
+                target_dealloc(&target, head->message);
+                target_dealloc(&target, head);
+                head = next;
+            }
+            tail = NULL;
+            stashed = 0;
+        }
+    }
+    uint64_t elapsed = bench_now_ns() - begin;
+
+    while (head != NULL) {
+        bench_log_entry_t *next = head->next;
+        target_dealloc(&target, head->message);
+        target_dealloc(&target, head);
+        head = next;
+    }
+
+    alloc_target_deinit(&target);
+    return (double)elapsed / LOG_CHURN_ENTRIES;
+}
+
+void bench_alloc_log_churn(void)
+{
+    printf("log entry churn: %d entries, flushed every %d\n", LOG_CHURN_ENTRIES, LOG_CHURN_STASH_DEPTH);
+    printf("%-8s %12s %12s %10s\n", "alloc", "entry ns", "peak MB", "frag");
+
+    for (int32_t k = 0; k < (int32_t)SDL_arraysize(g_alloc_kind_names); ++k) {
+        size_t peak_committed = 0;
+        double fragmentation = 0.0;
+        double ns_per_entry = run_log_churn((alloc_kind_t)k, &peak_committed, &fragmentation);
+        printf("%-8s %12.2f %12.2f %10.3f\n", g_alloc_kind_names[k], ns_per_entry, (double)peak_committed / MB(1), fragmentation);
+
+        bench_report_begin("log_churn", "stash");
+        bench_report_string("allocator", g_alloc_kind_names[k]);
+        bench_report_number("ns_per_entry", ns_per_entry);
+        bench_report_number("peak_committed_bytes", (double)peak_committed);
+        bench_report_number("fragmentation", fragmentation);
+        bench_report_end();
+    }
+}
@@ -0,0 +1,116 @@
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "bench.h"
+#include "file.h"
+#include "memory.h"
+
+#define FILE_READ_SIZES_COUNT 3
+#define FILE_READ_PASSES      8
+#define FILE_READ_PATH        "bench_file_read.bin"
+
+static bool write_test_file(const size_t size)
+{
+    SDL_IOStream *io = SDL_IOFromFile(FILE_READ_PATH, "wb");
+    if (io == NULL) {
+        return false;
+    }
+
+    uint64_t block[1024];
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    bool written = true;
+    for (size_t offset = 0; offset < size && written; offset += sizeof(block)) {
+        for (int32_t i = 0; i < (int32_t)SDL_arraysize(block); ++i) {
+            block[i] = bench_rand(&rng);
+        }
+        written = SDL_WriteIO(io, block, sizeof(block)) == sizeof(block);
+    }
+
+    SDL_CloseIO(io);
+    return written;
+}
+
+// Stands in for a decoder, every byte of the file is read once.
+static uint64_t consume(const void *data, const size_t size)
+{
+    const uint64_t *words = data;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < size / sizeof(uint64_t); ++i) {
+        sum += words[i];
+    }
+    return sum;
+}
+
+// What asset loading did before files were mapped: size the file, allocate a buffer for all of it and read it in.
+static double run_read(uint64_t *sum)
+{
+    heap_allocator_t *heap = mem_system_allocator();
+    uint64_t begin = bench_now_ns();
+
+    for (int32_t pass = 0; pass < FILE_READ_PASSES; ++pass) {
+        SDL_IOStream *io = SDL_IOFromFile(FILE_READ_PATH, "rb");
+        const int64_t size = SDL_GetIOSize(io);
+        void *buffer = heap_alloc(heap, (size_t)size, MEM_DEFAULT_ALIGN);
+        SDL_ReadIO(io, buffer, (size_t)size);
+        SDL_CloseIO(io);
+
+        *sum += consume(buffer, (size_t)size);
+        heap_dealloc(heap, buffer);
+    }
+
+    return (double)(bench_now_ns() - begin) / 1e6 / FILE_READ_PASSES;
+}
+
+static double run_map(uint64_t *sum)
+{
+    uint64_t begin = bench_now_ns();
+
+    for (int32_t pass = 0; pass < FILE_READ_PASSES; ++pass) {
+        file_view_t view;
+        if (!map_file(FILE_READ_PATH, FILE_ACCESS_SEQUENTIAL, &view)) {
+            return 0.0;
+        }
+
+        *sum += consume(view.data, view.size);
+        unmap_file(&view);
+    }
+
+    return (double)(bench_now_ns() - begin) / 1e6 / FILE_READ_PASSES;
+}
+
+void bench_file_read(void)
+{
+    const size_t sizes[FILE_READ_SIZES_COUNT] = { KB(256), MB(4), MB(64) };
+
+    printf("file read: %d passes over a file in the page cache, read into a buffer or mapped\n", FILE_READ_PASSES);
+    printf("%10s %10s %10s %8s\n", "size", "read ms", "map ms", "speedup");
+
+    for (int32_t s = 0; s < FILE_READ_SIZES_COUNT; ++s) {
+        if (!write_test_file(sizes[s])) {
+            printf("file read: skipped, failed to write %s\n", FILE_READ_PATH);
+            break;
+        }
+
+        uint64_t read_sum = 0;
+        uint64_t map_sum = 0;
+        // The first read brings the file into the page cache for both runs.
+        run_read(&read_sum);
+        read_sum = 0;
+        const double read_ms = run_read(&read_sum);
+        const double map_ms = run_map(&map_sum);
+        if (read_sum != map_sum) {
+            printf("file read: mapped contents differ from read contents\n");
+        }
+
+        printf("%9lluK %10.3f %10.3f %7.2fx\n", (unsigned long long)(sizes[s] / KB(1)), read_ms, map_ms, read_ms / map_ms);
+
+        bench_report_begin("file_read", "page_cache");
+        bench_report_number("size", (double)sizes[s]);
+        bench_report_number("read_ms", read_ms);
+        bench_report_number("map_ms", map_ms);
+        bench_report_end();
+    }
+
+    SDL_RemovePath(FILE_READ_PATH);
+}
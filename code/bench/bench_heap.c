@@ -0,0 +1,327 @@
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "bench.h"
+#include "memory.h"
+
+#define CONTENTION_MAX_THREADS     16
+#define CONTENTION_OPS_PER_THREAD  200000
+#define CONTENTION_LIVE_BLOCKS     256
+#define CONTENTION_SHARED_SLOTS    4096
+#define CONTENTION_MIN_BLOCK_SIZE  16
+#define CONTENTION_MAX_BLOCK_SIZE  1024
+
+#define FOOTPRINT_BLOCKS           4096
+#define FOOTPRINT_MIN_BLOCK_SIZE   KB(1)
+#define FOOTPRINT_MAX_BLOCK_SIZE   KB(32)
+
+#define FRAGMENTATION_FRAMES          900
+#define FRAGMENTATION_SHRINK_FRAME    600
+#define FRAGMENTATION_SAMPLE_INTERVAL 60
+#define FRAGMENTATION_MAX_LIVE        512
+#define FRAGMENTATION_SHRUNK_LIVE     64
+#define FRAGMENTATION_CHURN           8
+#define FRAGMENTATION_COMPACT_BUDGET  MB(4)
+#define FRAGMENTATION_TARGET_COUNT    3
+
+typedef struct contention_worker_t contention_worker_t;
+struct contention_worker_t
+{
+    heap_allocator_t *heap;
+    void **shared_slots;
+    SDL_AtomicInt *start;
+    uint64_t seed;
+};
+
+// Each op allocates a block and frees one picked at random. In the shared pattern the block being freed was most
+// likely allocated by another thread, which exercises the cross-thread free path.
+static int contention_worker(void *user)
+{
+    contention_worker_t *worker = (contention_worker_t *)user;
+    void *live[CONTENTION_LIVE_BLOCKS] = { 0 };
+    uint64_t rng = worker->seed;
+
+    while (SDL_GetAtomicInt(worker->start) == 0) {
+        SDL_CPUPauseInstruction();
+    }
+
+    for (int32_t i = 0; i < CONTENTION_OPS_PER_THREAD; ++i) {
+        size_t size = CONTENTION_MIN_BLOCK_SIZE + bench_rand(&rng) % (CONTENTION_MAX_BLOCK_SIZE - CONTENTION_MIN_BLOCK_SIZE);
+        void *mem = heap_alloc(worker->heap, size, MEM_DEFAULT_ALIGN);
+
+        uint64_t slot = bench_rand(&rng);
+        void *old;
+        if (worker->shared_slots != NULL) {
+            old = SDL_SetAtomicPointer(&worker->shared_slots[slot % CONTENTION_SHARED_SLOTS], mem);
+        } else {
+            old = live[slot % CONTENTION_LIVE_BLOCKS];
+            live[slot % CONTENTION_LIVE_BLOCKS] = mem;
+        }
+
+        heap_dealloc(worker->heap, old);
+    }
+
+    for (int32_t i = 0; i < CONTENTION_LIVE_BLOCKS; ++i) {
+        heap_dealloc(worker->heap, live[i]);
+    }
+
+    return 0;
+}
+
+static double run_contention(heap_allocator_t *heap, int32_t thread_count, bool shared)
+{
+    static void *shared_slots[CONTENTION_SHARED_SLOTS];
+    SDL_zeroa(shared_slots);
+
+    SDL_AtomicInt start = { 0 };
+    contention_worker_t workers[CONTENTION_MAX_THREADS];
+    SDL_Thread *threads[CONTENTION_MAX_THREADS];
+
+    for (int32_t i = 0; i < thread_count; ++i) {
+        workers[i] = (contention_worker_t){
+            .heap = heap,
+            .shared_slots = shared ? shared_slots : NULL,
+            .start = &start,
+            .seed = 0x9E3779B97F4A7C15ULL * (i + 1),
+        };
+        threads[i] = SDL_CreateThread(contention_worker, "contention", &workers[i]);
+    }
+
+    uint64_t begin = bench_now_ns();
+    SDL_SetAtomicInt(&start, 1);
+    for (int32_t i = 0; i < thread_count; ++i) {
+        SDL_WaitThread(threads[i], NULL);
+    }
+    uint64_t elapsed = bench_now_ns() - begin;
+
+    for (int32_t i = 0; i < CONTENTION_SHARED_SLOTS; ++i) {
+        heap_dealloc(heap, shared_slots[i]);
+    }
+
+    double ops = (double)thread_count * CONTENTION_OPS_PER_THREAD;
+    return ops / ((double)elapsed / 1e9) / 1e6;
+}
+
+void bench_heap_contention(void)
+{
+    int32_t shard_counts[] = { 1, HEAP_MAX_SHARDS };
+    const char *patterns[] = { "local", "shared" };
+
+    printf("heap contention: %d ops per thread, blocks of %d-%d bytes\n", CONTENTION_OPS_PER_THREAD, CONTENTION_MIN_BLOCK_SIZE, CONTENTION_MAX_BLOCK_SIZE);
+    printf("%-8s %6s %8s %10s %8s\n", "pattern", "shards", "threads", "Mops/s", "scaling");
+
+    for (int32_t p = 0; p < (int32_t)SDL_arraysize(patterns); ++p) {
+        for (int32_t s = 0; s < (int32_t)SDL_arraysize(shard_counts); ++s) {
+            heap_allocator_t heap;
+            heap_init(&heap, GB(4), MB(1), shard_counts[s], false);
+
+            double single = 0.0;
+            for (int32_t threads = 1; threads <= CONTENTION_MAX_THREADS; threads *= 2) {
+                double mops = run_contention(&heap, threads, p == 1);
+                if (threads == 1) {
+                    single = mops;
+                }
+                printf("%-8s %6d %8d %10.2f %7.2fx\n", patterns[p], shard_counts[s], threads, mops, mops / single);
+
+                bench_report_begin("heap_contention", patterns[p]);
+                bench_report_number("shards", shard_counts[s]);
+                bench_report_number("threads", threads);
+                bench_report_number("mops_per_s", mops);
+                bench_report_end();
+            }
+
+            heap_deinit(&heap);
+        }
+    }
+}
+
+// Commits a burst of blocks and frees them again, reporting how much memory the heap holds at each stage.
+void bench_heap_footprint(void)
+{
+    static void *blocks[FOOTPRINT_BLOCKS];
+
+    heap_allocator_t heap;
+    heap_init(&heap, GB(4), MB(1), 1, false);
+
+    size_t startup_size = heap_committed_size(&heap);
+
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    size_t requested_size = 0;
+    for (int32_t i = 0; i < FOOTPRINT_BLOCKS; ++i) {
+        size_t size = FOOTPRINT_MIN_BLOCK_SIZE + bench_rand(&rng) % (FOOTPRINT_MAX_BLOCK_SIZE - FOOTPRINT_MIN_BLOCK_SIZE);
+        blocks[i] = heap_alloc(&heap, size, MEM_DEFAULT_ALIGN);
+        requested_size += size;
+    }
+
+    size_t peak_size = heap_committed_size(&heap);
+
+    for (int32_t i = 0; i < FOOTPRINT_BLOCKS; ++i) {
+        heap_dealloc(&heap, blocks[i]);
+    }
+
+    size_t freed_size = heap_committed_size(&heap);
+
+    heap_deinit(&heap);
+
+    printf("heap footprint: %.2f MB requested\n", (double)requested_size / MB(1));
+    printf("%-10s %12s\n", "stage", "committed MB");
+    printf("%-10s %12.2f\n", "startup", (double)startup_size / MB(1));
+    printf("%-10s %12.2f\n", "peak", (double)peak_size / MB(1));
+    printf("%-10s %12.2f\n", "freed", (double)freed_size / MB(1));
+
+    bench_report_begin("heap_footprint", "burst");
+    bench_report_number("requested_bytes", (double)requested_size);
+    bench_report_number("startup_committed_bytes", (double)startup_size);
+    bench_report_number("peak_committed_bytes", (double)peak_size);
+    bench_report_number("freed_committed_bytes", (double)freed_size);
+    bench_report_end();
+}
+
+typedef struct fragmentation_target_t fragmentation_target_t;
+struct fragmentation_target_t
+{
+    const char *name;
+    heap_allocator_t heap;
+    handle_heap_t handles;
+    bool use_handles;
+    size_t compact_budget;
+    void *blocks[FRAGMENTATION_MAX_LIVE];
+    mem_handle_t block_handles[FRAGMENTATION_MAX_LIVE];
+};
+
+static void fragmentation_alloc(fragmentation_target_t *target, int32_t slot, size_t size)
+{
+    if (target->use_handles) {
+        target->block_handles[slot] = handle_heap_alloc(&target->handles, size);
+    } else {
+        target->blocks[slot] = heap_alloc(&target->heap, size, MEM_DEFAULT_ALIGN);
+    }
+}
+
+static void fragmentation_dealloc(fragmentation_target_t *target, int32_t slot)
+{
+    if (target->use_handles) {
+        handle_heap_dealloc(&target->handles, target->block_handles[slot]);
+        target->block_handles[slot] = MEM_HANDLE_NULL;
+    } else {
+        heap_dealloc(&target->heap, target->blocks[slot]);
+        target->blocks[slot] = NULL;
+    }
+}
+
+static void fragmentation_usage(fragmentation_target_t *target, heap_usage_t *usage)
+{
+    if (target->use_handles) {
+        handle_heap_usage(&target->handles, usage);
+    } else {
+        heap_usage(&target->heap, usage);
+    }
+}
+
+// Texture and decode buffer sized blocks, 4 KB to 1 MB.
+static size_t fragmentation_size(uint64_t *rng)
+{
+    size_t size = KB(4) << (bench_rand(rng) % 8);
+    return size + bench_rand(rng) % size;
+}
+
+// Loads and frees buffers the way a long session streams assets in and out, then drops most of them as if a level
+// were unloaded. The same operations are applied to the TLSF heap and to handle heaps with and without per-frame
+// compaction, sampling how the free space is split up as the session goes on.
+void bench_heap_fragmentation(void)
+{
+    static fragmentation_target_t targets[FRAGMENTATION_TARGET_COUNT] = {
+        { .name = "tlsf" },
+        { .name = "handles", .use_handles = true },
+        { .name = "compacted", .use_handles = true, .compact_budget = FRAGMENTATION_COMPACT_BUDGET },
+    };
+
+    for (int32_t t = 0; t < FRAGMENTATION_TARGET_COUNT; ++t) {
+        if (targets[t].use_handles) {
+            // Retain enough that both handle heaps keep their peak committed, so the free space is comparable.
+            handle_heap_init(&targets[t].handles, GB(4), MB(256), FRAGMENTATION_MAX_LIVE);
+        } else {
+            heap_init(&targets[t].heap, GB(4), MB(4), 1, false);
+        }
+    }
+
+    printf("heap fragmentation: %d frames, %d live blocks until frame %d, then %d; compaction moves up to %.0f MB per frame\n",
+        FRAGMENTATION_FRAMES, FRAGMENTATION_MAX_LIVE, FRAGMENTATION_SHRINK_FRAME, FRAGMENTATION_SHRUNK_LIVE, (double)FRAGMENTATION_COMPACT_BUDGET / MB(1));
+    printf("%6s %-10s %10s %10s %10s %12s %8s\n", "frame", "heap", "used MB", "free MB", "commit MB", "largest MB", "frag");
+
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    bool live[FRAGMENTATION_MAX_LIVE] = { 0 };
+    int32_t live_count = 0;
+
+    for (int32_t frame = 1; frame <= FRAGMENTATION_FRAMES; ++frame) {
+        const int32_t target_count = frame < FRAGMENTATION_SHRINK_FRAME ? FRAGMENTATION_MAX_LIVE : FRAGMENTATION_SHRUNK_LIVE;
+
+        for (int32_t i = 0; i < FRAGMENTATION_CHURN; ++i) {
+            int32_t slot = (int32_t)(bench_rand(&rng) % FRAGMENTATION_MAX_LIVE);
+            if (live[slot]) {
+                for (int32_t t = 0; t < FRAGMENTATION_TARGET_COUNT; ++t) {
+                    fragmentation_dealloc(&targets[t], slot);
+                }
+                live[slot] = false;
+                --live_count;
+            }
+        }
+
+        for (int32_t i = 0; i < FRAGMENTATION_CHURN && live_count < target_count; ++i) {
+            int32_t slot = (int32_t)(bench_rand(&rng) % FRAGMENTATION_MAX_LIVE);
+            if (!live[slot]) {
+                size_t size = fragmentation_size(&rng);
+                for (int32_t t = 0; t < FRAGMENTATION_TARGET_COUNT; ++t) {
+                    fragmentation_alloc(&targets[t], slot, size);
+                }
+                live[slot] = true;
+                ++live_count;
+            }
+        }
+
+        for (int32_t t = 0; t < FRAGMENTATION_TARGET_COUNT; ++t) {
+            if (targets[t].compact_budget > 0) {
+                handle_heap_compact(&targets[t].handles, targets[t].compact_budget);
+            }
+        }
+
+        if (frame % FRAGMENTATION_SAMPLE_INTERVAL != 0) {
+            continue;
+        }
+
+        for (int32_t t = 0; t < FRAGMENTATION_TARGET_COUNT; ++t) {
+            heap_usage_t usage;
+            fragmentation_usage(&targets[t], &usage);
+            double fragmentation = usage.free_size > 0 ? 1.0 - (double)usage.largest_free_size / (double)usage.free_size : 0.0;
+
+            printf("%6d %-10s %10.2f %10.2f %10.2f %12.2f %8.3f\n", frame, targets[t].name, (double)usage.used_size / MB(1), (double)usage.free_size / MB(1),
+                (double)usage.committed_size / MB(1), (double)usage.largest_free_size / MB(1), fragmentation);
+
+            bench_report_begin("heap_fragmentation", targets[t].name);
+            bench_report_number("frame", frame);
+            bench_report_number("used_bytes", (double)usage.used_size);
+            bench_report_number("free_bytes", (double)usage.free_size);
+            bench_report_number("committed_bytes", (double)usage.committed_size);
+            bench_report_number("largest_free_bytes", (double)usage.largest_free_size);
+            bench_report_number("fragmentation", fragmentation);
+            bench_report_end();
+        }
+    }
+
+    for (int32_t slot = 0; slot < FRAGMENTATION_MAX_LIVE; ++slot) {
+        if (live[slot]) {
+            for (int32_t t = 0; t < FRAGMENTATION_TARGET_COUNT; ++t) {
+                fragmentation_dealloc(&targets[t], slot);
+            }
+        }
+    }
+
+    for (int32_t t = 0; t < FRAGMENTATION_TARGET_COUNT; ++t) {
+        if (targets[t].use_handles) {
+            handle_heap_deinit(&targets[t].handles);
+        } else {
+            heap_deinit(&targets[t].heap);
+        }
+    }
+}
@@ -0,0 +1,252 @@
+#include <SDL3/SDL.h>
+#include <stb_image.h>
+#include <stdio.h>
+
+#include "bench.h"
+#include "image.h"
+#include "memory.h"
+
+#define IMAGE_LOAD_COUNT    64
+#define IMAGE_LOAD_FILE     "images/mondrian.png"
+#define IMAGE_DECODE_COUNT  64
+#define IMAGE_DECODE_ROUNDS 8
+#define IMAGE_PADDED_PITCH  256 // Bytes added to every row, like the row alignment some upload paths require.
+#define IMAGE_HEAP_COUNT    64
+
+static const int32_t g_worker_counts[] = { 1, 2, 4, 8 };
+
+// Stands in for the textures loaded at startup, all of them decoded from the same source image.
+static double run_sync_loads(void)
+{
+    uint64_t begin = bench_now_ns();
+
+    for (int32_t i = 0; i < IMAGE_LOAD_COUNT; ++i) {
+        image_t image = load_image(IMAGE_LOAD_FILE);
+        free_image(&image);
+    }
+
+    return (double)(bench_now_ns() - begin) / 1e6;
+}
+
+// Queues every load up front and then waits for them in order, which is how startup uses the loader. Returns a
+// negative time when a load failed.
+static double run_async_loads(const int32_t worker_count)
+{
+    if (!start_image_loader((image_loader_desc_t){ .worker_count = worker_count })) {
+        return -1.0;
+    }
+
+    image_request_t requests[IMAGE_LOAD_COUNT];
+    bool failed = false;
+
+    uint64_t begin = bench_now_ns();
+
+    for (int32_t i = 0; i < IMAGE_LOAD_COUNT; ++i) {
+        requests[i] = load_image_async(IMAGE_LOAD_FILE, NULL, NULL);
+    }
+    for (int32_t i = 0; i < IMAGE_LOAD_COUNT; ++i) {
+        image_t image = {};
+        failed |= wait_image_request(requests[i], &image) != IMAGE_REQUEST_LOADED;
+        free_image(&image);
+    }
+
+    const double elapsed_ms = (double)(bench_now_ns() - begin) / 1e6;
+
+    stop_image_loader();
+    return failed ? -1.0 : elapsed_ms;
+}
+
+void bench_image_load(void)
+{
+    // Warms the page cache, so every run below decodes from memory.
+    image_t image = load_image(IMAGE_LOAD_FILE);
+    if (image.data == NULL) {
+        printf("image load: skipped, %s not found\n", IMAGE_LOAD_FILE);
+        return;
+    }
+    printf("image load: %d loads of %s, %dx%d, on %d logical cores\n", IMAGE_LOAD_COUNT, IMAGE_LOAD_FILE, image.width, image.height, SDL_GetNumLogicalCPUCores());
+    free_image(&image);
+
+    const double sync_ms = run_sync_loads();
+
+    printf("%-10s %8s %10s %12s %8s\n", "mode", "workers", "total ms", "ms/image", "speedup");
+    printf("%-10s %8d %10.2f %12.3f %8.2f\n", "sync", 0, sync_ms, sync_ms / IMAGE_LOAD_COUNT, 1.0);
+
+    bench_report_begin("image_load", "sync");
+    bench_report_number("workers", 0);
+    bench_report_number("total_ms", sync_ms);
+    bench_report_number("ms_per_image", sync_ms / IMAGE_LOAD_COUNT);
+    bench_report_end();
+
+    for (int32_t i = 0; i < (int32_t)SDL_arraysize(g_worker_counts); ++i) {
+        const int32_t worker_count = g_worker_counts[i];
+        const double async_ms = run_async_loads(worker_count);
+        if (async_ms < 0.0) {
+            printf("%-10s %8d %10s\n", "async", worker_count, "failed");
+            continue;
+        }
+
+        printf("%-10s %8d %10.2f %12.3f %8.2f\n", "async", worker_count, async_ms, async_ms / IMAGE_LOAD_COUNT, sync_ms / async_ms);
+
+        bench_report_begin("image_load", "async");
+        bench_report_number("workers", worker_count);
+        bench_report_number("total_ms", async_ms);
+        bench_report_number("ms_per_image", async_ms / IMAGE_LOAD_COUNT);
+        bench_report_end();
+    }
+}
+
+typedef enum image_decode_mode_t image_decode_mode_t;
+enum image_decode_mode_t
+{
+    IMAGE_DECODE_IN_PLACE,  // load_image alone, stb_image unfilters in the output block like it did in the destination.
+    IMAGE_DECODE_LOAD_COPY, // load_image, then copy the pixels to the destination, the old upload path.
+    IMAGE_DECODE_TIGHT,     // decode_image with a tight pitch, staged in the arena and copied to the destination.
+    IMAGE_DECODE_PADDED,    // decode_image with padded rows, staged the same way.
+    IMAGE_DECODE_MODE_COUNT,
+};
+
+static const char *g_image_decode_mode_names[IMAGE_DECODE_MODE_COUNT] = { "in_place", "load_copy", "tight", "padded" };
+
+// The destination stands in for a mapped transfer buffer. Upload memory is often write-combined, where the reads
+// stb_image makes of earlier rows while unfiltering are very slow, so decode_image only ever writes it. Cached memory
+// cannot show that cost, what in_place against tight does show is what staging the rows costs where reads are cheap.
+static double run_decodes(const image_decode_mode_t mode, uint8_t *dst)
+{
+    uint64_t begin = bench_now_ns();
+
+    for (int32_t i = 0; i < IMAGE_DECODE_COUNT; ++i) {
+        if (mode == IMAGE_DECODE_IN_PLACE || mode == IMAGE_DECODE_LOAD_COPY) {
+            image_t image = load_image(IMAGE_LOAD_FILE);
+            if (mode == IMAGE_DECODE_LOAD_COPY) {
+                SDL_memcpy(dst, image.data, (size_t)image.pitch * image.height);
+            }
+            free_image(&image);
+            continue;
+        }
+
+        image_source_t source;
+        if (!open_image(IMAGE_LOAD_FILE, &source)) {
+            return 0.0;
+        }
+        const int32_t row_size = source.width * image_format_bytes_per_pixel(source.format);
+        decode_image(&source, dst, mode == IMAGE_DECODE_TIGHT ? row_size : row_size + IMAGE_PADDED_PITCH);
+        close_image(&source);
+    }
+
+    return (double)(bench_now_ns() - begin) / 1e6 / IMAGE_DECODE_COUNT;
+}
+
+void bench_image_decode(void)
+{
+    image_source_t source;
+    if (!open_image(IMAGE_LOAD_FILE, &source)) {
+        printf("image decode: skipped, %s not found\n", IMAGE_LOAD_FILE);
+        return;
+    }
+    const int32_t width = source.width;
+    const int32_t height = source.height;
+    close_image(&source);
+
+    heap_allocator_t *heap = mem_system_allocator();
+    const size_t image_size = (size_t)width * height * 4;
+    uint8_t *dst = heap_alloc(heap, (size_t)(width * 4 + IMAGE_PADDED_PITCH) * height, CACHE_LINE_SIZE);
+
+    printf("image decode: best of %d rounds of %d decodes of %s, %dx%d, into a destination buffer\n", IMAGE_DECODE_ROUNDS, IMAGE_DECODE_COUNT, IMAGE_LOAD_FILE, width, height);
+    printf("%-10s %12s %10s\n", "mode", "ms/image", "MB/s");
+
+    // The modes take turns and the fastest round of each counts, so a burst of noise does not decide the comparison.
+    double best_ms[IMAGE_DECODE_MODE_COUNT];
+    for (int32_t round = 0; round < IMAGE_DECODE_ROUNDS; ++round) {
+        for (int32_t mode = 0; mode < IMAGE_DECODE_MODE_COUNT; ++mode) {
+            const double ms = run_decodes((image_decode_mode_t)mode, dst);
+            best_ms[mode] = round == 0 ? ms : SDL_min(best_ms[mode], ms);
+        }
+    }
+
+    for (int32_t mode = 0; mode < IMAGE_DECODE_MODE_COUNT; ++mode) {
+        const double ms = best_ms[mode];
+        const double mb_per_s = (double)image_size / MB(1) / (ms / 1000.0);
+
+        printf("%-10s %12.3f %10.1f\n", g_image_decode_mode_names[mode], ms, mb_per_s);
+
+        bench_report_begin("image_decode", g_image_decode_mode_names[mode]);
+        bench_report_number("ms_per_image", ms);
+        bench_report_number("mb_per_s", mb_per_s);
+        bench_report_end();
+    }
+
+    heap_dealloc(heap, dst);
+}
+
+typedef struct image_heap_result_t image_heap_result_t;
+struct image_heap_result_t
+{
+    double ms_per_image;
+    heap_usage_t usage;
+};
+
+// Decodes IMAGE_HEAP_COUNT images and keeps them all, like textures loaded at startup, then looks at the system heap
+// while they are still alive. With the arena off every stb_image allocation comes from the system heap, as before
+// decodes had arenas of their own.
+static void run_heap_loads(const bool arena, image_heap_result_t *result)
+{
+    heap_allocator_t *heap = mem_system_allocator();
+    void *images[IMAGE_HEAP_COUNT] = { 0 };
+
+    uint64_t begin = bench_now_ns();
+
+    for (int32_t i = 0; i < IMAGE_HEAP_COUNT; ++i) {
+        if (arena) {
+            images[i] = load_image(IMAGE_LOAD_FILE).data;
+            continue;
+        }
+
+        image_source_t source;
+        if (open_image(IMAGE_LOAD_FILE, &source)) {
+            int32_t width, height, comp;
+            images[i] = stbi_load_from_memory(source.file.data, (int32_t)source.file.size, &width, &height, &comp, 4);
+            close_image(&source);
+        }
+    }
+
+    result->ms_per_image = (double)(bench_now_ns() - begin) / 1e6 / IMAGE_HEAP_COUNT;
+    heap_usage(heap, &result->usage);
+
+    for (int32_t i = 0; i < IMAGE_HEAP_COUNT; ++i) {
+        stbi_image_free(images[i]);
+    }
+}
+
+static double heap_fragmentation(const heap_usage_t *usage)
+{
+    return usage->free_size > 0 ? 1.0 - (double)usage->largest_free_size / (double)usage->free_size : 0.0;
+}
+
+void bench_image_heap(void)
+{
+    heap_usage_t before;
+    heap_usage(mem_system_allocator(), &before);
+
+    printf("image heap: system heap with %d decodes of %s kept alive\n", IMAGE_HEAP_COUNT, IMAGE_LOAD_FILE);
+    printf("%-8s %10s %12s %10s %10s %12s %14s\n", "decode", "ms/image", "committed MB", "used MB", "free MB", "free blocks", "fragmentation");
+    printf("%-8s %10s %12.2f %10.2f %10.2f %12d %14.3f\n", "before", "-", (double)before.committed_size / MB(1), (double)before.used_size / MB(1), (double)before.free_size / MB(1), before.free_count, heap_fragmentation(&before));
+
+    static const char *names[2] = { "heap", "arena" };
+    for (int32_t i = 0; i < 2; ++i) {
+        image_heap_result_t result;
+        run_heap_loads(i == 1, &result);
+
+        const heap_usage_t *usage = &result.usage;
+        printf("%-8s %10.3f %12.2f %10.2f %10.2f %12d %14.3f\n", names[i], result.ms_per_image, (double)usage->committed_size / MB(1), (double)usage->used_size / MB(1), (double)usage->free_size / MB(1), usage->free_count, heap_fragmentation(usage));
+
+        bench_report_begin("image_heap", names[i]);
+        bench_report_number("ms_per_image", result.ms_per_image);
+        bench_report_number("committed_size", (double)usage->committed_size);
+        bench_report_number("used_size", (double)usage->used_size);
+        bench_report_number("free_size", (double)usage->free_size);
+        bench_report_number("free_count", usage->free_count);
+        bench_report_number("fragmentation", heap_fragmentation(usage));
+        bench_report_end();
+    }
+}
@@ -0,0 +1,203 @@
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "bench.h"
+#include "log.h"
+#include "memory.h"
+
+#define LATENCY_MAX_THREADS        16
+#define LATENCY_MESSAGES_PER_THREAD 20000
+#define LATENCY_BINARY_LOG_PATH     "bench_log_latency.blog"
+
+typedef struct latency_mode_t latency_mode_t;
+struct latency_mode_t
+{
+    const char *name;
+    log_system_desc_t desc;
+};
+
+static const latency_mode_t g_latency_modes[] = {
+    { "sync", { .async = false } },
+    { "async_drop", { .async = true, .overflow = LOG_OVERFLOW_DROP } },
+    { "async_block", { .async = true, .overflow = LOG_OVERFLOW_BLOCK } },
+    { "async_binary", { .async = true, .overflow = LOG_OVERFLOW_DROP, .binary_path = LATENCY_BINARY_LOG_PATH, .binary_only = true } },
+};
+
+typedef struct latency_worker_t latency_worker_t;
+struct latency_worker_t
+{
+    int32_t index;
+    uint64_t *latencies;
+    SDL_AtomicInt *start;
+};
+
+static uint64_t g_latencies[LATENCY_MAX_THREADS * LATENCY_MESSAGES_PER_THREAD];
+
+// Writes every message to a temporary file, so the writer pays for real I/O without flooding the terminal.
+static void latency_log_output(void *user, int category, SDL_LogPriority priority, const char *message)
+{
+    fprintf((FILE *)user, "%d %d %s\n", category, (int)priority, message);
+}
+
+static int latency_worker(void *user)
+{
+    latency_worker_t *worker = (latency_worker_t *)user;
+
+    while (SDL_GetAtomicInt(worker->start) == 0) {
+        SDL_CPUPauseInstruction();
+    }
+
+    for (int32_t i = 0; i < LATENCY_MESSAGES_PER_THREAD; ++i) {
+        uint64_t begin = bench_now_ns();
+        log_info(LOG_CATEGORY_APPLICATION, "Latency message %d from thread %d, value %.3f.", i, worker->index, i * 0.5);
+        worker->latencies[i] = bench_now_ns() - begin;
+    }
+
+    return 0;
+}
+
+static int compare_latency(const void *a, const void *b)
+{
+    const uint64_t x = *(const uint64_t *)a;
+    const uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// Times each log_info call on the producing threads. The writer thread is not timed, only how long a producer is held
+// up by formatting, contention on the ring and, in sync mode, the output itself.
+void bench_log_latency(void)
+{
+    const int32_t thread_counts[] = { 1, 2, 4, 8, 16 };
+
+    FILE *sink = tmpfile();
+    if (sink == NULL) {
+        printf("log latency: failed to create a temporary file\n");
+        return;
+    }
+
+    SDL_LogOutputFunction previous_output;
+    void *previous_user;
+    SDL_GetLogOutputFunction(&previous_output, &previous_user);
+
+    printf("log latency: %d messages per thread, ring of %d\n", LATENCY_MESSAGES_PER_THREAD, LOG_DEFAULT_RING_CAPACITY);
+    printf("%-12s %8s %10s %10s %10s %10s\n", "mode", "threads", "p50 ns", "p99 ns", "max ns", "dropped");
+
+    for (int32_t m = 0; m < (int32_t)SDL_arraysize(g_latency_modes); ++m) {
+        for (int32_t t = 0; t < (int32_t)SDL_arraysize(thread_counts); ++t) {
+            const int32_t threads = thread_counts[t];
+
+            // The benchmark itself logs synchronously, only the measured section runs in the mode under test.
+            SDL_SetLogOutputFunction(latency_log_output, sink);
+            start_log_system(g_latency_modes[m].desc);
+            const int32_t dropped_before = log_dropped_count();
+
+            SDL_AtomicInt start = { 0 };
+            latency_worker_t workers[LATENCY_MAX_THREADS];
+            SDL_Thread *handles[LATENCY_MAX_THREADS];
+            for (int32_t i = 0; i < threads; ++i) {
+                workers[i] = (latency_worker_t){ .index = i, .latencies = &g_latencies[i * LATENCY_MESSAGES_PER_THREAD], .start = &start };
+                handles[i] = SDL_CreateThread(latency_worker, "log latency", &workers[i]);
+            }
+
+            SDL_SetAtomicInt(&start, 1);
+            for (int32_t i = 0; i < threads; ++i) {
+                SDL_WaitThread(handles[i], NULL);
+            }
+
+            stop_log_system();
+            const int32_t dropped = log_dropped_count() - dropped_before;
+            SDL_SetLogOutputFunction(previous_output, previous_user);
+
+            const int32_t count = threads * LATENCY_MESSAGES_PER_THREAD;
+            SDL_qsort(g_latencies, count, sizeof(uint64_t), compare_latency);
+            const double p50 = (double)g_latencies[count / 2];
+            const double p99 = (double)g_latencies[count - count / 100 - 1];
+            const double max = (double)g_latencies[count - 1];
+
+            printf("%-12s %8d %10.0f %10.0f %10.0f %10d\n", g_latency_modes[m].name, threads, p50, p99, max, dropped);
+
+            bench_report_begin("log_latency", g_latency_modes[m].name);
+            bench_report_number("threads", threads);
+            bench_report_number("p50_ns", p50);
+            bench_report_number("p99_ns", p99);
+            bench_report_number("max_ns", max);
+            bench_report_number("dropped", dropped);
+            bench_report_end();
+        }
+    }
+
+    fclose(sink);
+    SDL_RemovePath(LATENCY_BINARY_LOG_PATH);
+}
+
+#define STARTUP_MESSAGES 4000
+
+typedef struct startup_result_t startup_result_t;
+struct startup_result_t
+{
+    bool prepared;
+    double ns_per_message;
+    double drain_ns;
+    int32_t dropped;
+};
+
+static startup_result_t g_startup_result;
+
+// Runs before bodies_bench starts the log system: logs a burst shaped like memory system startup, then times
+// start_log_system writing the stash out. The results are reported when the log_startup suite runs.
+void bench_log_startup_prepare(void)
+{
+    FILE *sink = tmpfile();
+    if (sink == NULL) {
+        return;
+    }
+
+    SDL_LogOutputFunction previous_output;
+    void *previous_user;
+    SDL_GetLogOutputFunction(&previous_output, &previous_user);
+    SDL_SetLogOutputFunction(latency_log_output, sink);
+
+    const int32_t dropped_before = log_dropped_count();
+
+    uint64_t begin = bench_now_ns();
+    for (int32_t i = 0; i < STARTUP_MESSAGES; ++i) {
+        log_info(LOG_CATEGORY_MEMORY, "Heap allocator initialised with %llu bytes reserved across %d shards, backed by %s.", (unsigned long long)GB(4) + i, 1 + i % 8, "small pages");
+    }
+    const uint64_t log_ns = bench_now_ns() - begin;
+
+    begin = bench_now_ns();
+    start_log_system((log_system_desc_t){ .async = false });
+    const uint64_t drain_ns = bench_now_ns() - begin;
+
+    SDL_SetLogOutputFunction(previous_output, previous_user);
+    fclose(sink);
+
+    g_startup_result = (startup_result_t){
+        .prepared = true,
+        .ns_per_message = (double)log_ns / STARTUP_MESSAGES,
+        .drain_ns = (double)drain_ns,
+        .dropped = log_dropped_count() - dropped_before,
+    };
+}
+
+void bench_log_startup(void)
+{
+    if (!g_startup_result.prepared) {
+        printf("log startup: not measured, the log system was already started\n");
+        return;
+    }
+
+    const int32_t written = STARTUP_MESSAGES - g_startup_result.dropped;
+    printf("log startup: %d messages before start, stash of %d bytes\n", STARTUP_MESSAGES, LOG_STASH_SIZE);
+    printf("%12s %10s %10s %14s %16s\n", "ns/message", "written", "dropped", "drain us", "drain ns/written");
+    printf("%12.1f %10d %10d %14.1f %16.1f\n", g_startup_result.ns_per_message, written, g_startup_result.dropped, g_startup_result.drain_ns / 1000.0, written > 0 ? g_startup_result.drain_ns / written : 0.0);
+
+    bench_report_begin("log_startup", "stash");
+    bench_report_number("messages", STARTUP_MESSAGES);
+    bench_report_number("ns_per_message", g_startup_result.ns_per_message);
+    bench_report_number("written", written);
+    bench_report_number("dropped", g_startup_result.dropped);
+    bench_report_number("drain_ns", g_startup_result.drain_ns);
+    bench_report_end();
+}
@@ -0,0 +1,159 @@
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "bench.h"
+#include "log.h"
+#include "memory.h"
+
+typedef struct bench_suite_t bench_suite_t;
+struct bench_suite_t
+{
+    const char *name;
+    void (*run)(void);
+};
+
+static const bench_suite_t g_suites[] = {
+    { "alloc_sizes", bench_alloc_sizes },
+    { "stb_realloc", bench_alloc_stb_realloc },
+    { "log_churn", bench_alloc_log_churn },
+    { "file_read", bench_file_read },
+    { "heap_contention", bench_heap_contention },
+    { "heap_footprint", bench_heap_footprint },
+    { "heap_fragmentation", bench_heap_fragmentation },
+    { "image_load", bench_image_load },
+    { "image_decode", bench_image_decode },
+    { "image_heap", bench_image_heap },
+    { "pool_churn", bench_pool_churn },
+    { "log_latency", bench_log_latency },
+    { "log_startup", bench_log_startup },
+    { "profile_zones", bench_profile_zones },
+    { "texture_startup", bench_texture_startup },
+    { "tlb", bench_vm_tlb },
+};
+
+static FILE *g_report_file;
+static int32_t g_report_count;
+static int32_t g_report_field_count;
+
+uint64_t bench_now_ns(void)
+{
+    return SDL_GetTicksNS();
+}
+
+uint64_t bench_rand(uint64_t *state)
+{
+    // xorshift64*, so every run with the same seed sees the same sequence.
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+void bench_report_begin(const char *suite, const char *name)
+{
+    if (g_report_file == NULL) {
+        return;
+    }
+
+    fprintf(g_report_file, "%s\n  {", g_report_count++ == 0 ? "" : ",");
+    g_report_field_count = 0;
+    bench_report_string("suite", suite);
+    bench_report_string("name", name);
+}
+
+// Keys and values are our own identifiers, so nothing needs escaping.
+void bench_report_string(const char *key, const char *value)
+{
+    if (g_report_file != NULL) {
+        fprintf(g_report_file, "%s\"%s\": \"%s\"", g_report_field_count++ == 0 ? "" : ", ", key, value);
+    }
+}
+
+void bench_report_number(const char *key, double value)
+{
+    if (g_report_file != NULL) {
+        fprintf(g_report_file, "%s\"%s\": %.17g", g_report_field_count++ == 0 ? "" : ", ", key, value);
+    }
+}
+
+void bench_report_end(void)
+{
+    if (g_report_file != NULL) {
+        fprintf(g_report_file, "}");
+    }
+}
+
+static bool bench_selected(const char *name, int argc, char **argv)
+{
+    bool any_selected = false;
+    for (int i = 1; i < argc; ++i) {
+        if (SDL_strcmp(argv[i], "--json") == 0) {
+            ++i;
+            continue;
+        }
+
+        any_selected = true;
+        if (SDL_strcmp(argv[i], name) == 0) {
+            return true;
+        }
+    }
+    return !any_selected;
+}
+
+int main(int argc, char **argv)
+{
+    const char *json_path = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (SDL_strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        }
+    }
+
+    if (!start_memory_system((memory_system_desc_t){
+            .system_reserve_size = GB(4),
+            .system_pool_size = MB(1),
+            .scratch_memory_size = MB(5),
+            .frame_memory_size = MB(2),
+        })) {
+        return 1;
+    }
+
+    if (!SDL_Init(0)) {
+        log_error(LOG_CATEGORY_APPLICATION, "Failed to initialize SDL: %s", SDL_GetError());
+        return 1;
+    }
+
+    if (bench_selected("log_startup", argc, argv)) {
+        bench_log_startup_prepare();
+    }
+
+    start_log_system((log_system_desc_t){ .async = false });
+
+    if (json_path != NULL) {
+        g_report_file = fopen(json_path, "w");
+        if (g_report_file == NULL) {
+            log_error(LOG_CATEGORY_APPLICATION, "Failed to open %s for writing.", json_path);
+            return 1;
+        }
+        fprintf(g_report_file, "[");
+    }
+
+    for (int32_t i = 0; i < (int32_t)SDL_arraysize(g_suites); ++i) {
+        if (bench_selected(g_suites[i].name, argc, argv)) {
+            g_suites[i].run();
+            printf("\n");
+        }
+    }
+
+    if (g_report_file != NULL) {
+        fprintf(g_report_file, "\n]\n");
+        fclose(g_report_file);
+    }
+
+    stop_memory_system();
+
+    return 0;
+}
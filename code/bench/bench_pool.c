@@ -0,0 +1,112 @@
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "bench.h"
+#include "memory.h"
+
+#define POOL_CHURN_OPS    2000000
+#define POOL_CHURN_LIVE   4096
+#define POOL_CHURN_BATCH  64
+#define POOL_SLAB_SIZE    KB(64)
+
+typedef enum churn_pattern_t churn_pattern_t;
+enum churn_pattern_t
+{
+    CHURN_PATTERN_BATCH,  // Allocate a batch, free it in reverse, like per-frame records.
+    CHURN_PATTERN_RANDOM, // Free a random live block and replace it, like long-lived records coming and going.
+};
+
+typedef struct churn_target_t churn_target_t;
+struct churn_target_t
+{
+    heap_allocator_t *heap;
+    pool_allocator_t *pool;
+    size_t block_size;
+};
+
+static void *churn_alloc(churn_target_t *target)
+{
+    if (target->pool != NULL) {
+        return pool_alloc(target->pool);
+    }
+    return heap_alloc(target->heap, target->block_size, MEM_DEFAULT_ALIGN);
+}
+
+static void churn_dealloc(churn_target_t *target, void *mem)
+{
+    if (target->pool != NULL) {
+        pool_dealloc(target->pool, mem);
+    } else {
+        heap_dealloc(target->heap, mem);
+    }
+}
+
+static double run_churn(churn_target_t *target, churn_pattern_t pattern)
+{
+    static void *live[POOL_CHURN_LIVE];
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+
+    for (int32_t i = 0; i < POOL_CHURN_LIVE; ++i) {
+        live[i] = pattern == CHURN_PATTERN_RANDOM ? churn_alloc(target) : NULL;
+    }
+
+    uint64_t begin = bench_now_ns();
+
+    if (pattern == CHURN_PATTERN_BATCH) {
+        for (int32_t op = 0; op < POOL_CHURN_OPS; op += POOL_CHURN_BATCH) {
+            for (int32_t i = 0; i < POOL_CHURN_BATCH; ++i) {
+                live[i] = churn_alloc(target);
+            }
+            for (int32_t i = POOL_CHURN_BATCH - 1; i >= 0; --i) {
+                churn_dealloc(target, live[i]);
+                live[i] = NULL;
+            }
+        }
+    } else {
+        for (int32_t op = 0; op < POOL_CHURN_OPS; ++op) {
+            uint64_t slot = bench_rand(&rng) % POOL_CHURN_LIVE;
+            churn_dealloc(target, live[slot]);
+            live[slot] = churn_alloc(target);
+        }
+    }
+
+    uint64_t elapsed = bench_now_ns() - begin;
+
+    for (int32_t i = 0; i < POOL_CHURN_LIVE; ++i) {
+        churn_dealloc(target, live[i]);
+    }
+
+    return (double)elapsed / POOL_CHURN_OPS;
+}
+
+void bench_pool_churn(void)
+{
+    heap_allocator_t *heap = mem_system_allocator();
+    const size_t block_sizes[] = { 32, 64, 256 };
+    const char *patterns[] = { "batch", "random" };
+
+    printf("pool churn: %d ops, %d live blocks for random churn\n", POOL_CHURN_OPS, POOL_CHURN_LIVE);
+    printf("%-8s %6s %12s %12s %8s\n", "pattern", "size", "heap ns/op", "pool ns/op", "speedup");
+
+    for (int32_t p = 0; p < (int32_t)SDL_arraysize(patterns); ++p) {
+        for (int32_t b = 0; b < (int32_t)SDL_arraysize(block_sizes); ++b) {
+            churn_target_t heap_target = { .heap = heap, .block_size = block_sizes[b] };
+            double heap_ns = run_churn(&heap_target, (churn_pattern_t)p);
+
+            pool_allocator_t pool;
+            pool_init_growable(&pool, block_sizes[b], MEM_DEFAULT_ALIGN, POOL_SLAB_SIZE, heap);
+            churn_target_t pool_target = { .pool = &pool, .block_size = block_sizes[b] };
+            double pool_ns = run_churn(&pool_target, (churn_pattern_t)p);
+            pool_deinit(&pool);
+
+            printf("%-8s %6llu %12.2f %12.2f %7.2fx\n", patterns[p], (unsigned long long)block_sizes[b], heap_ns, pool_ns, heap_ns / pool_ns);
+
+            bench_report_begin("pool_churn", patterns[p]);
+            bench_report_number("block_size", (double)block_sizes[b]);
+            bench_report_number("heap_ns_per_op", heap_ns);
+            bench_report_number("pool_ns_per_op", pool_ns);
+            bench_report_end();
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#include <SDL3/SDL.h>
+#include <stdio.h>
+
+#include "bench.h"
+#include "profile.h"
+
+#define PROFILE_ZONE_OPS   2000000
+#define PROFILE_ZONE_DEPTH 4
+#define PROFILE_DUMP_PATH  "bench_profile.trace.json"
+
+// Zones nested PROFILE_ZONE_DEPTH deep, like a frame with passes inside. The work in the innermost zone only keeps the
+// loop from being folded away when the profiler is compiled out.
+static double run_nested_zones(void)
+{
+    static const char *names[PROFILE_ZONE_DEPTH] = { "frame", "pass", "draw", "upload" };
+    volatile uint64_t sink = 0;
+
+    uint64_t begin = bench_now_ns();
+
+    for (int32_t op = 0; op < PROFILE_ZONE_OPS; op += PROFILE_ZONE_DEPTH) {
+        for (int32_t d = 0; d < PROFILE_ZONE_DEPTH; ++d) {
+            PROFILE_BEGIN(names[d]);
+        }
+        sink += op;
+        for (int32_t d = 0; d < PROFILE_ZONE_DEPTH; ++d) {
+            PROFILE_END();
+        }
+    }
+
+    uint64_t elapsed = bench_now_ns() - begin;
+    (void)sink;
+
+    return (double)elapsed / PROFILE_ZONE_OPS;
+}
+
+void bench_profile_zones(void)
+{
+#if FEATURE_PROFILER
+    const char *mode = "enabled";
+#else
+    const char *mode = "disabled";
+#endif
+
+    profile_set_thread_name("bench");
+
+    const double zone_ns = run_nested_zones();
+
+    uint64_t begin = bench_now_ns();
+    const bool dumped = profile_dump_chrome_trace(PROFILE_DUMP_PATH);
+    const double dump_ms = (double)(bench_now_ns() - begin) / 1e6;
+    SDL_RemovePath(PROFILE_DUMP_PATH);
+
+    printf("profile zones: %d zones nested %d deep, dump of up to %d zones per thread\n", PROFILE_ZONE_OPS, PROFILE_ZONE_DEPTH, PROFILE_EVENT_COUNT);
+    printf("%-9s %10s %10s\n", "profiler", "ns/zone", "dump ms");
+    printf("%-9s %10.2f %10.2f\n", mode, zone_ns, dumped ? dump_ms : 0.0);
+
+    bench_report_begin("profile_zones", mode);
+    bench_report_number("ns_per_zone", zone_ns);
+    bench_report_number("dump_ms", dumped ? dump_ms : 0.0);
+    bench_report_end();
+}
@@ -0,0 +1,104 @@
+#include <SDL3/SDL.h>
+#include <stdio.h>
+
+#include "bench.h"
+#include "image.h"
+#include "memory.h"
+#include "texture_cache.h"
+
+#define TEXTURE_STARTUP_COUNT  64
+#define TEXTURE_STARTUP_ROUNDS 8
+#define TEXTURE_STARTUP_FILE   "images/mondrian.png"
+#define TEXTURE_CACHE_DIR      "bench_texture_cache"
+#define TEXTURE_COOKED_FILE    TEXTURE_CACHE_DIR "/images_mondrian.png.btex"
+
+// What startup did before textures were cooked: the PNG is decoded into the destination, which stands in for a mapped
+// transfer buffer.
+static double run_png_loads(uint8_t *dst)
+{
+    uint64_t begin = bench_now_ns();
+
+    for (int32_t i = 0; i < TEXTURE_STARTUP_COUNT; ++i) {
+        image_source_t source;
+        if (!open_image(TEXTURE_STARTUP_FILE, &source)) {
+            return 0.0;
+        }
+        decode_image(&source, dst, source.width * image_format_bytes_per_pixel(source.format));
+        close_image(&source);
+    }
+
+    return (double)(bench_now_ns() - begin) / 1e6 / TEXTURE_STARTUP_COUNT;
+}
+
+// The cooked file is mapped and its whole mip chain copied into the destination, checking the source hash on the way.
+static double run_cooked_loads(uint8_t *dst)
+{
+    uint64_t begin = bench_now_ns();
+
+    for (int32_t i = 0; i < TEXTURE_STARTUP_COUNT; ++i) {
+        cooked_texture_t texture;
+        if (!load_cooked_texture(TEXTURE_STARTUP_FILE, &texture)) {
+            return 0.0;
+        }
+        SDL_memcpy(dst, texture.levels[0].data, texture.data_size);
+        free_cooked_texture(&texture);
+    }
+
+    return (double)(bench_now_ns() - begin) / 1e6 / TEXTURE_STARTUP_COUNT;
+}
+
+void bench_texture_startup(void)
+{
+    SDL_RemovePath(TEXTURE_COOKED_FILE);
+    start_texture_cache((texture_cache_desc_t){ .directory = TEXTURE_CACHE_DIR });
+
+    // The first load finds no cooked file and cooks it, which is what the first run pays once.
+    uint64_t begin = bench_now_ns();
+    cooked_texture_t texture;
+    if (!load_cooked_texture(TEXTURE_STARTUP_FILE, &texture)) {
+        printf("texture startup: skipped, failed to cook %s\n", TEXTURE_STARTUP_FILE);
+        stop_texture_cache();
+        return;
+    }
+    const double cook_ms = (double)(bench_now_ns() - begin) / 1e6;
+    const size_t data_size = texture.data_size;
+
+    printf("texture startup: best of %d rounds of %d loads of %s, %dx%d with %d levels\n", TEXTURE_STARTUP_ROUNDS, TEXTURE_STARTUP_COUNT, TEXTURE_STARTUP_FILE, texture.width, texture.height, texture.level_count);
+    free_cooked_texture(&texture);
+
+    heap_allocator_t *heap = mem_system_allocator();
+    uint8_t *dst = heap_alloc(heap, data_size, CACHE_LINE_SIZE);
+
+    // Both take turns and the fastest round counts, so a burst of noise does not decide the comparison.
+    double png_ms = 0.0;
+    double cooked_ms = 0.0;
+    for (int32_t round = 0; round < TEXTURE_STARTUP_ROUNDS; ++round) {
+        const double png = run_png_loads(dst);
+        const double cooked = run_cooked_loads(dst);
+        png_ms = round == 0 ? png : SDL_min(png_ms, png);
+        cooked_ms = round == 0 ? cooked : SDL_min(cooked_ms, cooked);
+    }
+
+    printf("%-8s %12s %8s\n", "load", "ms/image", "speedup");
+    printf("%-8s %12.3f %8s\n", "cook", cook_ms, "-");
+    printf("%-8s %12.3f %8.2f\n", "png", png_ms, 1.0);
+    printf("%-8s %12.3f %8.2f\n", "cooked", cooked_ms, png_ms / cooked_ms);
+
+    bench_report_begin("texture_startup", "cook");
+    bench_report_number("ms_per_image", cook_ms);
+    bench_report_end();
+
+    bench_report_begin("texture_startup", "png");
+    bench_report_number("ms_per_image", png_ms);
+    bench_report_end();
+
+    bench_report_begin("texture_startup", "cooked");
+    bench_report_number("ms_per_image", cooked_ms);
+    bench_report_number("bytes", (double)data_size);
+    bench_report_end();
+
+    heap_dealloc(heap, dst);
+    stop_texture_cache();
+    SDL_RemovePath(TEXTURE_COOKED_FILE);
+    SDL_RemovePath(TEXTURE_CACHE_DIR);
+}
@@ -0,0 +1,65 @@
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "bench.h"
+#include "memory.h"
+
+#define TLB_WORKING_SET_SIZES_COUNT 3
+#define TLB_ACCESSES                20000000
+
+// Random read-modify-writes over a working set much larger than the TLB reach of small pages, so nearly every access
+// misses the TLB unless the arena is backed by huge pages.
+static double run_tlb(size_t working_set_size, bool huge_pages, vm_backing_t *backing)
+{
+    linear_allocator_t arena;
+    if (!linear_init_virtual(&arena, working_set_size, 0, huge_pages)) {
+        *backing = VM_BACKING_SMALL_PAGES;
+        return 0.0;
+    }
+
+    *backing = arena.backing;
+
+    const size_t count = working_set_size / sizeof(uint64_t);
+    uint64_t *data = linear_alloc(&arena, count * sizeof(uint64_t), MEM_DEFAULT_ALIGN);
+
+    // Touch everything first so page faults are not part of the measurement.
+    for (size_t i = 0; i < count; ++i) {
+        data[i] = i;
+    }
+
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    uint64_t begin = bench_now_ns();
+    for (int32_t i = 0; i < TLB_ACCESSES; ++i) {
+        data[bench_rand(&rng) % count] += 1;
+    }
+    uint64_t elapsed = bench_now_ns() - begin;
+
+    linear_reset(&arena);
+    linear_deinit(&arena);
+    return (double)elapsed / TLB_ACCESSES;
+}
+
+void bench_vm_tlb(void)
+{
+    const size_t working_set_sizes[TLB_WORKING_SET_SIZES_COUNT] = { MB(16), MB(64), MB(256) };
+
+    printf("tlb: %d random accesses per working set\n", TLB_ACCESSES);
+    printf("%10s %14s %14s %8s  %s\n", "set", "small ns/op", "huge ns/op", "speedup", "huge backing");
+
+    for (int32_t s = 0; s < TLB_WORKING_SET_SIZES_COUNT; ++s) {
+        vm_backing_t small_backing;
+        vm_backing_t huge_backing;
+        double small_ns = run_tlb(working_set_sizes[s], false, &small_backing);
+        double huge_ns = run_tlb(working_set_sizes[s], true, &huge_backing);
+
+        printf("%9lluM %14.2f %14.2f %7.2fx  %s\n", (unsigned long long)(working_set_sizes[s] / MB(1)), small_ns, huge_ns, small_ns / huge_ns, vm_backing_name(huge_backing));
+
+        bench_report_begin("tlb", "random_rmw");
+        bench_report_number("working_set_size", (double)working_set_sizes[s]);
+        bench_report_number("small_ns_per_op", small_ns);
+        bench_report_number("huge_ns_per_op", huge_ns);
+        bench_report_string("huge_backing", vm_backing_name(huge_backing));
+        bench_report_end();
+    }
+}
@@ -8,5 +8,6 @@
 #define GPU_SHADER_CREATION_ERROR            -5
 #define GPU_GRAPHICS_PIPELINE_CREATION_ERROR -6
 #define GPU_TEXTURE_CREATION_ERROR           -7
+#define IMAGE_LOAD_ERROR                     -8
 
 #endif // ERROR_H
@@ -0,0 +1,109 @@
+#include "file.h"
+
+#include <SDL3/SDL.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool map_file(const char *path, const file_access_t access, file_view_t *view)
+{
+    *view = (file_view_t){};
+
+#if defined(_WIN32)
+    const DWORD flags = access == FILE_ACCESS_SEQUENTIAL ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | flags, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return SDL_SetError("Failed to open %s, CreateFile failed with %lu", path, GetLastError());
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || (uint64_t)size.QuadPart > SIZE_MAX) {
+        CloseHandle(handle);
+        return SDL_SetError("Failed to determine the size of %s", path);
+    }
+
+    // A mapping cannot be made of an empty file.
+    if (size.QuadPart == 0) {
+        CloseHandle(handle);
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(handle);
+    if (mapping == NULL) {
+        return SDL_SetError("Failed to map %s, CreateFileMapping failed with %lu", path, GetLastError());
+    }
+
+    // The view keeps the mapping alive once it is mapped.
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (data == NULL) {
+        return SDL_SetError("Failed to map %s, MapViewOfFile failed with %lu", path, GetLastError());
+    }
+
+    if (access == FILE_ACCESS_SEQUENTIAL) {
+        WIN32_MEMORY_RANGE_ENTRY range = { .VirtualAddress = data, .NumberOfBytes = (SIZE_T)size.QuadPart };
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+
+    view->data = data;
+    view->size = (size_t)size.QuadPart;
+    return true;
+#else
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return SDL_SetError("Failed to open %s", path);
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (uint64_t)info.st_size > SIZE_MAX) {
+        close(fd);
+        return SDL_SetError("Failed to determine the size of %s", path);
+    }
+
+    // mmap refuses a length of 0.
+    if (info.st_size == 0) {
+        close(fd);
+        return true;
+    }
+
+    // The mapping holds its own reference to the file, so the descriptor is not needed past this point.
+    void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return SDL_SetError("Failed to map %s", path);
+    }
+
+    if (access == FILE_ACCESS_SEQUENTIAL) {
+        madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+        madvise(data, (size_t)info.st_size, MADV_WILLNEED);
+    } else {
+        madvise(data, (size_t)info.st_size, MADV_RANDOM);
+    }
+
+    view->data = data;
+    view->size = (size_t)info.st_size;
+    return true;
+#endif
+}
+
+void unmap_file(file_view_t *view)
+{
+    if (view->data != NULL) {
+#if defined(_WIN32)
+        UnmapViewOfFile(view->data);
+#else
+        munmap((void *)view->data, view->size);
+#endif
+    }
+    *view = (file_view_t){};
+}
@@ -0,0 +1,33 @@
+#ifndef FILE_H
+#define FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Read-only views of whole files through a memory mapping. Mapping a file copies nothing: the view points straight at
+// the page cache and pages are read from disk as they are first touched, so loading an asset needs no buffer the size
+// of the file and a file that is already cached is never copied. The access pattern is passed to the kernel as a hint,
+// madvise on POSIX and a prefetch on Windows, so it reads ahead of the decoder instead of faulting page by page.
+//
+// A view stays valid until unmap_file, whatever happens to the file on disk in the meantime, as long as it is not
+// truncated. Safe to use from any thread.
+
+typedef enum file_access_t file_access_t;
+enum file_access_t
+{
+    FILE_ACCESS_SEQUENTIAL, // Read once from start to end, like a decoder walking a PNG or a shader blob.
+    FILE_ACCESS_RANDOM,     // Read in no particular order, which turns read-ahead off.
+};
+
+typedef struct file_view_t file_view_t;
+struct file_view_t
+{
+    const void *data; // NULL for an empty file.
+    size_t size;
+};
+
+// Returns false with the reason in SDL_GetError when the file cannot be opened or mapped.
+bool map_file(const char *path, file_access_t access, file_view_t *view);
+void unmap_file(file_view_t *view);
+
+#endif // FILE_H
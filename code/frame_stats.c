@@ -0,0 +1,167 @@
+#include "frame_stats.h"
+
+#include <SDL3/SDL.h>
+
+#include "log.h"
+#include "memory.h"
+
+typedef struct frame_stats_t frame_stats_t;
+struct frame_stats_t
+{
+    int32_t log_interval;
+    bool in_frame;         // Between frame_stats_begin_frame and frame_stats_end_frame of a frame that is sampled.
+    uint64_t frame_count;  // Completed frames, the newest sample is at (frame_count - 1) % FRAME_STATS_SAMPLE_COUNT.
+    uint64_t frame_begin_ns;
+    uint64_t stat_begin_ns[FRAME_STAT_COUNT];
+    uint64_t current_ns[FRAME_STAT_COUNT];
+    uint64_t samples[FRAME_STAT_COUNT][FRAME_STATS_SAMPLE_COUNT];
+};
+
+static frame_stats_t g_frame_stats;
+
+void start_frame_stats(const frame_stats_desc_t desc)
+{
+    SDL_zero(g_frame_stats);
+    g_frame_stats.log_interval = desc.log_interval;
+}
+
+void stop_frame_stats(void)
+{
+    frame_stats_log(FRAME_STATS_SAMPLE_COUNT);
+}
+
+void frame_stats_begin_frame(void)
+{
+    frame_stats_t *fs = &g_frame_stats;
+    const uint64_t now = SDL_GetTicksNS();
+
+    SDL_zeroa(fs->current_ns);
+    // The first frame has no interval to report and is left out.
+    fs->in_frame = fs->frame_begin_ns != 0;
+    fs->current_ns[FRAME_STAT_INTERVAL] = now - fs->frame_begin_ns;
+    fs->frame_begin_ns = now;
+}
+
+void frame_stats_end_frame(void)
+{
+    frame_stats_t *fs = &g_frame_stats;
+    if (!fs->in_frame) {
+        return;
+    }
+    fs->in_frame = false;
+
+    const uint64_t elapsed = SDL_GetTicksNS() - fs->frame_begin_ns;
+    const uint64_t waited = fs->current_ns[FRAME_STAT_SWAPCHAIN_WAIT];
+    fs->current_ns[FRAME_STAT_CPU] = elapsed > waited ? elapsed - waited : 0;
+
+    const uint64_t slot = fs->frame_count % FRAME_STATS_SAMPLE_COUNT;
+    for (int32_t i = 0; i < FRAME_STAT_COUNT; ++i) {
+        fs->samples[i][slot] = fs->current_ns[i];
+    }
+    ++fs->frame_count;
+
+    if (fs->log_interval > 0 && fs->frame_count % fs->log_interval == 0) {
+        frame_stats_log(fs->log_interval);
+    }
+}
+
+void frame_stats_begin(const frame_stat_t stat)
+{
+    g_frame_stats.stat_begin_ns[stat] = SDL_GetTicksNS();
+}
+
+void frame_stats_end(const frame_stat_t stat)
+{
+    g_frame_stats.current_ns[stat] += SDL_GetTicksNS() - g_frame_stats.stat_begin_ns[stat];
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    const uint64_t x = *(const uint64_t *)a;
+    const uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest rank, so every reported percentile is a frame that actually happened.
+static double percentile_ms(const uint64_t *sorted, const int32_t count, const int32_t percent)
+{
+    const int32_t rank = (count * percent + 99) / 100;
+    return (double)sorted[SDL_max(rank, 1) - 1] / SDL_NS_PER_MS;
+}
+
+bool frame_stats_summary(const frame_stat_t stat, const int32_t frame_count, frame_stats_summary_t *summary)
+{
+    const frame_stats_t *fs = &g_frame_stats;
+    const int32_t available = (int32_t)SDL_min(fs->frame_count, FRAME_STATS_SAMPLE_COUNT);
+    const int32_t count = SDL_min(frame_count, available);
+    if (count <= 0) {
+        return false;
+    }
+
+    temp_memory_t temp = temp_begin();
+    uint64_t *sorted = stack_alloc(temp.stack, count * sizeof(uint64_t), MEM_DEFAULT_ALIGN);
+    if (sorted == NULL) {
+        temp_end(temp);
+        return false;
+    }
+
+    uint64_t total = 0;
+    for (int32_t i = 0; i < count; ++i) {
+        const uint64_t frame = fs->frame_count - count + i;
+        sorted[i] = fs->samples[stat][frame % FRAME_STATS_SAMPLE_COUNT];
+        total += sorted[i];
+    }
+    SDL_qsort(sorted, count, sizeof(uint64_t), compare_u64);
+
+    *summary = (frame_stats_summary_t){
+        .frame_count = count,
+        .min_ms = (double)sorted[0] / SDL_NS_PER_MS,
+        .avg_ms = (double)total / count / SDL_NS_PER_MS,
+        .p50_ms = percentile_ms(sorted, count, 50),
+        .p95_ms = percentile_ms(sorted, count, 95),
+        .p99_ms = percentile_ms(sorted, count, 99),
+        .max_ms = (double)sorted[count - 1] / SDL_NS_PER_MS,
+    };
+
+    temp_end(temp);
+    return true;
+}
+
+uint64_t frame_stats_frame_count(void)
+{
+    return g_frame_stats.frame_count;
+}
+
+void frame_stats_log(const int32_t frame_count)
+{
+    if (!log_enabled(LOG_CATEGORY_FRAME, LOG_LEVEL_INFO)) {
+        return;
+    }
+
+    for (int32_t i = 0; i < FRAME_STAT_COUNT; ++i) {
+        frame_stats_summary_t summary;
+        if (!frame_stats_summary((frame_stat_t)i, frame_count, &summary)) {
+            return;
+        }
+
+        log_info(LOG_CATEGORY_FRAME, "Frame %s over %d frames: min %.2f, avg %.2f, p50 %.2f, p95 %.2f, p99 %.2f, max %.2f ms.", frame_stat_name((frame_stat_t)i), summary.frame_count, summary.min_ms, summary.avg_ms, summary.p50_ms, summary.p95_ms, summary.p99_ms, summary.max_ms);
+    }
+}
+
+const char *frame_stat_name(const frame_stat_t stat)
+{
+    switch (stat) {
+    case FRAME_STAT_INTERVAL:
+        return "interval";
+    case FRAME_STAT_CPU:
+        return "cpu";
+    case FRAME_STAT_EVENTS:
+        return "events";
+    case FRAME_STAT_BUILD:
+        return "build";
+    case FRAME_STAT_SWAPCHAIN_WAIT:
+        return "swapchain wait";
+    default:
+        return "unknown";
+    }
+}
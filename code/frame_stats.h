@@ -0,0 +1,62 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Timings of the frame loop. Every completed frame stores one sample per stat in a fixed ring of the last
+// FRAME_STATS_SAMPLE_COUNT frames, summaries are computed over the newest frames of that ring on request. A frame that
+// is abandoned before frame_stats_end_frame leaves no sample.
+//
+// Meant for the thread that runs the frame loop only.
+
+#define FRAME_STATS_SAMPLE_COUNT 1024
+
+typedef enum frame_stat_t frame_stat_t;
+enum frame_stat_t
+{
+    FRAME_STAT_INTERVAL,       // From the start of the previous frame to the start of this one, what pacing looks like.
+    FRAME_STAT_CPU,            // From the start of the frame to its end, less the swapchain wait.
+    FRAME_STAT_EVENTS,         // Polling and handling window events.
+    FRAME_STAT_BUILD,          // Recording and submitting command buffers.
+    FRAME_STAT_SWAPCHAIN_WAIT, // Blocked in SDL_WaitAndAcquireGPUSwapchainTexture.
+    FRAME_STAT_COUNT,
+};
+
+typedef struct frame_stats_desc_t frame_stats_desc_t;
+struct frame_stats_desc_t
+{
+    int32_t log_interval; // Frames between summaries of the frames since the last one in the log, 0 to never log.
+};
+
+typedef struct frame_stats_summary_t frame_stats_summary_t;
+struct frame_stats_summary_t
+{
+    int32_t frame_count;
+    double min_ms;
+    double avg_ms;
+    double p50_ms;
+    double p95_ms;
+    double p99_ms;
+    double max_ms;
+};
+
+void start_frame_stats(frame_stats_desc_t desc);
+// Logs a summary of the frames still in the ring.
+void stop_frame_stats(void);
+
+void frame_stats_begin_frame(void);
+void frame_stats_end_frame(void);
+// Time between begin and end is added to the stat for the current frame, so a stat can be timed in several pieces.
+void frame_stats_begin(frame_stat_t stat);
+void frame_stats_end(frame_stat_t stat);
+
+// Summarises the newest frame_count completed frames, fewer when the ring holds fewer. Uses the calling thread's scratch
+// arena. Returns false when there are no frames yet.
+bool frame_stats_summary(frame_stat_t stat, int32_t frame_count, frame_stats_summary_t *summary);
+// Completed frames since start_frame_stats.
+uint64_t frame_stats_frame_count(void);
+void frame_stats_log(int32_t frame_count);
+const char *frame_stat_name(frame_stat_t stat);
+
+#endif // FRAME_STATS_H
@@ -1,38 +1,184 @@
 #include "image.h"
 
+#include <SDL3/SDL.h>
+
 #include "memory.h"
 
-static void *stbi_malloc_wrapper(size_t size)
+// O--------------------------------------------------------------------------O
+// | Decode Allocations                                                       |
+// O--------------------------------------------------------------------------O
+
+// Every decode runs inside a scope on the decoding thread's scratch arena and stb_image's intermediate buffers, the
+// zlib output and its growing reallocs, the unfiltered scanlines and format conversions, are bumped from it, so they
+// never touch the shared system heap and are all released by the temp_end that closes the scope. The newest block can
+// grow and be freed in place, which is what zlib's doubling output buffer does. Blocks that do not fit what is left
+// of the arena, or every block when the thread has no scratch arena, fall back to the system heap.
+//
+// For load_image the one allocation of exactly the decoded image's size becomes the output instead: it is served from
+// the system heap, so the final pixels are the only thing the decode leaves behind. Should stb_image use that block for
+// something else, it is taken back when freed or reallocated and the real output is copied over afterwards, so whatever
+// the decoder does the result is correct. decode_image has no output block, its pixels are bumped from the arena like
+// everything else and copied to the destination before the scope closes.
+typedef struct image_decode_t image_decode_t;
+struct image_decode_t
+{
+    stack_allocator_t *arena;
+    uint8_t *last; // The newest arena block, NULL once it was freed.
+    size_t last_size;
+    size_t output_size; // 0 when the output stays in the arena.
+    void *output; // The system heap block handed out as the output, NULL until then.
+};
+
+static THREAD_LOCAL image_decode_t *t_image_decode;
+
+static void *image_heap_alloc(const size_t size)
 {
     heap_allocator_t *heap = mem_system_allocator();
-    return heap_alloc(heap, size, MEM_DEFAULT_ALIGN);
+    memory_tag_t tag = mem_set_tag(MEMORY_TAG_IMAGE);
+    void *mem = heap_alloc(heap, size, MEM_DEFAULT_ALIGN);
+    mem_set_tag(tag);
+    return mem;
 }
 
-static void *stbi_realloc_wrapper(void *ptr, size_t new_size)
+static bool image_decode_arena_owns(const image_decode_t *decode, const void *ptr)
 {
-    heap_allocator_t *heap = mem_system_allocator();
-    return heap_realloc(heap, ptr, new_size, MEM_DEFAULT_ALIGN);
+    if (decode->arena == NULL) {
+        return false;
+    }
+
+    const uint8_t *mem = decode->arena->mem;
+    return (const uint8_t *)ptr >= mem && (const uint8_t *)ptr < mem + decode->arena->total_size;
+}
+
+// Returns NULL instead of overflowing, the caller falls back to the heap.
+static void *image_decode_arena_alloc(image_decode_t *decode, const size_t size)
+{
+    stack_allocator_t *arena = decode->arena;
+    if (arena == NULL) {
+        return NULL;
+    }
+
+    const size_t offset = (arena->allocated_size + MEM_DEFAULT_ALIGN - 1) & ~(MEM_DEFAULT_ALIGN - 1);
+    if (offset > arena->total_size || size > arena->total_size - offset) {
+        return NULL;
+    }
+
+    uint8_t *mem = stack_alloc(arena, size, MEM_DEFAULT_ALIGN);
+    if (mem != NULL) {
+        decode->last = mem;
+        decode->last_size = size;
+    }
+    return mem;
+}
+
+static void image_decode_release_output(image_decode_t *decode)
+{
+    if (decode->output != NULL) {
+        heap_dealloc(mem_system_allocator(), decode->output);
+        decode->output = NULL;
+    }
+}
+
+static void *stbi_malloc_wrapper(size_t size)
+{
+    image_decode_t *decode = t_image_decode;
+    if (decode == NULL) {
+        return image_heap_alloc(size);
+    }
+
+    if (decode->output == NULL && decode->output_size > 0 && size == decode->output_size) {
+        decode->output = image_heap_alloc(size);
+        return decode->output;
+    }
+
+    void *mem = image_decode_arena_alloc(decode, size);
+    return mem != NULL ? mem : image_heap_alloc(size);
+}
+
+static void *stbi_realloc_wrapper(void *ptr, size_t old_size, size_t new_size)
+{
+    image_decode_t *decode = t_image_decode;
+    if (ptr == NULL) {
+        return stbi_malloc_wrapper(new_size);
+    }
+
+    const bool is_output = decode != NULL && decode->output != NULL && ptr == decode->output;
+    const bool in_arena = decode != NULL && !is_output && image_decode_arena_owns(decode, ptr);
+    if (!is_output && !in_arena) {
+        heap_allocator_t *heap = mem_system_allocator();
+        memory_tag_t tag = mem_set_tag(MEMORY_TAG_IMAGE);
+        void *mem = heap_realloc(heap, ptr, new_size, MEM_DEFAULT_ALIGN);
+        mem_set_tag(tag);
+        return mem;
+    }
+
+    // The newest arena block is popped and pushed again, which keeps its address and commits pages as it grows.
+    stack_allocator_t *arena = decode->arena;
+    if (in_arena && ptr == decode->last && (size_t)((uint8_t *)ptr - (uint8_t *)arena->mem) + new_size <= arena->total_size) {
+        stack_dealloc(arena, ptr);
+        void *mem = image_decode_arena_alloc(decode, new_size);
+        if (mem != NULL) {
+            return mem;
+        }
+        // The pages could not be committed, the bytes below the old size are still in place.
+        arena->allocated_size = (size_t)((uint8_t *)ptr - (uint8_t *)arena->mem) + old_size;
+    }
+
+    void *mem = stbi_malloc_wrapper(new_size);
+    if (mem == NULL) {
+        return NULL;
+    }
+    SDL_memcpy(mem, ptr, SDL_min(old_size, new_size));
+
+    if (is_output) {
+        image_decode_release_output(decode);
+    }
+    return mem;
 }
 
 static void stbi_free_wrapper(void *ptr)
 {
-    heap_allocator_t *heap = mem_system_allocator();
-    heap_dealloc(heap, ptr);
+    image_decode_t *decode = t_image_decode;
+    if (ptr == NULL) {
+        return;
+    }
+
+    if (decode != NULL) {
+        if (decode->output != NULL && ptr == decode->output) {
+            image_decode_release_output(decode);
+            return;
+        }
+        if (image_decode_arena_owns(decode, ptr)) {
+            if (ptr == decode->last) {
+                stack_dealloc(decode->arena, ptr);
+                decode->last = NULL;
+            }
+            return;
+        }
+    }
+
+    heap_dealloc(mem_system_allocator(), ptr);
 }
 
 #define STB_IMAGE_IMPLEMENTATION
 #define STBI_FAILURE_USERMSG
-#define STBI_MALLOC(sz)        stbi_malloc_wrapper(sz)
-#define STBI_REALLOC(p, newsz) stbi_realloc_wrapper(p, newsz)
-#define STBI_FREE(p)           stbi_free_wrapper(p)
-#include <SDL3/SDL.h>
+#define STBI_MALLOC(sz)                     stbi_malloc_wrapper(sz)
+#define STBI_REALLOC_SIZED(p, oldsz, newsz) stbi_realloc_wrapper(p, oldsz, newsz)
+#define STBI_FREE(p)                        stbi_free_wrapper(p)
 #include <stb_image.h>
 
 #include "log.h"
+#include "metrics.h"
+#include "profile.h"
 
-image_t load_image(const char *filename)
+// Every image is decoded to RGBA, whatever the channels of the source.
+#define IMAGE_DECODE_CHANNELS 4
+
+bool open_image(const char *filename, image_source_t *source)
 {
-    stack_allocator_t *scratch = mem_scratch_allocator();
+    *source = (image_source_t){};
+
+    temp_memory_t temp = temp_begin();
 
     // todo: get base path once and cache it at startup?
     const char *base_path = SDL_GetBasePath();
@@ -40,75 +186,154 @@ image_t load_image(const char *filename)
 
     // todo: better file path handling.
     int32_t len = SDL_snprintf(NULL, 0, "%s../data/%s", base_path, filename);
-    full_path = stack_alloc(scratch, len + 1, MEM_DEFAULT_ALIGN);
+    full_path = stack_alloc(temp.stack, len + 1, MEM_DEFAULT_ALIGN);
     if (full_path == NULL) {
         log_error(LOG_CATEGORY_IMAGE, "Failed to allocate %z bytes in scratch buffer.", len);
-        return (image_t){};
+        temp_end(temp);
+        return false;
     }
     SDL_snprintf(full_path, len + 1, "%s../data/%s", base_path, filename);
 
-    SDL_IOStream *io = SDL_IOFromFile(full_path, "rb");
-    if (io == NULL) {
+    if (!map_file(full_path, FILE_ACCESS_SEQUENTIAL, &source->file)) {
         log_error(LOG_CATEGORY_IMAGE, "Failed to open file %s, %s.", full_path, SDL_GetError());
-        stack_dealloc(scratch, full_path);
-        return (image_t){};
+        temp_end(temp);
+        return false;
     }
 
-    const int64_t required_size = SDL_GetIOSize(io);
-    if (required_size < 0) {
-        log_error(LOG_CATEGORY_IMAGE, "Failed to determine file size %s.", SDL_GetError());
-        SDL_CloseIO(io);
-        stack_dealloc(scratch, full_path);
-        return (image_t){};
+    if (source->file.size > INT32_MAX) {
+        log_error(LOG_CATEGORY_IMAGE, "Failed to load image %s, %llu bytes is more than stb_image reads.", full_path, (unsigned long long)source->file.size);
+        close_image(source);
+        temp_end(temp);
+        return false;
     }
 
-    void *buffer = stack_alloc(scratch, required_size, MEM_DEFAULT_ALIGN);
-    if (buffer == NULL) {
-        log_error(LOG_CATEGORY_IMAGE, "Failed to allocate %z bytes in scratch buffer.", required_size);
-        SDL_CloseIO(io);
-        stack_dealloc(scratch, full_path);
-        return (image_t){};
+    // Only the header is parsed, the pixels stay untouched in the mapping until decode_image.
+    int32_t width, height, comp;
+    if (!stbi_info_from_memory(source->file.data, (int32_t)source->file.size, &width, &height, &comp)) {
+        log_error(LOG_CATEGORY_IMAGE, "Failed to load image %s from data, %s", full_path, stbi_failure_reason());
+        close_image(source);
+        temp_end(temp);
+        return false;
     }
 
-    const size_t size = SDL_ReadIO(io, buffer, required_size);
-    if (size != required_size) {
-        if (size == 0) {
-            log_error(LOG_CATEGORY_IMAGE, "Failed to load image %s data, %s.", full_path, SDL_GetError());
-        } else {
-            log_warn(LOG_CATEGORY_IMAGE, "Load image %s data requested %lld bytes but only read %lld bytes.", full_path, required_size, size);
-        }
+    temp_end(temp);
 
-        stack_dealloc(scratch, buffer);
-        stack_dealloc(scratch, full_path);
-        SDL_CloseIO(io);
+    source->width = width;
+    source->height = height;
+    source->format = IMAGE_FORMAT_R8G8B8A8_UNORM;
+    return true;
+}
 
-        return (image_t){};
-    }
+// Decodes source to RGBA in a decode scope, see Decode Allocations. With a destination the decoded rows are copied to
+// it, pitch bytes apart, and dst is returned. Without one the pixels end up in a new system heap block. Returns NULL when
+// decoding failed.
+static uint8_t *decode_image_pixels(const image_source_t *source, void *dst, const int32_t pitch)
+{
+    const int32_t row_size = source->width * IMAGE_DECODE_CHANNELS;
 
-    SDL_CloseIO(io);
+    temp_memory_t temp = temp_begin();
+    image_decode_t decode = {
+        .arena = temp.stack,
+        .output_size = dst == NULL ? (size_t)row_size * source->height : 0,
+    };
+    t_image_decode = &decode;
 
-    const int32_t required_channels = 4;
     int32_t width, height, comp;
-    void *data = stbi_load_from_memory(buffer, (int32_t)size, &width, &height, &comp, required_channels);
+    uint8_t *data = stbi_load_from_memory(source->file.data, (int32_t)source->file.size, &width, &height, &comp, IMAGE_DECODE_CHANNELS);
+
+    uint8_t *pixels = NULL;
     if (data == NULL) {
-        log_error(LOG_CATEGORY_MEMORY, "Failed to load image %s from data, %s", full_path, stbi_failure_reason());
-        stack_dealloc(scratch, buffer);
-        stack_dealloc(scratch, full_path);
-        return (image_t){};
+        log_error(LOG_CATEGORY_IMAGE, "Failed to decode image, %s", stbi_failure_reason());
+    } else if (width != source->width || height != source->height) {
+        log_error(LOG_CATEGORY_IMAGE, "Failed to decode image, its size changed since it was opened.");
+    } else if (dst != NULL) {
+        // Rows go out in order and dst is only ever written, which suits write-combined upload memory.
+        for (int32_t y = 0; y < height; ++y) {
+            SDL_memcpy((uint8_t *)dst + (size_t)y * pitch, data + (size_t)y * row_size, row_size);
+        }
+        pixels = dst;
+    } else if (data == decode.output) {
+        pixels = data;
+    } else if (image_decode_arena_owns(&decode, data)) {
+        // The output is promoted out of the arena, which is about to be released.
+        pixels = image_heap_alloc(decode.output_size);
+        if (pixels != NULL) {
+            SDL_memcpy(pixels, data, decode.output_size);
+        }
+    } else {
+        pixels = data;
     }
 
-    stack_dealloc(scratch, buffer);
-    stack_dealloc(scratch, full_path);
+    // Whatever stb_image returned and is not kept is released with the rest of the decode.
+    if (data != NULL && data != pixels) {
+        stbi_free_wrapper(data);
+    }
+    if (pixels == NULL || pixels != decode.output) {
+        image_decode_release_output(&decode);
+    }
 
-    const int32_t pitch = width * required_channels;
+    t_image_decode = NULL;
+    temp_end(temp);
+    return pixels;
+}
+
+bool decode_image(const image_source_t *source, void *dst, const int32_t pitch)
+{
+    const int32_t row_size = source->width * IMAGE_DECODE_CHANNELS;
+    if (source->file.data == NULL || pitch < row_size) {
+        log_error(LOG_CATEGORY_IMAGE, "Failed to decode image, pitch %d is less than a %d byte row.", pitch, row_size);
+        return false;
+    }
+
+    PROFILE_BEGIN("decode_image");
+    const bool decoded = decode_image_pixels(source, dst, pitch) != NULL;
+    PROFILE_END();
+    return decoded;
+}
+
+void close_image(image_source_t *source)
+{
+    unmap_file(&source->file);
+    *source = (image_source_t){};
+}
 
-    return (image_t){
+static image_t load_image_file(const char *filename)
+{
+    image_source_t source;
+    if (!open_image(filename, &source)) {
+        return (image_t){};
+    }
+
+    // stb_image reads the mapped file directly, so the file is never copied into memory of our own.
+    void *data = decode_image_pixels(&source, NULL, 0);
+    if (data == NULL) {
+        log_error(LOG_CATEGORY_IMAGE, "Failed to load image %s.", filename);
+    }
+
+    const image_t image = {
         .data = data,
-        .width = width,
-        .height = height,
-        .pitch = pitch,
+        .width = data != NULL ? source.width : 0,
+        .height = data != NULL ? source.height : 0,
+        .pitch = data != NULL ? source.width * IMAGE_DECODE_CHANNELS : 0,
         .format = IMAGE_FORMAT_R8G8B8A8_UNORM,
     };
+
+    close_image(&source);
+    return image;
+}
+
+static metrics_counter_t g_image_loads_metric = METRICS_COUNTER("image_loads_total");
+static metrics_counter_t g_image_load_us_metric = METRICS_COUNTER("image_load_us_total");
+
+image_t load_image(const char *filename)
+{
+    PROFILE_BEGIN("load_image");
+    const uint64_t begin = SDL_GetTicksNS();
+    const image_t image = load_image_file(filename);
+    metrics_counter_add(&g_image_loads_metric, 1);
+    metrics_counter_add(&g_image_load_us_metric, (int64_t)((SDL_GetTicksNS() - begin) / SDL_NS_PER_US));
+    PROFILE_END();
+    return image;
 }
 
 void free_image(image_t *image)
@@ -127,10 +352,383 @@ int32_t image_bytes_per_pixel(const image_t *const image)
         return 0;
     }
 
-    switch (image->format) {
+    return image_format_bytes_per_pixel(image->format);
+}
+
+int32_t image_format_bytes_per_pixel(const image_format_t format)
+{
+    switch (format) {
     case IMAGE_FORMAT_R8G8B8A8_UNORM:
         return 4;
     default:
         return 0;
     }
 }
+
+// O--------------------------------------------------------------------------O
+// | Image Loader                                                             |
+// O--------------------------------------------------------------------------O
+
+#define IMAGE_REQUEST_INDEX_BITS 16
+#define IMAGE_REQUEST_INDEX_MASK ((1u << IMAGE_REQUEST_INDEX_BITS) - 1)
+
+typedef struct image_load_t image_load_t;
+struct image_load_t
+{
+    char filename[IMAGE_FILENAME_MAX];
+    image_loaded_t on_loaded;
+    void *user;
+    image_t image;
+    image_request_status_t status; // IMAGE_REQUEST_INVALID while the slot is free.
+    uint16_t generation;
+};
+
+// Request indices wait in queue until a worker takes them, those with a callback then wait in finished until
+// dispatch_image_requests or wait_image_request collects them. An entry only stays in either ring while its request
+// holds a slot, so neither ever holds more than IMAGE_LOADER_MAX_REQUESTS entries.
+typedef struct image_loader_t image_loader_t;
+struct image_loader_t
+{
+    SDL_Mutex *lock;
+    SDL_Condition *work;     // Signalled when a request is queued or the loader stops.
+    SDL_Condition *finished; // Broadcast whenever a request finishes.
+    SDL_Thread *workers[IMAGE_LOADER_MAX_WORKERS];
+    int32_t worker_count;
+    bool stopping;
+    image_load_t loads[IMAGE_LOADER_MAX_REQUESTS];
+    int32_t free_loads[IMAGE_LOADER_MAX_REQUESTS];
+    int32_t free_count;
+    int32_t queue[IMAGE_LOADER_MAX_REQUESTS];
+    int32_t queue_head;
+    int32_t queue_count;
+    image_request_t finished_requests[IMAGE_LOADER_MAX_REQUESTS];
+    int32_t finished_head;
+    int32_t finished_count;
+};
+
+static image_loader_t g_image_loader;
+
+static image_request_t make_image_request(const int32_t index, const uint16_t generation)
+{
+    return ((uint32_t)generation << IMAGE_REQUEST_INDEX_BITS) | (uint32_t)index;
+}
+
+// Expects the loader lock to be held. Returns NULL for a request that is not in use.
+static image_load_t *find_image_load(image_loader_t *loader, const image_request_t request)
+{
+    const uint32_t index = request & IMAGE_REQUEST_INDEX_MASK;
+    if (request == IMAGE_REQUEST_NULL || index >= IMAGE_LOADER_MAX_REQUESTS) {
+        return NULL;
+    }
+
+    image_load_t *load = &loader->loads[index];
+    if (load->status == IMAGE_REQUEST_INVALID || load->generation != request >> IMAGE_REQUEST_INDEX_BITS) {
+        return NULL;
+    }
+    return load;
+}
+
+// Expects the loader lock to be held.
+static void release_image_load(image_loader_t *loader, image_load_t *load)
+{
+    load->status = IMAGE_REQUEST_INVALID;
+    load->image = (image_t){};
+    // Generation 0 is skipped so that no request is ever IMAGE_REQUEST_NULL.
+    load->generation = load->generation == UINT16_MAX ? 1 : load->generation + 1;
+    loader->free_loads[loader->free_count++] = (int32_t)(load - loader->loads);
+}
+
+// Expects the loader lock to be held. Takes a request collected before dispatch out of the finished ring, keeping the
+// order of the others.
+static void remove_finished_request(image_loader_t *loader, const image_request_t request)
+{
+    int32_t kept = 0;
+    for (int32_t i = 0; i < loader->finished_count; ++i) {
+        const image_request_t finished = loader->finished_requests[(loader->finished_head + i) % IMAGE_LOADER_MAX_REQUESTS];
+        if (finished != request) {
+            loader->finished_requests[(loader->finished_head + kept) % IMAGE_LOADER_MAX_REQUESTS] = finished;
+            ++kept;
+        }
+    }
+    loader->finished_count = kept;
+}
+
+static int image_loader_thread(void *user)
+{
+    image_loader_t *loader = user;
+    profile_set_thread_name("image loader");
+
+    SDL_LockMutex(loader->lock);
+    for (;;) {
+        while (loader->queue_count == 0 && !loader->stopping) {
+            SDL_WaitCondition(loader->work, loader->lock);
+        }
+        if (loader->stopping) {
+            break;
+        }
+
+        const int32_t index = loader->queue[loader->queue_head];
+        loader->queue_head = (loader->queue_head + 1) % IMAGE_LOADER_MAX_REQUESTS;
+        --loader->queue_count;
+
+        // The slot stays in use until the request is collected, which cannot happen before it finishes.
+        image_load_t *load = &loader->loads[index];
+        SDL_UnlockMutex(loader->lock);
+
+        const image_t image = load_image(load->filename);
+
+        SDL_LockMutex(loader->lock);
+        load->image = image;
+        load->status = image.data != NULL ? IMAGE_REQUEST_LOADED : IMAGE_REQUEST_FAILED;
+        if (load->on_loaded != NULL) {
+            const int32_t tail = (loader->finished_head + loader->finished_count) % IMAGE_LOADER_MAX_REQUESTS;
+            loader->finished_requests[tail] = make_image_request(index, load->generation);
+            ++loader->finished_count;
+        }
+        SDL_BroadcastCondition(loader->finished);
+    }
+    SDL_UnlockMutex(loader->lock);
+
+    return 0;
+}
+
+bool start_image_loader(const image_loader_desc_t desc)
+{
+    image_loader_t *loader = &g_image_loader;
+    if (loader->lock != NULL) {
+        return true;
+    }
+
+    int32_t worker_count = desc.worker_count;
+    if (worker_count <= 0) {
+        worker_count = SDL_GetNumLogicalCPUCores() - 1;
+    }
+    worker_count = SDL_clamp(worker_count, 1, IMAGE_LOADER_MAX_WORKERS);
+
+    loader->lock = SDL_CreateMutex();
+    loader->work = SDL_CreateCondition();
+    loader->finished = SDL_CreateCondition();
+    if (loader->lock == NULL || loader->work == NULL || loader->finished == NULL) {
+        log_error(LOG_CATEGORY_IMAGE, "Failed to create image loader synchronization primitives, %s.", SDL_GetError());
+        SDL_DestroyCondition(loader->finished);
+        SDL_DestroyCondition(loader->work);
+        SDL_DestroyMutex(loader->lock);
+        *loader = (image_loader_t){};
+        return false;
+    }
+
+    // SDL caches the base path on first use without a lock, so it is cached here before the workers race for it.
+    SDL_GetBasePath();
+
+    loader->stopping = false;
+    loader->free_count = 0;
+    for (int32_t i = IMAGE_LOADER_MAX_REQUESTS - 1; i >= 0; --i) {
+        loader->free_loads[loader->free_count++] = i;
+    }
+    loader->queue_head = loader->queue_count = 0;
+    loader->finished_head = loader->finished_count = 0;
+
+    for (int32_t i = 0; i < worker_count; ++i) {
+        loader->workers[i] = SDL_CreateThread(image_loader_thread, "image loader", loader);
+        if (loader->workers[i] == NULL) {
+            log_error(LOG_CATEGORY_IMAGE, "Failed to create image loader thread, %s.", SDL_GetError());
+            stop_image_loader();
+            return false;
+        }
+        loader->worker_count = i + 1;
+    }
+
+    log_debug(LOG_CATEGORY_IMAGE, "Started image loader with %d workers.", worker_count);
+    return true;
+}
+
+void stop_image_loader(void)
+{
+    image_loader_t *loader = &g_image_loader;
+    if (loader->lock == NULL) {
+        return;
+    }
+
+    SDL_LockMutex(loader->lock);
+    loader->stopping = true;
+    SDL_BroadcastCondition(loader->work);
+    SDL_UnlockMutex(loader->lock);
+
+    for (int32_t i = 0; i < loader->worker_count; ++i) {
+        SDL_WaitThread(loader->workers[i], NULL);
+        loader->workers[i] = NULL;
+    }
+    loader->worker_count = 0;
+
+    for (int32_t i = 0; i < IMAGE_LOADER_MAX_REQUESTS; ++i) {
+        image_load_t *load = &loader->loads[i];
+        if (load->status != IMAGE_REQUEST_INVALID) {
+            free_image(&load->image);
+            release_image_load(loader, load);
+        }
+    }
+
+    SDL_DestroyCondition(loader->finished);
+    SDL_DestroyCondition(loader->work);
+    SDL_DestroyMutex(loader->lock);
+    loader->finished = NULL;
+    loader->work = NULL;
+    loader->lock = NULL;
+}
+
+image_request_t load_image_async(const char *filename, const image_loaded_t on_loaded, void *user)
+{
+    image_loader_t *loader = &g_image_loader;
+    if (loader->lock == NULL) {
+        log_error(LOG_CATEGORY_IMAGE, "Failed to queue image %s, the image loader is not running.", filename);
+        return IMAGE_REQUEST_NULL;
+    }
+
+    if (SDL_strlen(filename) >= IMAGE_FILENAME_MAX) {
+        log_error(LOG_CATEGORY_IMAGE, "Failed to queue image %s, the name is longer than %d characters.", filename, IMAGE_FILENAME_MAX - 1);
+        return IMAGE_REQUEST_NULL;
+    }
+
+    SDL_LockMutex(loader->lock);
+
+    if (loader->free_count == 0) {
+        SDL_UnlockMutex(loader->lock);
+        log_error(LOG_CATEGORY_IMAGE, "Failed to queue image %s, all %d requests are in use.", filename, IMAGE_LOADER_MAX_REQUESTS);
+        return IMAGE_REQUEST_NULL;
+    }
+
+    const int32_t index = loader->free_loads[--loader->free_count];
+    image_load_t *load = &loader->loads[index];
+    if (load->generation == 0) {
+        load->generation = 1;
+    }
+    SDL_strlcpy(load->filename, filename, sizeof(load->filename));
+    load->on_loaded = on_loaded;
+    load->user = user;
+    load->status = IMAGE_REQUEST_PENDING;
+
+    const int32_t tail = (loader->queue_head + loader->queue_count) % IMAGE_LOADER_MAX_REQUESTS;
+    loader->queue[tail] = index;
+    ++loader->queue_count;
+    SDL_SignalCondition(loader->work);
+
+    const image_request_t request = make_image_request(index, load->generation);
+    SDL_UnlockMutex(loader->lock);
+
+    return request;
+}
+
+image_request_status_t poll_image_request(const image_request_t request, image_t *image)
+{
+    image_loader_t *loader = &g_image_loader;
+    if (loader->lock == NULL) {
+        return IMAGE_REQUEST_INVALID;
+    }
+
+    SDL_LockMutex(loader->lock);
+
+    image_load_t *load = find_image_load(loader, request);
+    const image_request_status_t status = load != NULL ? load->status : IMAGE_REQUEST_INVALID;
+    if (status != IMAGE_REQUEST_INVALID && status != IMAGE_REQUEST_PENDING && load->on_loaded == NULL && image != NULL) {
+        *image = load->image;
+        release_image_load(loader, load);
+    }
+
+    SDL_UnlockMutex(loader->lock);
+    return status;
+}
+
+image_request_status_t wait_image_request(const image_request_t request, image_t *image)
+{
+    image_loader_t *loader = &g_image_loader;
+    if (loader->lock == NULL) {
+        return IMAGE_REQUEST_INVALID;
+    }
+
+    PROFILE_BEGIN("wait_image_request");
+    SDL_LockMutex(loader->lock);
+
+    image_load_t *load = find_image_load(loader, request);
+    while (load != NULL && load->status == IMAGE_REQUEST_PENDING) {
+        SDL_WaitCondition(loader->finished, loader->lock);
+        load = find_image_load(loader, request);
+    }
+
+    if (load == NULL) {
+        SDL_UnlockMutex(loader->lock);
+        PROFILE_END();
+        return IMAGE_REQUEST_INVALID;
+    }
+
+    // A request with a callback is in the finished ring, collecting it here takes it out so dispatch cannot run the
+    // callback a second time and the ring never holds more entries than there are slots.
+    const image_request_status_t status = load->status;
+    const image_loaded_t on_loaded = load->on_loaded;
+    void *user = load->user;
+    const image_t loaded = load->image;
+    if (on_loaded != NULL) {
+        remove_finished_request(loader, request);
+    }
+    if (on_loaded != NULL || image != NULL) {
+        release_image_load(loader, load);
+    }
+
+    SDL_UnlockMutex(loader->lock);
+    PROFILE_END();
+
+    if (on_loaded != NULL) {
+        on_loaded(request, status, loaded, user);
+    } else if (image != NULL) {
+        *image = loaded;
+    }
+    return status;
+}
+
+int32_t dispatch_image_requests(void)
+{
+    image_loader_t *loader = &g_image_loader;
+    if (loader->lock == NULL) {
+        return 0;
+    }
+
+    typedef struct finished_load_t finished_load_t;
+    struct finished_load_t
+    {
+        image_request_t request;
+        image_request_status_t status;
+        image_loaded_t on_loaded;
+        void *user;
+        image_t image;
+    };
+
+    // Callbacks run without the lock held, so they may queue more images.
+    finished_load_t finished[IMAGE_LOADER_MAX_REQUESTS];
+    int32_t count = 0;
+
+    SDL_LockMutex(loader->lock);
+    while (loader->finished_count > 0) {
+        const image_request_t request = loader->finished_requests[loader->finished_head];
+        loader->finished_head = (loader->finished_head + 1) % IMAGE_LOADER_MAX_REQUESTS;
+        --loader->finished_count;
+
+        image_load_t *load = find_image_load(loader, request);
+        if (load == NULL) {
+            continue;
+        }
+
+        finished[count++] = (finished_load_t){
+            .request = request,
+            .status = load->status,
+            .on_loaded = load->on_loaded,
+            .user = load->user,
+            .image = load->image,
+        };
+        release_image_load(loader, load);
+    }
+    SDL_UnlockMutex(loader->lock);
+
+    for (int32_t i = 0; i < count; ++i) {
+        finished[i].on_loaded(finished[i].request, finished[i].status, finished[i].image, finished[i].user);
+    }
+    return count;
+}
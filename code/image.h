@@ -1,8 +1,11 @@
 #ifndef IMAGE_H
 #define IMAGE_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
+#include "file.h"
+
 typedef enum image_format_t image_format_t;
 enum image_format_t
 {
@@ -25,4 +28,87 @@ void free_image(image_t *image);
 
 int32_t image_bytes_per_pixel(const image_t *image);
 
+// O--------------------------------------------------------------------------O
+// | Image Decoding                                                           |
+// O--------------------------------------------------------------------------O
+
+// Decodes an image into memory the caller provides, such as a mapped GPU transfer buffer, in two steps: open_image maps
+// the file and reads only the header, so the caller can size the destination, then decode_image writes the pixels.
+// stb_image reads back earlier rows while it unfilters, so it decodes into the thread's scratch arena and the finished
+// rows are copied to the destination in order. The destination is only written, never read, so write-combined or
+// uncached upload memory is fine.
+
+typedef struct image_source_t image_source_t;
+struct image_source_t
+{
+    file_view_t file;
+    int32_t width;
+    int32_t height;
+    image_format_t format;
+};
+
+bool open_image(const char *filename, image_source_t *source);
+// dst holds source->height rows, pitch bytes apart, and pitch is at least the width of a row. Can be called from any
+// thread, also for the same source at the same time.
+bool decode_image(const image_source_t *source, void *dst, int32_t pitch);
+void close_image(image_source_t *source);
+
+int32_t image_format_bytes_per_pixel(image_format_t format);
+
+// O--------------------------------------------------------------------------O
+// | Image Loader                                                             |
+// O--------------------------------------------------------------------------O
+
+// Loads images on a pool of worker threads so decoding many images overlaps with each other and with the rest of
+// startup. load_image_async queues a request and returns at once. A request is finished once its image is decoded or
+// the load failed, and is collected either by the caller through poll_image_request or wait_image_request, or, when it
+// was given a callback, by dispatch_image_requests, which the frame loop calls once per frame on the main thread, so
+// callbacks are free to create GPU resources.
+
+#define IMAGE_LOADER_MAX_WORKERS  8
+#define IMAGE_LOADER_MAX_REQUESTS 256 // Queued and finished but not yet collected.
+#define IMAGE_FILENAME_MAX        256
+
+// Index into the loader's request table plus a generation, so a request that was already collected is caught instead
+// of reading whatever request took its slot. 0 is never a valid request.
+typedef uint32_t image_request_t;
+
+#define IMAGE_REQUEST_NULL 0
+
+typedef enum image_request_status_t image_request_status_t;
+enum image_request_status_t
+{
+    IMAGE_REQUEST_INVALID, // Never made or already collected.
+    IMAGE_REQUEST_PENDING, // Queued or being loaded.
+    IMAGE_REQUEST_LOADED,
+    IMAGE_REQUEST_FAILED,
+};
+
+// Owns image from here on, the image is empty when the load failed.
+typedef void (*image_loaded_t)(image_request_t request, image_request_status_t status, image_t image, void *user);
+
+typedef struct image_loader_desc_t image_loader_desc_t;
+struct image_loader_desc_t
+{
+    int32_t worker_count; // 0 picks one worker per logical core besides the main thread, up to IMAGE_LOADER_MAX_WORKERS.
+};
+
+bool start_image_loader(image_loader_desc_t desc);
+// Drops queued requests, waits for the loads in progress and frees every image that was not collected.
+void stop_image_loader(void);
+
+// filename is copied. Returns IMAGE_REQUEST_NULL when the loader is not running or all requests are in use.
+image_request_t load_image_async(const char *filename, image_loaded_t on_loaded, void *user);
+
+// When a request without a callback has finished, its image is moved to image and the request is collected. Requests
+// with a callback only report their status and are left to dispatch_image_requests. image may be NULL to only poll.
+image_request_status_t poll_image_request(image_request_t request, image_t *image);
+// Blocks until the request has finished, then collects it like poll_image_request, except that a request with a
+// callback has its callback called right away on the calling thread.
+image_request_status_t wait_image_request(image_request_t request, image_t *image);
+
+// Calls the callbacks of the requests that finished since the last call, in the order they finished, and collects
+// them. Returns how many were called.
+int32_t dispatch_image_requests(void);
+
 #endif // IMAGE_H
@@ -1,48 +1,174 @@
 #include "log.h"
 
 #include <SDL3/SDL.h>
-#include <assert.h>
 #include <stdbool.h>
 
+#include "atomic.h"
+#include "log_binary.h"
+#include "log_file.h"
 #include "memory.h"
 
-typedef struct log_entry_t log_entry_t;
-struct log_entry_t
+// A message logged before the log system started, with its arguments captured. Records are packed back to back in the
+// stash, size covers the header, the arguments and padding up to the next record.
+typedef struct log_stash_record_t log_stash_record_t;
+struct log_stash_record_t
 {
+    SDL_AtomicInt ready; // Set once the record is complete.
+    uint16_t size;
+    uint16_t args_size;
     int32_t category;
     SDL_LogPriority priority;
-    char *message;
-    log_entry_t *next;
+    const char *fmt;
+    uint8_t args[];
 };
 
+// Fixed arena for messages logged before the log system starts, typically by the memory system before SDL is up.
+// Producers reserve space with a CAS on used, so stashing is a capture and a copy with no allocation; messages that do
+// not fit are counted and reported once the stash drains.
+typedef struct log_stash_t log_stash_t;
+struct log_stash_t
+{
+    _Alignas(CACHE_LINE_SIZE) uint8_t buffer[LOG_STASH_SIZE];
+    SDL_AtomicInt used;
+    SDL_AtomicInt dropped;
+};
+
+// One slot of the ring. A slot is free for the producer claiming position p when its sequence equals p, and holds a
+// message for the writer once the producer has set it to p + 1.
+typedef struct log_record_t log_record_t;
+struct log_record_t
+{
+    _Alignas(CACHE_LINE_SIZE) SDL_AtomicU32 sequence;
+    int32_t category;
+    SDL_LogPriority priority;
+    uint16_t args_size;
+    uint64_t timestamp_ns;
+    const char *fmt;
+    uint8_t args[LOG_MESSAGE_MAX_SIZE];
+};
+
+// Bounded multi-producer, single-consumer ring. Producers claim positions with a CAS on tail and capture the raw
+// arguments into their slot, so logging neither allocates nor formats. The writer thread formats the messages in order,
+// hands them to SDL and the binary log, and sleeps on wake when there is nothing to write.
+typedef struct log_ring_t log_ring_t;
+struct log_ring_t
+{
+    log_record_t *records;
+    uint32_t mask;
+    log_overflow_t overflow;
+    log_binary_writer_t *binary; // NULL when there is no binary log.
+    bool binary_only;
+    SDL_Thread *writer;
+    SDL_Semaphore *wake;
+    SDL_AtomicInt writer_sleeping;
+    SDL_AtomicInt stopping;
+    SDL_AtomicInt dropped;
+    _Alignas(CACHE_LINE_SIZE) SDL_AtomicU32 tail; // Next position producers claim.
+    _Alignas(CACHE_LINE_SIZE) SDL_AtomicU32 head; // Next position the writer reads.
+};
+
+#define LOG_WRITER_IDLE_TIMEOUT_MS 100
+
 static bool g_started;
-static log_entry_t *g_entries_head;
+static bool g_async;
+static log_ring_t g_ring;
+static log_binary_writer_t g_binary_writer;
+static SDL_AtomicInt g_dropped_count;
+static int32_t g_category_levels[LOG_CATEGORY_COUNT]; // 0 until set, which lets everything through like TRACE.
+static log_stash_t g_stash;
+static log_file_t g_log_file;
+static SDL_Mutex *g_log_file_lock; // Non-NULL while the file sink is installed.
+static SDL_LogOutputFunction g_previous_output;
+static void *g_previous_output_user;
 
+static void log_message(log_category_t category, SDL_LogPriority priority, const char *fmt, ...);
 static void log_message_v(log_category_t category, SDL_LogPriority priority, const char *fmt, va_list ap);
-static void stash_log_entry(int32_t category, SDL_LogPriority priority, const char *fmt, va_list ap);
-static void process_log_entry(void);
+static void push_log_record(log_ring_t *ring, int32_t category, SDL_LogPriority priority, const char *fmt, va_list ap);
+static void stash_log_record(log_stash_t *stash, int32_t category, SDL_LogPriority priority, const char *fmt, va_list ap);
+static void drain_log_stash(log_stash_t *stash);
+static bool start_log_writer(log_ring_t *ring, log_system_desc_t desc);
+static void stop_log_writer(log_ring_t *ring);
+static void start_log_file(log_system_desc_t desc);
+static void stop_log_file(void);
 
-void start_log_system(void)
+void start_log_system(log_system_desc_t desc)
 {
-    if (g_started) {
-        return;
+    for (int32_t i = 0; i < LOG_CATEGORY_COUNT; ++i) {
+        if (desc.levels[i] != 0) {
+            log_set_level((log_category_t)i, desc.levels[i]);
+        }
+    }
+
+    if (desc.file_path != NULL && g_log_file_lock == NULL) {
+        start_log_file(desc);
     }
 
-    SDL_SetLogPriority(LOG_CATEGORY_APPLICATION + SDL_LOG_CATEGORY_CUSTOM, SDL_LOG_PRIORITY_TRACE);
-    SDL_SetLogPriority(LOG_CATEGORY_GPU + SDL_LOG_CATEGORY_CUSTOM, SDL_LOG_PRIORITY_TRACE);
-    SDL_SetLogPriority(LOG_CATEGORY_IMAGE + SDL_LOG_CATEGORY_CUSTOM, SDL_LOG_PRIORITY_TRACE);
-    SDL_SetLogPriority(LOG_CATEGORY_MEMORY + SDL_LOG_CATEGORY_CUSTOM, SDL_LOG_PRIORITY_TRACE);
-    SDL_SetLogPriority(LOG_CATEGORY_WINDOW + SDL_LOG_CATEGORY_CUSTOM, SDL_LOG_PRIORITY_TRACE);
+    if (!g_started) {
+        drain_log_stash(&g_stash);
+        g_started = true;
+    }
 
-    if (g_entries_head != NULL) {
-        while (g_entries_head != NULL) {
-            process_log_entry();
+    if (desc.async && !g_async) {
+        if (!start_log_writer(&g_ring, desc)) {
+            log_warn(LOG_CATEGORY_APPLICATION, "Failed to start the log writer, logging synchronously.");
+            return;
         }
+        g_async = true;
     }
+}
+
+void stop_log_system(void)
+{
+    if (g_async) {
+        flush_log_system();
+        g_async = false;
+        stop_log_writer(&g_ring);
+    }
+
+    stop_log_file();
+}
+
+void flush_log_system(void)
+{
+    // An exit before start_log_system, like a failed SDL_Init, would otherwise lose whatever waits in the stash.
+    if (!g_started) {
+        drain_log_stash(&g_stash);
+        return;
+    }
+
+    if (!g_async) {
+        return;
+    }
+
+    const uint32_t target = SDL_GetAtomicU32(&g_ring.tail);
+    while ((int32_t)(SDL_GetAtomicU32(&g_ring.head) - target) < 0) {
+        SDL_SignalSemaphore(g_ring.wake);
+        SDL_Delay(1);
+    }
+}
+
+int32_t log_dropped_count(void)
+{
+    return SDL_GetAtomicInt(&g_dropped_count);
+}
+
+void log_set_level(const log_category_t category, const log_level_t level)
+{
+    atomic_exchange_i32(&g_category_levels[category], level);
+}
 
-    g_started = true;
+log_level_t log_get_level(const log_category_t category)
+{
+    const log_level_t level = atomic_load_i32(&g_category_levels[category]);
+    return level != 0 ? level : LOG_LEVEL_TRACE;
 }
 
+bool log_enabled(const log_category_t category, const log_level_t level)
+{
+    return level >= LOG_COMPILE_LEVEL && level >= atomic_load_i32(&g_category_levels[category]);
+}
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_DEBUG
 void log_debug(const log_category_t category, const char *fmt, ...)
 {
     va_list ap;
@@ -50,7 +176,9 @@ void log_debug(const log_category_t category, const char *fmt, ...)
     log_message_v(category, SDL_LOG_PRIORITY_DEBUG, fmt, ap);
     va_end(ap);
 }
+#endif
 
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_ERROR
 void log_error(const log_category_t category, const char *fmt, ...)
 {
     va_list ap;
@@ -58,7 +186,9 @@ void log_error(const log_category_t category, const char *fmt, ...)
     log_message_v(category, SDL_LOG_PRIORITY_ERROR, fmt, ap);
     va_end(ap);
 }
+#endif
 
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_INFO
 void log_info(const log_category_t category, const char *fmt, ...)
 {
     va_list ap;
@@ -66,7 +196,9 @@ void log_info(const log_category_t category, const char *fmt, ...)
     log_message_v(category, SDL_LOG_PRIORITY_INFO, fmt, ap);
     va_end(ap);
 }
+#endif
 
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_TRACE
 void log_trace(const log_category_t category, const char *fmt, ...)
 {
     va_list ap;
@@ -74,7 +206,9 @@ void log_trace(const log_category_t category, const char *fmt, ...)
     log_message_v(category, SDL_LOG_PRIORITY_TRACE, fmt, ap);
     va_end(ap);
 }
+#endif
 
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_WARN
 void log_warn(const log_category_t category, const char *fmt, ...)
 {
     va_list ap;
@@ -82,69 +216,365 @@ void log_warn(const log_category_t category, const char *fmt, ...)
     log_message_v(category, SDL_LOG_PRIORITY_WARN, fmt, ap);
     va_end(ap);
 }
+#endif
+
+void log_message_limited(log_rate_limit_t *limit, const log_level_t level, const log_category_t category, const char *fmt, ...)
+{
+    if ((int32_t)level < atomic_load_i32(&g_category_levels[category])) {
+        return;
+    }
+
+    // Only the thread that moves next_ns on writes, the others count themselves as suppressed.
+    const int64_t now = (int64_t)SDL_GetTicksNS();
+    const int64_t next = atomic_load_i64(&limit->next_ns);
+    if (now < next || !atomic_cas_i64(&limit->next_ns, next, now + (int64_t)LOG_RATE_LIMIT_INTERVAL_MS * SDL_NS_PER_MS)) {
+        atomic_add_i32(&limit->suppressed, 1);
+        return;
+    }
+
+    const int32_t suppressed = atomic_exchange_i32(&limit->suppressed, 0);
+    if (suppressed > 0) {
+        log_message(category, (SDL_LogPriority)level, "Suppressed %d repeats of \"%s\".", suppressed, fmt);
+    }
+
+    va_list ap;
+    va_start(ap, fmt);
+    log_message_v(category, (SDL_LogPriority)level, fmt, ap);
+    va_end(ap);
+}
+
+static void log_message(const log_category_t category, const SDL_LogPriority priority, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    log_message_v(category, priority, fmt, ap);
+    va_end(ap);
+}
 
 static void log_message_v(const log_category_t category, const SDL_LogPriority priority, const char *fmt, va_list ap)
 {
+    // The level check comes before anything else, a discarded message costs one relaxed load.
+    if ((int32_t)priority < atomic_load_i32(&g_category_levels[category])) {
+        return;
+    }
+
     const int32_t sdl_category = SDL_LOG_CATEGORY_CUSTOM + category;
-    if (g_started) {
+    if (g_async) {
+        push_log_record(&g_ring, sdl_category, priority, fmt, ap);
+    } else if (g_started) {
         SDL_LogMessageV(sdl_category, priority, fmt, ap);
     } else {
-        stash_log_entry(sdl_category, priority, fmt, ap);
+        stash_log_record(&g_stash, sdl_category, priority, fmt, ap);
     }
 }
 
-static void stash_log_entry(const int32_t category, const SDL_LogPriority priority, const char *fmt, va_list ap)
+static void stash_log_record(log_stash_t *stash, const int32_t category, const SDL_LogPriority priority, const char *fmt, va_list ap)
 {
-    heap_allocator_t *heap = mem_system_allocator();
-
-    log_entry_t *entry = heap_calloc(heap, 1, sizeof(log_entry_t), MEM_DEFAULT_ALIGN);
-    if (entry == NULL) {
+    // Once the stash is full, drop without capturing.
+    if (SDL_GetAtomicInt(&stash->used) + (int32_t)sizeof(log_stash_record_t) > LOG_STASH_SIZE) {
+        SDL_AddAtomicInt(&stash->dropped, 1);
         return;
     }
 
-    entry->category = category;
-    entry->priority = priority;
+    uint8_t args[LOG_MESSAGE_MAX_SIZE];
+    const uint16_t args_size = log_binary_capture(fmt, ap, args, sizeof(args));
+    const int32_t size = (int32_t)((sizeof(log_stash_record_t) + args_size + 7) & ~(size_t)7);
 
-    const int32_t len = SDL_vsnprintf(NULL, 0, fmt, ap);
-    size_t len_plus_term;
-    if (!SDL_size_add_check_overflow(len, 1, &len_plus_term)) {
-        heap_dealloc(heap, entry);
-        return;
+    int32_t offset;
+    do {
+        offset = SDL_GetAtomicInt(&stash->used);
+        if (offset + size > LOG_STASH_SIZE) {
+            SDL_AddAtomicInt(&stash->dropped, 1);
+            return;
+        }
+    } while (!SDL_CompareAndSwapAtomicInt(&stash->used, offset, offset + size));
+
+    log_stash_record_t *record = (log_stash_record_t *)(stash->buffer + offset);
+    record->size = (uint16_t)size;
+    record->args_size = args_size;
+    record->category = category;
+    record->priority = priority;
+    record->fmt = fmt;
+    SDL_memcpy(record->args, args, args_size);
+    SDL_SetAtomicInt(&record->ready, 1);
+}
+
+// Writes the stashed messages in the order they were logged. Producers must have stopped, a record still being written
+// ends the drain and what follows it is counted as dropped.
+static void drain_log_stash(log_stash_t *stash)
+{
+    // Messages are filtered against the category levels before they are captured, SDL lets through whatever arrives.
+    for (int32_t i = 0; i < LOG_CATEGORY_COUNT; ++i) {
+        SDL_SetLogPriority(SDL_LOG_CATEGORY_CUSTOM + i, SDL_LOG_PRIORITY_TRACE);
     }
-    entry->message = heap_alloc(heap, len_plus_term, MEM_DEFAULT_ALIGN);
-    if (entry->message == NULL) {
-        heap_dealloc(heap, entry);
-        return;
+
+    const int32_t used = SDL_GetAtomicInt(&stash->used);
+    int32_t dropped = SDL_GetAtomicInt(&stash->dropped);
+
+    int32_t offset = 0;
+    while (offset < used) {
+        log_stash_record_t *record = (log_stash_record_t *)(stash->buffer + offset);
+        if (!SDL_GetAtomicInt(&record->ready)) {
+            ++dropped;
+            break;
+        }
+
+        char message[LOG_MESSAGE_MAX_SIZE];
+        log_binary_format(record->fmt, record->args, record->args_size, message, sizeof(message));
+        SDL_LogMessage(record->category, record->priority, "%s", message);
+        offset += record->size;
     }
 
-    const int32_t written = SDL_vsnprintf(entry->message, len_plus_term, fmt, ap);
-    if (written < 0) {
-        heap_dealloc(heap, entry->message);
-        heap_dealloc(heap, entry);
-        return;
+    SDL_memset(stash->buffer, 0, used);
+    SDL_SetAtomicInt(&stash->used, 0);
+    SDL_SetAtomicInt(&stash->dropped, 0);
+
+    if (dropped > 0) {
+        SDL_AddAtomicInt(&g_dropped_count, dropped);
+        SDL_LogMessage(SDL_LOG_CATEGORY_CUSTOM + LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_WARN, "Dropped %d log messages logged before the log system started, the stash was full.", dropped);
+    }
+}
+
+static void wake_log_writer(log_ring_t *ring)
+{
+    if (SDL_CompareAndSwapAtomicInt(&ring->writer_sleeping, 1, 0)) {
+        SDL_SignalSemaphore(ring->wake);
     }
+}
 
-    assert(len == written);
+static void push_log_record(log_ring_t *ring, const int32_t category, const SDL_LogPriority priority, const char *fmt, va_list ap)
+{
+    const bool wait_for_room = ring->overflow == LOG_OVERFLOW_BLOCK || priority >= SDL_LOG_PRIORITY_ERROR;
 
-    if (g_entries_head == NULL) {
-        g_entries_head = entry;
-    } else {
-        log_entry_t *current = g_entries_head;
-        while (current->next != NULL) {
-            current = current->next;
+    log_record_t *record;
+    uint32_t position = SDL_GetAtomicU32(&ring->tail);
+    for (;;) {
+        record = &ring->records[position & ring->mask];
+        const int32_t lag = (int32_t)(SDL_GetAtomicU32(&record->sequence) - position);
+        if (lag == 0) {
+            if (SDL_CompareAndSwapAtomicU32(&ring->tail, position, position + 1)) {
+                break;
+            }
+        } else if (lag < 0) {
+            // The writer has not yet freed this slot from the previous lap, so the ring is full.
+            if (!wait_for_room) {
+                SDL_AddAtomicInt(&ring->dropped, 1);
+                SDL_AddAtomicInt(&g_dropped_count, 1);
+                return;
+            }
+            // Give the writer the core, it may be sharing one with the blocked producers.
+            wake_log_writer(ring);
+            SDL_Delay(0);
         }
-        current->next = entry;
+        position = SDL_GetAtomicU32(&ring->tail);
     }
+
+    record->category = category;
+    record->priority = priority;
+    record->timestamp_ns = SDL_GetTicksNS();
+    record->fmt = fmt;
+    record->args_size = log_binary_capture(fmt, ap, record->args, sizeof(record->args));
+    SDL_SetAtomicU32(&record->sequence, position + 1);
+
+    wake_log_writer(ring);
 }
 
-static void process_log_entry(void)
+static void drain_log_ring(log_ring_t *ring)
 {
-    log_entry_t *current = g_entries_head;
-    g_entries_head = current->next;
+    uint32_t position = SDL_GetAtomicU32(&ring->head);
+    for (;;) {
+        log_record_t *record = &ring->records[position & ring->mask];
+        if (SDL_GetAtomicU32(&record->sequence) != position + 1) {
+            break;
+        }
+
+        if (ring->binary != NULL) {
+            const log_binary_message_t message = {
+                .category = record->category,
+                .priority = record->priority,
+                .timestamp_ns = record->timestamp_ns,
+                .fmt = record->fmt,
+                .args = record->args,
+                .args_size = record->args_size,
+            };
+            log_binary_write(ring->binary, &message);
+        }
 
-    SDL_LogMessage(current->category, current->priority, current->message);
+        if (ring->binary == NULL || !ring->binary_only || record->priority >= SDL_LOG_PRIORITY_WARN) {
+            char text[LOG_MESSAGE_MAX_SIZE];
+            log_binary_format(record->fmt, record->args, record->args_size, text, sizeof(text));
+            SDL_LogMessage(record->category, record->priority, "%s", text);
+        }
+
+        SDL_SetAtomicU32(&record->sequence, position + ring->mask + 1);
+        SDL_SetAtomicU32(&ring->head, ++position);
+    }
+
+    const int32_t dropped = SDL_SetAtomicInt(&ring->dropped, 0);
+    if (dropped > 0) {
+        SDL_LogMessage(SDL_LOG_CATEGORY_CUSTOM + LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_WARN, "Dropped %d log messages, the log ring was full.", dropped);
+    }
+}
+
+static int log_writer_thread(void *user)
+{
+    log_ring_t *ring = (log_ring_t *)user;
+
+    for (;;) {
+        drain_log_ring(ring);
+
+        if (SDL_GetAtomicInt(&ring->stopping)) {
+            if (SDL_GetAtomicU32(&ring->head) == SDL_GetAtomicU32(&ring->tail)) {
+                break;
+            }
+            continue;
+        }
+
+        if (ring->binary != NULL) {
+            log_binary_writer_flush(ring->binary);
+        }
+
+        // Producers only signal while the writer is marked as sleeping, so check once more after marking it.
+        SDL_SetAtomicInt(&ring->writer_sleeping, 1);
+        const uint32_t head = SDL_GetAtomicU32(&ring->head);
+        if (SDL_GetAtomicU32(&ring->records[head & ring->mask].sequence) != head + 1) {
+            SDL_WaitSemaphoreTimeout(ring->wake, LOG_WRITER_IDLE_TIMEOUT_MS);
+        }
+        SDL_SetAtomicInt(&ring->writer_sleeping, 0);
+    }
+
+    return 0;
+}
+
+static bool start_log_writer(log_ring_t *ring, log_system_desc_t desc)
+{
+    uint32_t capacity = 1;
+    while (capacity < (uint32_t)(desc.ring_capacity > 0 ? desc.ring_capacity : LOG_DEFAULT_RING_CAPACITY)) {
+        capacity <<= 1;
+    }
 
     heap_allocator_t *heap = mem_system_allocator();
-    heap_dealloc(heap, current->message);
-    heap_dealloc(heap, current);
+    memory_tag_t tag = mem_set_tag(MEMORY_TAG_LOG);
+    ring->records = heap_alloc(heap, capacity * sizeof(log_record_t), CACHE_LINE_SIZE);
+    mem_set_tag(tag);
+    if (ring->records == NULL) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < capacity; ++i) {
+        SDL_SetAtomicU32(&ring->records[i].sequence, i);
+    }
+
+    ring->mask = capacity - 1;
+    ring->overflow = desc.overflow;
+    ring->binary = NULL;
+    ring->binary_only = desc.binary_only;
+    if (desc.binary_path != NULL) {
+        if (log_binary_writer_open(&g_binary_writer, desc.binary_path)) {
+            ring->binary = &g_binary_writer;
+        } else {
+            log_warn(LOG_CATEGORY_APPLICATION, "Failed to open binary log %s, %s.", desc.binary_path, SDL_GetError());
+        }
+    }
+    SDL_SetAtomicU32(&ring->tail, 0);
+    SDL_SetAtomicU32(&ring->head, 0);
+    SDL_SetAtomicInt(&ring->writer_sleeping, 0);
+    SDL_SetAtomicInt(&ring->stopping, 0);
+    SDL_SetAtomicInt(&ring->dropped, 0);
+
+    ring->wake = SDL_CreateSemaphore(0);
+    if (ring->wake == NULL) {
+        log_binary_writer_close(&g_binary_writer);
+        heap_dealloc(heap, ring->records);
+        return false;
+    }
+
+    ring->writer = SDL_CreateThread(log_writer_thread, "log writer", ring);
+    if (ring->writer == NULL) {
+        SDL_DestroySemaphore(ring->wake);
+        log_binary_writer_close(&g_binary_writer);
+        heap_dealloc(heap, ring->records);
+        return false;
+    }
+
+    return true;
+}
+
+static void stop_log_writer(log_ring_t *ring)
+{
+    SDL_SetAtomicInt(&ring->stopping, 1);
+    SDL_SignalSemaphore(ring->wake);
+    SDL_WaitThread(ring->writer, NULL);
+
+    SDL_DestroySemaphore(ring->wake);
+    log_binary_writer_close(&g_binary_writer);
+    heap_dealloc(mem_system_allocator(), ring->records);
+    ring->binary = NULL;
+    ring->writer = NULL;
+    ring->wake = NULL;
+    ring->records = NULL;
+}
+
+// Chained in front of SDL's output function, so the file gets exactly the text SDL writes, from whichever thread writes
+// it.
+static void log_file_output(void *user, const int category, const SDL_LogPriority priority, const char *message)
+{
+    (void)user;
+
+    char prefix[64];
+    const double seconds = (double)SDL_GetTicksNS() / SDL_NS_PER_SECOND;
+    const int32_t prefix_length = SDL_snprintf(prefix, sizeof(prefix), "%12.6f %-8s %-11s ", seconds, log_binary_priority_name(priority), log_binary_category_name(category));
+
+    SDL_LockMutex(g_log_file_lock);
+    size_t message_length = SDL_strlen(message);
+    if (prefix_length + message_length + 1 > g_log_file.size) {
+        message_length = g_log_file.size - prefix_length - 1;
+    }
+    char *at = log_file_reserve(&g_log_file, prefix_length + message_length + 1);
+    if (at != NULL) {
+        SDL_memcpy(at, prefix, prefix_length);
+        SDL_memcpy(at + prefix_length, message, message_length);
+        at[prefix_length + message_length] = '\n';
+    }
+    SDL_UnlockMutex(g_log_file_lock);
+
+    if (g_previous_output != NULL) {
+        g_previous_output(g_previous_output_user, category, priority, message);
+    }
+}
+
+static void start_log_file(log_system_desc_t desc)
+{
+    const int32_t keep_count = desc.file_keep_count != 0 ? desc.file_keep_count : LOG_FILE_DEFAULT_KEEP_COUNT;
+    if (!log_file_open(&g_log_file, desc.file_path, desc.file_size, keep_count)) {
+        log_warn(LOG_CATEGORY_APPLICATION, "Failed to open log file %s, %s.", desc.file_path, SDL_GetError());
+        return;
+    }
+
+    g_log_file_lock = SDL_CreateMutex();
+    if (g_log_file_lock == NULL) {
+        log_file_close(&g_log_file);
+        return;
+    }
+
+    SDL_GetLogOutputFunction(&g_previous_output, &g_previous_output_user);
+    SDL_SetLogOutputFunction(log_file_output, NULL);
+}
+
+static void stop_log_file(void)
+{
+    if (g_log_file_lock == NULL) {
+        return;
+    }
+
+    SDL_LogOutputFunction output;
+    void *user;
+    SDL_GetLogOutputFunction(&output, &user);
+    if (output == log_file_output) {
+        SDL_SetLogOutputFunction(g_previous_output, g_previous_output_user);
+    }
+
+    SDL_DestroyMutex(g_log_file_lock);
+    g_log_file_lock = NULL;
+    log_file_close(&g_log_file);
 }
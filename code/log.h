@@ -1,6 +1,36 @@
 #ifndef LOG_H
 #define LOG_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOG_DEFAULT_RING_CAPACITY  1024
+#define LOG_MESSAGE_MAX_SIZE       512 // Bytes of captured arguments, and of text, kept for messages that are not written immediately.
+#define LOG_RATE_LIMIT_INTERVAL_MS 1000
+#define LOG_STASH_SIZE             (64 * 1024) // Bytes kept for messages logged before the log system starts.
+
+// Levels match SDL_LogPriority. They are macros rather than an enum so LOG_COMPILE_LEVEL can be tested by the
+// preprocessor.
+typedef int32_t log_level_t;
+#define LOG_LEVEL_TRACE    1
+#define LOG_LEVEL_VERBOSE  2
+#define LOG_LEVEL_DEBUG    3
+#define LOG_LEVEL_INFO     4
+#define LOG_LEVEL_WARN     5
+#define LOG_LEVEL_ERROR    6
+#define LOG_LEVEL_CRITICAL 7
+
+// Calls below this level compile to nothing: their arguments are type checked but never evaluated. Release builds keep
+// info and above, override with -DLOG_COMPILE_LEVEL=<level>.
+#ifndef LOG_COMPILE_LEVEL
+#if defined(NDEBUG)
+#define LOG_COMPILE_LEVEL LOG_LEVEL_INFO
+#else
+#define LOG_COMPILE_LEVEL LOG_LEVEL_TRACE
+#endif
+#endif
+
 typedef enum log_category_t log_category_t;
 enum log_category_t
 {
@@ -9,18 +39,103 @@ enum log_category_t
     LOG_CATEGORY_IMAGE,
     LOG_CATEGORY_MEMORY,
     LOG_CATEGORY_WINDOW,
+    LOG_CATEGORY_FRAME,
+    LOG_CATEGORY_COUNT,
+};
+
+typedef enum log_overflow_t log_overflow_t;
+enum log_overflow_t
+{
+    LOG_OVERFLOW_DROP,  // Drop the message and count it, the writer reports how many were lost.
+    LOG_OVERFLOW_BLOCK, // Wait for the writer to make room.
+};
+
+typedef struct log_system_desc_t log_system_desc_t;
+struct log_system_desc_t
+{
+    bool async;              // Capture the arguments into a ring and leave formatting and output to a writer thread.
+    int32_t ring_capacity;   // Messages, rounded up to a power of two. 0 means LOG_DEFAULT_RING_CAPACITY.
+    log_overflow_t overflow; // Errors always wait for room, whatever the policy.
+    const char *binary_path; // Async only. Also write every message to this file in the binary log format.
+    bool binary_only;        // Leave formatting to the decoder, only warnings and errors are still written as text.
+    log_level_t levels[LOG_CATEGORY_COUNT]; // Minimum level written per category. 0 leaves the category as it is.
+    const char *file_path;   // Also append the text output to this memory mapped file, see log_file.h.
+    size_t file_size;        // Bytes per file before it rotates. 0 means LOG_FILE_DEFAULT_SIZE.
+    int32_t file_keep_count; // Rotated files kept. 0 means LOG_FILE_DEFAULT_KEEP_COUNT, negative keeps none.
 };
 
-void start_log_system(void);
+// Repeats from one call site within an interval are counted instead of written, see log_limited.
+typedef struct log_rate_limit_t log_rate_limit_t;
+struct log_rate_limit_t
+{
+    int64_t next_ns;    // When the call site may write again.
+    int32_t suppressed; // Messages counted since the last one written.
+};
+
+// Format strings must outlive the message, messages may be formatted after the call returns. String literals do.
+//
+// Messages logged before the log system starts are kept and written when it does. It can be started again to switch
+// to async after stop_log_system, which returns to writing messages on the calling thread. Other threads must stop
+// logging before it is stopped.
+void start_log_system(log_system_desc_t desc);
+void stop_log_system(void);
+
+// Waits until every message logged so far has been written. Before start_log_system it prints what was stashed.
+void flush_log_system(void);
 
+int32_t log_dropped_count(void);
+
+// Messages below a category's level are discarded before their arguments are touched. Every category starts at
+// LOG_LEVEL_TRACE.
+void log_set_level(log_category_t category, log_level_t level);
+log_level_t log_get_level(log_category_t category);
+// For call sites that do work to build their arguments.
+bool log_enabled(log_category_t category, log_level_t level);
+
+// Never defined, it only gives compiled out calls something to type check against.
+int log_discard(log_category_t category, const char *fmt, ...);
+#define LOG_DISCARD(...) ((void)sizeof(log_discard(__VA_ARGS__)))
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_DEBUG
 void log_debug(log_category_t category, const char *fmt, ...);
+#else
+#define log_debug(...) LOG_DISCARD(__VA_ARGS__)
+#endif
 
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_ERROR
 void log_error(log_category_t category, const char *fmt, ...);
+#else
+#define log_error(...) LOG_DISCARD(__VA_ARGS__)
+#endif
 
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_INFO
 void log_info(log_category_t category, const char *fmt, ...);
+#else
+#define log_info(...) LOG_DISCARD(__VA_ARGS__)
+#endif
 
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_TRACE
 void log_trace(log_category_t category, const char *fmt, ...);
+#else
+#define log_trace(...) LOG_DISCARD(__VA_ARGS__)
+#endif
 
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_WARN
 void log_warn(log_category_t category, const char *fmt, ...);
+#else
+#define log_warn(...) LOG_DISCARD(__VA_ARGS__)
+#endif
+
+// Writes at most one message per LOG_RATE_LIMIT_INTERVAL_MS from the call site. The repeats in between are counted and
+// summarised in a message written just before the next one that gets through, so a message logged every frame shows up
+// once a second along with how many times it was suppressed.
+void log_message_limited(log_rate_limit_t *limit, log_level_t level, log_category_t category, const char *fmt, ...);
+#define log_limited(level, category, ...)                                   \
+    do {                                                                    \
+        if ((level) >= LOG_COMPILE_LEVEL) {                                 \
+            static log_rate_limit_t log_limit_;                             \
+            log_message_limited(&log_limit_, level, category, __VA_ARGS__); \
+        }                                                                   \
+    } while (0)
 
 #endif // LOG_H
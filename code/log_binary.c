@@ -0,0 +1,847 @@
+#include "log_binary.h"
+
+#include "log.h"
+
+#define LOG_BINARY_HEADER_SIZE          16
+#define LOG_BINARY_FORMAT_RECORD_SIZE   7  // type, id, length.
+#define LOG_BINARY_MESSAGE_RECORD_SIZE  23 // type, category, priority, timestamp, format id, args size.
+#define LOG_BINARY_MAX_INTERNED_FORMATS (LOG_BINARY_MAX_FORMATS / 2)
+#define LOG_SPEC_MAX_FLAGS              8
+#define LOG_SPEC_MAX_DIGITS             20
+#define LOG_SPEC_PIECE_SIZE             64 // '%', flags, width, '.', precision, length, conversion and terminator.
+
+// O--------------------------------------------------------------------------O
+// | Conversions                                                              |
+// O--------------------------------------------------------------------------O
+
+typedef enum log_arg_kind_t log_arg_kind_t;
+enum log_arg_kind_t
+{
+    LOG_ARG_NONE, // Not a conversion we know, written out as it is.
+    LOG_ARG_INT,
+    LOG_ARG_UINT,
+    LOG_ARG_CHAR,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_STRING,
+    LOG_ARG_POINTER,
+    LOG_ARG_COUNT, // %n, the argument is consumed but nothing is stored or printed.
+};
+
+typedef enum log_arg_length_t log_arg_length_t;
+enum log_arg_length_t
+{
+    LOG_ARG_LENGTH_DEFAULT,
+    LOG_ARG_LENGTH_HH,
+    LOG_ARG_LENGTH_H,
+    LOG_ARG_LENGTH_L,
+    LOG_ARG_LENGTH_LL,
+    LOG_ARG_LENGTH_Z,
+    LOG_ARG_LENGTH_J,
+    LOG_ARG_LENGTH_T,
+    LOG_ARG_LENGTH_LONG_DOUBLE,
+};
+
+// One printf conversion, without the leading '%'.
+typedef struct log_spec_t log_spec_t;
+struct log_spec_t
+{
+    const char *flags;
+    int32_t flags_length;
+    const char *width;
+    int32_t width_length;
+    bool width_star;
+    bool has_precision;
+    const char *precision;
+    int32_t precision_length;
+    bool precision_star;
+    log_arg_length_t length;
+    log_arg_kind_t kind;
+    char conversion;
+};
+
+static bool is_digit(const char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static const char *parse_spec(const char *p, log_spec_t *spec)
+{
+    *spec = (log_spec_t){ 0 };
+
+    spec->flags = p;
+    while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0') {
+        ++p;
+    }
+    spec->flags_length = (int32_t)(p - spec->flags);
+
+    spec->width = p;
+    if (*p == '*') {
+        spec->width_star = true;
+        ++p;
+    } else {
+        while (is_digit(*p)) {
+            ++p;
+        }
+    }
+    spec->width_length = (int32_t)(p - spec->width);
+
+    if (*p == '.') {
+        spec->has_precision = true;
+        spec->precision = ++p;
+        if (*p == '*') {
+            spec->precision_star = true;
+            ++p;
+        } else {
+            while (is_digit(*p)) {
+                ++p;
+            }
+        }
+        spec->precision_length = (int32_t)(p - spec->precision);
+    }
+
+    switch (*p) {
+    case 'h':
+        spec->length = p[1] == 'h' ? LOG_ARG_LENGTH_HH : LOG_ARG_LENGTH_H;
+        p += p[1] == 'h' ? 2 : 1;
+        break;
+    case 'l':
+        spec->length = p[1] == 'l' ? LOG_ARG_LENGTH_LL : LOG_ARG_LENGTH_L;
+        p += p[1] == 'l' ? 2 : 1;
+        break;
+    case 'z':
+        spec->length = LOG_ARG_LENGTH_Z;
+        ++p;
+        break;
+    case 'j':
+        spec->length = LOG_ARG_LENGTH_J;
+        ++p;
+        break;
+    case 't':
+        spec->length = LOG_ARG_LENGTH_T;
+        ++p;
+        break;
+    case 'L':
+        spec->length = LOG_ARG_LENGTH_LONG_DOUBLE;
+        ++p;
+        break;
+    default:
+        break;
+    }
+
+    spec->conversion = *p;
+    switch (*p) {
+    case 'd':
+    case 'i':
+        spec->kind = LOG_ARG_INT;
+        break;
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+        spec->kind = LOG_ARG_UINT;
+        break;
+    case 'c':
+        spec->kind = LOG_ARG_CHAR;
+        break;
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'F':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        spec->kind = LOG_ARG_DOUBLE;
+        break;
+    case 's':
+        spec->kind = LOG_ARG_STRING;
+        break;
+    case 'p':
+        spec->kind = LOG_ARG_POINTER;
+        break;
+    case 'n':
+        spec->kind = LOG_ARG_COUNT;
+        break;
+    default:
+        spec->kind = LOG_ARG_NONE;
+        break;
+    }
+
+    if (*p != '\0') {
+        ++p;
+    }
+    return p;
+}
+
+// O--------------------------------------------------------------------------O
+// | Capture                                                                  |
+// O--------------------------------------------------------------------------O
+
+typedef struct log_arg_writer_t log_arg_writer_t;
+struct log_arg_writer_t
+{
+    uint8_t *args;
+    uint16_t capacity;
+    uint16_t size;
+    bool full;
+};
+
+static void put_arg(log_arg_writer_t *writer, const void *value, const uint16_t size)
+{
+    if (writer->full || writer->capacity - writer->size < size) {
+        writer->full = true;
+        return;
+    }
+    SDL_memcpy(writer->args + writer->size, value, size);
+    writer->size += size;
+}
+
+static void put_int(log_arg_writer_t *writer, const int64_t value)
+{
+    put_arg(writer, &value, sizeof(value));
+}
+
+static void put_uint(log_arg_writer_t *writer, const uint64_t value)
+{
+    put_arg(writer, &value, sizeof(value));
+}
+
+static void put_string(log_arg_writer_t *writer, const char *value, const int64_t precision)
+{
+    if (writer->full || writer->capacity - writer->size < (int32_t)sizeof(uint16_t)) {
+        writer->full = true;
+        return;
+    }
+
+    if (value == NULL) {
+        value = "(null)";
+    }
+
+    size_t limit = writer->capacity - writer->size - sizeof(uint16_t);
+    if (precision >= 0 && (uint64_t)precision < limit) {
+        limit = (size_t)precision;
+    }
+
+    const uint16_t length = (uint16_t)SDL_strnlen(value, limit);
+    put_arg(writer, &length, sizeof(length));
+    put_arg(writer, value, length);
+}
+
+static int64_t capture_int(const log_arg_length_t length, va_list *ap)
+{
+    switch (length) {
+    case LOG_ARG_LENGTH_HH:
+        return (signed char)va_arg(*ap, int);
+    case LOG_ARG_LENGTH_H:
+        return (short)va_arg(*ap, int);
+    case LOG_ARG_LENGTH_L:
+        return va_arg(*ap, long);
+    case LOG_ARG_LENGTH_LL:
+        return va_arg(*ap, long long);
+    case LOG_ARG_LENGTH_Z:
+        return (int64_t)va_arg(*ap, size_t);
+    case LOG_ARG_LENGTH_J:
+        return va_arg(*ap, intmax_t);
+    case LOG_ARG_LENGTH_T:
+        return va_arg(*ap, ptrdiff_t);
+    default:
+        return va_arg(*ap, int);
+    }
+}
+
+static uint64_t capture_uint(const log_arg_length_t length, va_list *ap)
+{
+    switch (length) {
+    case LOG_ARG_LENGTH_HH:
+        return (unsigned char)va_arg(*ap, unsigned int);
+    case LOG_ARG_LENGTH_H:
+        return (unsigned short)va_arg(*ap, unsigned int);
+    case LOG_ARG_LENGTH_L:
+        return va_arg(*ap, unsigned long);
+    case LOG_ARG_LENGTH_LL:
+        return va_arg(*ap, unsigned long long);
+    case LOG_ARG_LENGTH_Z:
+        return va_arg(*ap, size_t);
+    case LOG_ARG_LENGTH_J:
+        return va_arg(*ap, uintmax_t);
+    case LOG_ARG_LENGTH_T:
+        return (uint64_t)va_arg(*ap, ptrdiff_t);
+    default:
+        return va_arg(*ap, unsigned int);
+    }
+}
+
+uint16_t log_binary_capture(const char *fmt, va_list ap, uint8_t *args, const uint16_t capacity)
+{
+    log_arg_writer_t writer = { .args = args, .capacity = capacity };
+
+    // Walked through a copy so the va_list can be passed on by pointer, which is portable where va_list is an array.
+    va_list args_ap;
+    va_copy(args_ap, ap);
+
+    const char *p = fmt;
+    while (*p != '\0' && !writer.full) {
+        if (*p++ != '%') {
+            continue;
+        }
+        if (*p == '%') {
+            ++p;
+            continue;
+        }
+
+        log_spec_t spec;
+        p = parse_spec(p, &spec);
+
+        if (spec.width_star) {
+            put_int(&writer, va_arg(args_ap, int));
+        }
+        int64_t precision = -1;
+        if (spec.precision_star) {
+            precision = va_arg(args_ap, int);
+            put_int(&writer, precision);
+        } else if (spec.has_precision) {
+            precision = SDL_strtol(spec.precision, NULL, 10);
+        }
+
+        switch (spec.kind) {
+        case LOG_ARG_INT:
+            put_int(&writer, capture_int(spec.length, &args_ap));
+            break;
+        case LOG_ARG_UINT:
+            put_uint(&writer, capture_uint(spec.length, &args_ap));
+            break;
+        case LOG_ARG_CHAR:
+            put_int(&writer, va_arg(args_ap, int));
+            break;
+        case LOG_ARG_DOUBLE: {
+            const double value = spec.length == LOG_ARG_LENGTH_LONG_DOUBLE ? (double)va_arg(args_ap, long double) : va_arg(args_ap, double);
+            put_arg(&writer, &value, sizeof(value));
+            break;
+        }
+        case LOG_ARG_STRING:
+            put_string(&writer, va_arg(args_ap, const char *), precision);
+            break;
+        case LOG_ARG_POINTER:
+            put_uint(&writer, (uintptr_t)va_arg(args_ap, void *));
+            break;
+        case LOG_ARG_COUNT:
+            (void)va_arg(args_ap, void *);
+            break;
+        case LOG_ARG_NONE:
+            break;
+        }
+    }
+
+    va_end(args_ap);
+    return writer.size;
+}
+
+// O--------------------------------------------------------------------------O
+// | Format                                                                   |
+// O--------------------------------------------------------------------------O
+
+typedef struct log_arg_reader_t log_arg_reader_t;
+struct log_arg_reader_t
+{
+    const uint8_t *args;
+    uint16_t size;
+    uint16_t offset;
+};
+
+static bool get_arg(log_arg_reader_t *reader, void *value, const uint16_t size)
+{
+    if (reader->size - reader->offset < size) {
+        reader->offset = reader->size;
+        return false;
+    }
+    SDL_memcpy(value, reader->args + reader->offset, size);
+    reader->offset += size;
+    return true;
+}
+
+typedef struct log_text_t log_text_t;
+struct log_text_t
+{
+    char *out;
+    int32_t capacity;
+    int32_t length;
+};
+
+static void append_text(log_text_t *text, const char *s, const int32_t length)
+{
+    const int32_t room = text->capacity - 1 - text->length;
+    const int32_t count = length < room ? length : room;
+    if (count > 0) {
+        SDL_memcpy(text->out + text->length, s, count);
+        text->length += count;
+        text->out[text->length] = '\0';
+    }
+}
+
+static void append_formatted(log_text_t *text, const int32_t written)
+{
+    const int32_t room = text->capacity - 1 - text->length;
+    if (written > 0) {
+        text->length += written < room ? written : room;
+    }
+}
+
+static char *put_digits(char *at, uint64_t value)
+{
+    char digits[20];
+    int32_t count = 0;
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    while (count > 0) {
+        *at++ = digits[--count];
+    }
+    return at;
+}
+
+// Rebuilds the conversion as a printf spec for a single argument, with star widths and precisions filled in. Built by
+// hand, going through snprintf for the spec as well would double the cost of every conversion.
+static void build_piece(char *piece, const log_spec_t *spec, const int64_t width, const int64_t precision, const char *length, const char conversion)
+{
+    char *at = piece;
+    *at++ = '%';
+
+    const int32_t flags_length = spec->flags_length < LOG_SPEC_MAX_FLAGS ? spec->flags_length : LOG_SPEC_MAX_FLAGS;
+    SDL_memcpy(at, spec->flags, flags_length);
+    at += flags_length;
+
+    if (spec->width_star) {
+        if (width < 0) {
+            *at++ = '-';
+        }
+        at = put_digits(at, width < 0 ? (uint64_t)-width : (uint64_t)width);
+    } else {
+        const int32_t width_length = spec->width_length < LOG_SPEC_MAX_DIGITS ? spec->width_length : LOG_SPEC_MAX_DIGITS;
+        SDL_memcpy(at, spec->width, width_length);
+        at += width_length;
+    }
+
+    if (precision >= 0) {
+        *at++ = '.';
+        at = put_digits(at, (uint64_t)precision);
+    }
+
+    while (*length != '\0') {
+        *at++ = *length++;
+    }
+    *at++ = conversion;
+    *at = '\0';
+}
+
+static bool is_plain(const log_spec_t *spec)
+{
+    return spec->flags_length == 0 && spec->width_length == 0 && !spec->has_precision;
+}
+
+int32_t log_binary_format(const char *fmt, const uint8_t *args, const uint16_t args_size, char *out, const int32_t capacity)
+{
+    if (capacity <= 0) {
+        return 0;
+    }
+
+    log_text_t text = { .out = out, .capacity = capacity };
+    log_arg_reader_t reader = { .args = args, .size = args_size };
+    out[0] = '\0';
+
+    const char *p = fmt;
+    while (*p != '\0') {
+        const char *literal = p;
+        while (*p != '\0' && *p != '%') {
+            ++p;
+        }
+        append_text(&text, literal, (int32_t)(p - literal));
+        if (*p == '\0') {
+            break;
+        }
+
+        const char *spec_begin = p++;
+        if (*p == '%') {
+            append_text(&text, "%", 1);
+            ++p;
+            continue;
+        }
+
+        log_spec_t spec;
+        p = parse_spec(p, &spec);
+        if (spec.kind == LOG_ARG_NONE) {
+            append_text(&text, spec_begin, (int32_t)(p - spec_begin));
+            continue;
+        }
+
+        bool complete = true;
+        int64_t width = 0;
+        int64_t precision = -1;
+        if (spec.width_star) {
+            complete &= get_arg(&reader, &width, sizeof(width));
+        }
+        if (spec.precision_star) {
+            complete &= get_arg(&reader, &precision, sizeof(precision));
+        } else if (spec.has_precision) {
+            precision = SDL_strtol(spec.precision, NULL, 10);
+        }
+
+        char piece[LOG_SPEC_PIECE_SIZE];
+        char *at = text.out + text.length;
+        const int32_t room = text.capacity - text.length;
+        switch (spec.kind) {
+        case LOG_ARG_INT:
+        case LOG_ARG_UINT:
+        case LOG_ARG_CHAR: {
+            int64_t value;
+            if (complete && get_arg(&reader, &value, sizeof(value))) {
+                if (is_plain(&spec) && (spec.conversion == 'd' || spec.conversion == 'i' || spec.conversion == 'u')) {
+                    char digits[24];
+                    char *end = digits;
+                    if (spec.kind == LOG_ARG_INT && value < 0) {
+                        *end++ = '-';
+                        end = put_digits(end, 0 - (uint64_t)value);
+                    } else {
+                        end = put_digits(end, (uint64_t)value);
+                    }
+                    append_text(&text, digits, (int32_t)(end - digits));
+                    continue;
+                }
+                build_piece(piece, &spec, width, precision, spec.kind == LOG_ARG_CHAR ? "" : "ll", spec.conversion);
+                if (spec.kind == LOG_ARG_CHAR) {
+                    append_formatted(&text, SDL_snprintf(at, room, piece, (int)value));
+                } else {
+                    append_formatted(&text, SDL_snprintf(at, room, piece, (long long)value));
+                }
+                continue;
+            }
+            break;
+        }
+        case LOG_ARG_DOUBLE: {
+            double value;
+            if (complete && get_arg(&reader, &value, sizeof(value))) {
+                build_piece(piece, &spec, width, precision, "", spec.conversion);
+                append_formatted(&text, SDL_snprintf(at, room, piece, value));
+                continue;
+            }
+            break;
+        }
+        case LOG_ARG_STRING: {
+            uint16_t length;
+            if (complete && get_arg(&reader, &length, sizeof(length)) && reader.size - reader.offset >= length) {
+                // The bytes are not terminated, the precision keeps printf within them.
+                const char *value = (const char *)reader.args + reader.offset;
+                reader.offset += length;
+                if (is_plain(&spec)) {
+                    append_text(&text, value, length);
+                    continue;
+                }
+                build_piece(piece, &spec, width, precision >= 0 && precision < length ? precision : length, "", 's');
+                append_formatted(&text, SDL_snprintf(at, room, piece, value));
+                continue;
+            }
+            break;
+        }
+        case LOG_ARG_POINTER: {
+            uint64_t value;
+            if (complete && get_arg(&reader, &value, sizeof(value))) {
+                build_piece(piece, &spec, width, -1, "", 'p');
+                append_formatted(&text, SDL_snprintf(at, room, piece, (void *)(uintptr_t)value));
+                continue;
+            }
+            break;
+        }
+        case LOG_ARG_COUNT:
+        case LOG_ARG_NONE:
+            continue;
+        }
+
+        append_text(&text, "<?>", 3);
+    }
+
+    return text.length;
+}
+
+const char *log_binary_category_name(const int32_t category)
+{
+    static const char *names[] = {
+        [LOG_CATEGORY_APPLICATION] = "APPLICATION",
+        [LOG_CATEGORY_GPU] = "GPU",
+        [LOG_CATEGORY_IMAGE] = "IMAGE",
+        [LOG_CATEGORY_MEMORY] = "MEMORY",
+        [LOG_CATEGORY_WINDOW] = "WINDOW",
+        [LOG_CATEGORY_FRAME] = "FRAME",
+    };
+
+    const int32_t index = category - SDL_LOG_CATEGORY_CUSTOM;
+    if (index < 0) {
+        return "SDL";
+    }
+    if (index >= (int32_t)SDL_arraysize(names) || names[index] == NULL) {
+        return "UNKNOWN";
+    }
+    return names[index];
+}
+
+const char *log_binary_priority_name(const SDL_LogPriority priority)
+{
+    switch (priority) {
+    case SDL_LOG_PRIORITY_TRACE:
+        return "TRACE";
+    case SDL_LOG_PRIORITY_VERBOSE:
+        return "VERBOSE";
+    case SDL_LOG_PRIORITY_DEBUG:
+        return "DEBUG";
+    case SDL_LOG_PRIORITY_INFO:
+        return "INFO";
+    case SDL_LOG_PRIORITY_WARN:
+        return "WARN";
+    case SDL_LOG_PRIORITY_ERROR:
+        return "ERROR";
+    case SDL_LOG_PRIORITY_CRITICAL:
+        return "CRITICAL";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+// O--------------------------------------------------------------------------O
+// | Writer                                                                   |
+// O--------------------------------------------------------------------------O
+
+static void write_bytes(log_binary_writer_t *writer, const void *data, const size_t size)
+{
+    if (writer->buffer_used + size > sizeof(writer->buffer)) {
+        log_binary_writer_flush(writer);
+        if (size > sizeof(writer->buffer)) {
+            SDL_WriteIO(writer->io, data, size);
+            return;
+        }
+    }
+    SDL_memcpy(writer->buffer + writer->buffer_used, data, size);
+    writer->buffer_used += size;
+}
+
+bool log_binary_writer_open(log_binary_writer_t *writer, const char *path)
+{
+    SDL_zerop(writer);
+
+    writer->io = SDL_IOFromFile(path, "wb");
+    if (writer->io == NULL) {
+        return false;
+    }
+
+    uint8_t header[LOG_BINARY_HEADER_SIZE];
+    const uint32_t magic = LOG_BINARY_MAGIC;
+    const uint32_t version = LOG_BINARY_VERSION;
+    const uint64_t start_ns = SDL_GetTicksNS();
+    SDL_memcpy(header, &magic, 4);
+    SDL_memcpy(header + 4, &version, 4);
+    SDL_memcpy(header + 8, &start_ns, 8);
+    write_bytes(writer, header, sizeof(header));
+
+    return true;
+}
+
+void log_binary_writer_close(log_binary_writer_t *writer)
+{
+    if (writer->io == NULL) {
+        return;
+    }
+
+    log_binary_writer_flush(writer);
+    SDL_CloseIO(writer->io);
+    writer->io = NULL;
+}
+
+void log_binary_writer_flush(log_binary_writer_t *writer)
+{
+    if (writer->buffer_used > 0) {
+        SDL_WriteIO(writer->io, writer->buffer, writer->buffer_used);
+        writer->buffer_used = 0;
+    }
+}
+
+// Returns the id of fmt, writing a FORMAT record the first time it is seen. Once the table is half full new formats get
+// a fresh id and a FORMAT record every time they are used.
+static uint32_t intern_format(log_binary_writer_t *writer, const char *fmt)
+{
+    uint32_t slot = (uint32_t)(((uintptr_t)fmt * 0x9E3779B97F4A7C15ULL) >> 52) & (LOG_BINARY_MAX_FORMATS - 1);
+    while (writer->format_keys[slot] != NULL) {
+        if (writer->format_keys[slot] == fmt) {
+            return writer->format_ids[slot];
+        }
+        slot = (slot + 1) & (LOG_BINARY_MAX_FORMATS - 1);
+    }
+
+    const uint32_t id = writer->next_format_id++;
+    if (writer->format_count < LOG_BINARY_MAX_INTERNED_FORMATS) {
+        writer->format_keys[slot] = fmt;
+        writer->format_ids[slot] = id;
+        ++writer->format_count;
+    }
+
+    const size_t fmt_length = SDL_strlen(fmt);
+    const uint16_t length = fmt_length < UINT16_MAX ? (uint16_t)fmt_length : UINT16_MAX;
+    uint8_t record[LOG_BINARY_FORMAT_RECORD_SIZE];
+    record[0] = LOG_BINARY_RECORD_FORMAT;
+    SDL_memcpy(record + 1, &id, 4);
+    SDL_memcpy(record + 5, &length, 2);
+    write_bytes(writer, record, sizeof(record));
+    write_bytes(writer, fmt, length);
+
+    return id;
+}
+
+void log_binary_write(log_binary_writer_t *writer, const log_binary_message_t *message)
+{
+    const uint32_t format_id = intern_format(writer, message->fmt);
+
+    const int32_t priority = message->priority;
+    uint8_t record[LOG_BINARY_MESSAGE_RECORD_SIZE];
+    record[0] = LOG_BINARY_RECORD_MESSAGE;
+    SDL_memcpy(record + 1, &message->category, 4);
+    SDL_memcpy(record + 5, &priority, 4);
+    SDL_memcpy(record + 9, &message->timestamp_ns, 8);
+    SDL_memcpy(record + 17, &format_id, 4);
+    SDL_memcpy(record + 21, &message->args_size, 2);
+    write_bytes(writer, record, sizeof(record));
+    write_bytes(writer, message->args, message->args_size);
+}
+
+// O--------------------------------------------------------------------------O
+// | Reader                                                                   |
+// O--------------------------------------------------------------------------O
+
+bool log_binary_reader_open(log_binary_reader_t *reader, const char *path)
+{
+    SDL_zerop(reader);
+
+    reader->data = SDL_LoadFile(path, &reader->size);
+    if (reader->data == NULL) {
+        return false;
+    }
+
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    if (reader->size >= LOG_BINARY_HEADER_SIZE) {
+        SDL_memcpy(&magic, reader->data, 4);
+        SDL_memcpy(&version, reader->data + 4, 4);
+        SDL_memcpy(&reader->start_ns, reader->data + 8, 8);
+    }
+    if (magic != LOG_BINARY_MAGIC) {
+        SDL_free(reader->data);
+        reader->data = NULL;
+        return SDL_SetError("Not a binary log, or written on a machine with a different byte order.");
+    }
+    if (version != LOG_BINARY_VERSION) {
+        SDL_free(reader->data);
+        reader->data = NULL;
+        return SDL_SetError("Unsupported binary log version %u.", version);
+    }
+
+    reader->offset = LOG_BINARY_HEADER_SIZE;
+    return true;
+}
+
+void log_binary_reader_close(log_binary_reader_t *reader)
+{
+    for (uint32_t i = 0; i < reader->format_count; ++i) {
+        SDL_free(reader->formats[i]);
+    }
+    SDL_free(reader->formats);
+    SDL_free(reader->data);
+    SDL_zerop(reader);
+}
+
+static bool read_format_record(log_binary_reader_t *reader)
+{
+    if (reader->size - reader->offset < LOG_BINARY_FORMAT_RECORD_SIZE - 1) {
+        return false;
+    }
+
+    uint32_t id;
+    uint16_t length;
+    SDL_memcpy(&id, reader->data + reader->offset, 4);
+    SDL_memcpy(&length, reader->data + reader->offset + 4, 2);
+    reader->offset += LOG_BINARY_FORMAT_RECORD_SIZE - 1;
+    if (reader->size - reader->offset < length || id == UINT32_MAX) {
+        return false;
+    }
+
+    // The writer hands out ids in order and writes each record as the id is assigned, so an id past the next one can
+    // only come from a damaged log.
+    if (id > reader->format_count) {
+        return false;
+    }
+
+    if (id >= reader->format_capacity) {
+        if (reader->format_capacity > UINT32_MAX / 2 || (size_t)reader->format_capacity * 2 > SIZE_MAX / sizeof(char *)) {
+            return false;
+        }
+        const uint32_t capacity = reader->format_capacity > 0 ? reader->format_capacity * 2 : 64;
+        char **formats = SDL_realloc(reader->formats, capacity * sizeof(char *));
+        if (formats == NULL) {
+            return false;
+        }
+        SDL_memset(formats + reader->format_capacity, 0, (capacity - reader->format_capacity) * sizeof(char *));
+        reader->formats = formats;
+        reader->format_capacity = capacity;
+    }
+
+    char *fmt = SDL_malloc(length + 1);
+    if (fmt == NULL) {
+        return false;
+    }
+    SDL_memcpy(fmt, reader->data + reader->offset, length);
+    fmt[length] = '\0';
+    reader->offset += length;
+
+    SDL_free(reader->formats[id]);
+    reader->formats[id] = fmt;
+    if (id >= reader->format_count) {
+        reader->format_count = id + 1;
+    }
+    return true;
+}
+
+bool log_binary_read(log_binary_reader_t *reader, log_binary_message_t *message)
+{
+    while (reader->offset < reader->size) {
+        const uint8_t type = reader->data[reader->offset++];
+
+        if (type == LOG_BINARY_RECORD_FORMAT) {
+            if (!read_format_record(reader)) {
+                return false;
+            }
+            continue;
+        }
+
+        if (type != LOG_BINARY_RECORD_MESSAGE || reader->size - reader->offset < LOG_BINARY_MESSAGE_RECORD_SIZE - 1) {
+            return false;
+        }
+
+        const uint8_t *record = reader->data + reader->offset;
+        int32_t priority;
+        uint32_t format_id;
+        SDL_memcpy(&message->category, record, 4);
+        SDL_memcpy(&priority, record + 4, 4);
+        SDL_memcpy(&message->timestamp_ns, record + 8, 8);
+        SDL_memcpy(&format_id, record + 16, 4);
+        SDL_memcpy(&message->args_size, record + 20, 2);
+        reader->offset += LOG_BINARY_MESSAGE_RECORD_SIZE - 1;
+
+        if (reader->size - reader->offset < message->args_size || format_id >= reader->format_count || reader->formats[format_id] == NULL) {
+            return false;
+        }
+
+        message->priority = (SDL_LogPriority)priority;
+        message->fmt = reader->formats[format_id];
+        message->args = reader->data + reader->offset;
+        reader->offset += message->args_size;
+        return true;
+    }
+
+    return false;
+}
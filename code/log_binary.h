@@ -0,0 +1,106 @@
+#ifndef LOG_BINARY_H
+#define LOG_BINARY_H
+
+#include <SDL3/SDL.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary log messages keep the format string and the raw argument values instead of the formatted text, so the
+// formatting can happen later on another thread or offline in the decoder tool.
+//
+// Arguments are captured by walking the printf conversions of the format. Integers and pointers are stored as 8 bytes,
+// floating point as a double, strings are copied as a 16 bit length followed by the bytes. The format pointer itself is
+// kept, so it must outlive the message, which holds for string literals.
+//
+// The file starts with a log_binary_header_t followed by records, each introduced by a log_binary_record_type_t byte:
+//   FORMAT:  uint32 id, uint16 length, length bytes of format string. Written the first time a format is used.
+//   MESSAGE: int32 category, int32 priority, uint64 timestamp ns, uint32 format id, uint16 args size, args bytes.
+// Everything is in the byte order of the machine that wrote the log, the header lets the decoder check it.
+
+#define LOG_BINARY_MAGIC       0x474F4C42 // "BLOG" when read in little-endian byte order.
+#define LOG_BINARY_VERSION     1
+#define LOG_BINARY_MAX_FORMATS 4096 // Distinct format strings interned by a writer, later ones are written inline.
+#define LOG_BINARY_BUFFER_SIZE (64 * 1024)
+
+typedef struct log_binary_header_t log_binary_header_t;
+struct log_binary_header_t
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t start_ns; // SDL_GetTicksNS when the log was opened.
+};
+
+typedef enum log_binary_record_type_t log_binary_record_type_t;
+enum log_binary_record_type_t
+{
+    LOG_BINARY_RECORD_FORMAT = 1,
+    LOG_BINARY_RECORD_MESSAGE = 2,
+};
+
+typedef struct log_binary_message_t log_binary_message_t;
+struct log_binary_message_t
+{
+    int32_t category;
+    SDL_LogPriority priority;
+    uint64_t timestamp_ns;
+    const char *fmt;
+    const uint8_t *args;
+    uint16_t args_size;
+};
+
+// Captures the arguments of fmt into args. Strings are shortened to what fits in capacity, arguments that do not fit at
+// all are left out and show up as "<?>" when formatted. Returns the number of bytes written.
+uint16_t log_binary_capture(const char *fmt, va_list ap, uint8_t *args, uint16_t capacity);
+
+// Formats fmt with captured args into out, truncating to capacity. Returns the length of the text written.
+int32_t log_binary_format(const char *fmt, const uint8_t *args, uint16_t args_size, char *out, int32_t capacity);
+
+const char *log_binary_category_name(int32_t category);
+const char *log_binary_priority_name(SDL_LogPriority priority);
+
+// O--------------------------------------------------------------------------O
+// | Writer                                                                   |
+// O--------------------------------------------------------------------------O
+
+typedef struct log_binary_writer_t log_binary_writer_t;
+struct log_binary_writer_t
+{
+    SDL_IOStream *io;
+    uint32_t format_count; // Interned in format_keys.
+    uint32_t next_format_id;
+    const char *format_keys[LOG_BINARY_MAX_FORMATS]; // Open addressing on the format pointer.
+    uint32_t format_ids[LOG_BINARY_MAX_FORMATS];
+    size_t buffer_used;
+    uint8_t buffer[LOG_BINARY_BUFFER_SIZE];
+};
+
+bool log_binary_writer_open(log_binary_writer_t *writer, const char *path);
+void log_binary_writer_close(log_binary_writer_t *writer);
+void log_binary_write(log_binary_writer_t *writer, const log_binary_message_t *message);
+// Writes out buffered records. The writer buffers until the buffer is full, so flush when the log goes idle.
+void log_binary_writer_flush(log_binary_writer_t *writer);
+
+// O--------------------------------------------------------------------------O
+// | Reader                                                                   |
+// O--------------------------------------------------------------------------O
+
+typedef struct log_binary_reader_t log_binary_reader_t;
+struct log_binary_reader_t
+{
+    uint8_t *data;
+    size_t size;
+    size_t offset;
+    uint64_t start_ns;
+    char **formats; // Indexed by format id, copied out of data so they are terminated.
+    uint32_t format_count;
+    uint32_t format_capacity;
+};
+
+bool log_binary_reader_open(log_binary_reader_t *reader, const char *path);
+void log_binary_reader_close(log_binary_reader_t *reader);
+// Returns false at the end of the log or when the rest of it is damaged.
+bool log_binary_read(log_binary_reader_t *reader, log_binary_message_t *message);
+
+#endif // LOG_BINARY_H
@@ -0,0 +1,165 @@
+#include "log_file.h"
+
+#include <SDL3/SDL.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static bool log_file_map(log_file_t *file)
+{
+#if defined(_WIN32)
+    HANDLE handle = CreateFileA(file->path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return SDL_SetError("CreateFile failed with %lu", GetLastError());
+    }
+
+    // Creating the mapping extends the file to its full size.
+    const uint64_t size = file->size;
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, NULL);
+    if (mapping == NULL) {
+        CloseHandle(handle);
+        return SDL_SetError("CreateFileMapping failed with %lu", GetLastError());
+    }
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, file->size);
+    if (view == NULL) {
+        CloseHandle(mapping);
+        CloseHandle(handle);
+        return SDL_SetError("MapViewOfFile failed with %lu", GetLastError());
+    }
+
+    file->handle = (intptr_t)handle;
+    file->mapping = mapping;
+    file->view = view;
+#else
+    const int fd = open(file->path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return SDL_SetError("Failed to open %s", file->path);
+    }
+
+    // Allocate the blocks up front where the file system allows it, a full disk then fails here instead of as a
+    // SIGBUS on some later write into the mapping.
+#if defined(__linux__)
+    if (posix_fallocate(fd, 0, (off_t)file->size) != 0 && ftruncate(fd, (off_t)file->size) != 0) {
+#else
+    if (ftruncate(fd, (off_t)file->size) != 0) {
+#endif
+        close(fd);
+        return SDL_SetError("Failed to size %s", file->path);
+    }
+
+    void *view = mmap(NULL, file->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (view == MAP_FAILED) {
+        close(fd);
+        return SDL_SetError("Failed to map %s", file->path);
+    }
+
+    file->handle = fd;
+    file->view = view;
+#endif
+
+    file->offset = 0;
+    return true;
+}
+
+// Unmaps the file and trims it to what was written.
+static void log_file_unmap(log_file_t *file)
+{
+    if (file->view == NULL) {
+        return;
+    }
+
+#if defined(_WIN32)
+    UnmapViewOfFile(file->view);
+    CloseHandle((HANDLE)file->mapping);
+    LARGE_INTEGER end = { .QuadPart = (LONGLONG)file->offset };
+    if (SetFilePointerEx((HANDLE)file->handle, end, NULL, FILE_BEGIN)) {
+        SetEndOfFile((HANDLE)file->handle);
+    }
+    CloseHandle((HANDLE)file->handle);
+#else
+    munmap(file->view, file->size);
+    // When trimming fails the file keeps its zeroed tail, nothing is lost.
+    const int trimmed = ftruncate((int)file->handle, (off_t)file->offset);
+    (void)trimmed;
+    close((int)file->handle);
+#endif
+
+    file->view = NULL;
+    file->mapping = NULL;
+    file->handle = 0;
+}
+
+static void log_file_rotated_path(const log_file_t *file, const int32_t index, char *path, const size_t path_size)
+{
+    SDL_snprintf(path, path_size, "%s.%d", file->path, index);
+}
+
+// Moves path to path.1, path.1 to path.2 and so on, dropping path.keep_count. Missing files are skipped.
+static void log_file_rotate_paths(const log_file_t *file)
+{
+    char from[LOG_FILE_PATH_MAX + 16];
+    char to[LOG_FILE_PATH_MAX + 16];
+
+    if (file->keep_count <= 0) {
+        SDL_RemovePath(file->path);
+        return;
+    }
+
+    log_file_rotated_path(file, file->keep_count, to, sizeof(to));
+    SDL_RemovePath(to);
+    for (int32_t i = file->keep_count - 1; i >= 1; --i) {
+        log_file_rotated_path(file, i, from, sizeof(from));
+        log_file_rotated_path(file, i + 1, to, sizeof(to));
+        SDL_RenamePath(from, to);
+    }
+
+    log_file_rotated_path(file, 1, to, sizeof(to));
+    SDL_RenamePath(file->path, to);
+}
+
+bool log_file_open(log_file_t *file, const char *path, const size_t size, const int32_t keep_count)
+{
+    SDL_zerop(file);
+
+    if (SDL_strlcpy(file->path, path, sizeof(file->path)) >= sizeof(file->path)) {
+        return SDL_SetError("Log file path is longer than %d characters", LOG_FILE_PATH_MAX - 1);
+    }
+    file->size = size > 0 ? size : LOG_FILE_DEFAULT_SIZE;
+    file->keep_count = keep_count;
+
+    log_file_rotate_paths(file);
+    return log_file_map(file);
+}
+
+void log_file_close(log_file_t *file)
+{
+    log_file_unmap(file);
+}
+
+char *log_file_reserve(log_file_t *file, const size_t length)
+{
+    // After a failed rotation the file stays closed rather than rotating again on every line.
+    if (file->view == NULL || length > file->size) {
+        return NULL;
+    }
+
+    if (length > file->size - file->offset) {
+        log_file_unmap(file);
+        log_file_rotate_paths(file);
+        if (!log_file_map(file)) {
+            return NULL;
+        }
+    }
+
+    char *at = (char *)file->view + file->offset;
+    file->offset += length;
+    return at;
+}
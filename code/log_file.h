@@ -0,0 +1,39 @@
+#ifndef LOG_FILE_H
+#define LOG_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOG_FILE_DEFAULT_SIZE       (4 * 1024 * 1024)
+#define LOG_FILE_DEFAULT_KEEP_COUNT 3
+#define LOG_FILE_PATH_MAX           512
+
+// A log file written through a shared memory mapping. The file is created at its full size and mapped once, so
+// writing a line is a memcpy into the page cache with no system call. Lines already written survive the process
+// exiting or crashing without closing the file, the file then keeps its full size with the unused tail zeroed. Closing
+// it trims the file to what was written.
+//
+// When a line does not fit the file is closed and rotated: path becomes path.1, path.1 becomes path.2 and so on, keeping
+// keep_count old files. Opening rotates an existing file the same way, so every run starts a new one.
+//
+// Not thread safe, the log system serialises writes.
+typedef struct log_file_t log_file_t;
+struct log_file_t
+{
+    char path[LOG_FILE_PATH_MAX];
+    size_t size;
+    int32_t keep_count;
+    size_t offset;
+    uint8_t *view;
+    intptr_t handle; // File descriptor, or the file HANDLE on Windows.
+    void *mapping;   // File mapping object, Windows only.
+};
+
+bool log_file_open(log_file_t *file, const char *path, size_t size, int32_t keep_count);
+void log_file_close(log_file_t *file);
+// Returns where to write the next length bytes, rotating first when they do not fit. NULL when length is larger than
+// the file or a new file could not be opened.
+char *log_file_reserve(log_file_t *file, size_t length);
+
+#endif // LOG_FILE_H
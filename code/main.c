@@ -1,11 +1,17 @@
 #include <SDL3/SDL.h>
 #include <cglm/struct.h>
+#include <stdio.h>
 
 #include "application.h"
 #include "error.h"
+#include "file.h"
+#include "frame_stats.h"
 #include "image.h"
 #include "log.h"
 #include "memory.h"
+#include "metrics.h"
+#include "profile.h"
+#include "texture_cache.h"
 #include "window.h"
 
 // todo: perspective camera (game and editor).
@@ -62,6 +68,53 @@ mat4s get_camera_projection_matrix(const camera_t *const camera)
     return view;
 }
 
+// The simulation always advances by the same step, so a run of N frames does the same work whatever the frame rate.
+#define SIMULATION_TIMESTEP          (1.0 / 60.0)
+#define HEADLESS_DEFAULT_FRAME_COUNT 10000
+
+typedef struct scene_t scene_t;
+struct scene_t
+{
+    camera_t camera;
+    vec3s model_position;
+    float model_rotation;
+    uint64_t frame_index;
+    double time; // Simulated seconds.
+};
+
+scene_t make_scene(void)
+{
+    return (scene_t){
+        .camera = make_camera(glms_vec2_make((float[]){ 0.0f, 0.0f }), glms_vec2_make((float[]){ 1920.0f, 1080.0f })),
+        .model_position = glms_vec3_make((float[]){ 0.0f, 0.0f, 0.0f }),
+        .model_rotation = 0.0f,
+    };
+}
+
+void update_scene(scene_t *scene, const double dt)
+{
+    ++scene->frame_index;
+    scene->time += dt;
+}
+
+uniform_t build_frame_uniform(const scene_t *scene)
+{
+    mat4s projection = get_camera_projection_matrix(&scene->camera);
+    mat4s view = get_camera_view_matrix(&scene->camera);
+
+    mat4s model = glms_mat4_mulN(
+        (mat4s *[]){
+            glms_scale_make(glms_vec3_make((float[]){ 1.0f, 1.0f, 0.0f })).raw,
+            glms_rotate_make(scene->model_rotation, glms_vec3_make((float[]){ 0.0f, 0.0f, 1.0f })).raw,
+            glms_translate_make(scene->model_position).raw,
+        },
+        3);
+
+    mat4s mvp = glms_mat4_mulN((mat4s *[]){ projection.raw, view.raw, model.raw }, 3);
+
+    return (uniform_t){ .mvp = mvp };
+}
+
 typedef struct material_vertex_t material_vertex_t;
 struct material_vertex_t
 {
@@ -70,7 +123,7 @@ struct material_vertex_t
     float color[4];
 };
 
-SDL_GPUShader *load_shader(SDL_GPUDevice *device, const char *filename, const int32_t sampler_count, const int32_t uniform_buffer_count)
+static SDL_GPUShader *load_shader_file(SDL_GPUDevice *device, const char *filename, const int32_t sampler_count, const int32_t uniform_buffer_count)
 {
     SDL_GPUShaderStage stage;
     if (SDL_strstr(filename, ".vert")) {
@@ -92,44 +145,57 @@ SDL_GPUShader *load_shader(SDL_GPUDevice *device, const char *filename, const in
 
     char *full_path = NULL;
 
-    stack_allocator_t *scratch = mem_scratch_allocator();
+    temp_memory_t temp = temp_begin();
 
     if (backend_formats & SDL_GPU_SHADERFORMAT_SPIRV) {
         int32_t len = SDL_snprintf(NULL, 0, "%s../data/%s.spv", base_path, filename);
-        full_path = stack_alloc(scratch, len + 1, MEM_DEFAULT_ALIGN);
-        SDL_snprintf(full_path, len + 1, "%s../data/%s.spv", base_path, filename);
+        full_path = stack_alloc(temp.stack, len + 1, MEM_DEFAULT_ALIGN);
+        if (full_path != NULL) {
+            SDL_snprintf(full_path, len + 1, "%s../data/%s.spv", base_path, filename);
+        }
         format = SDL_GPU_SHADERFORMAT_SPIRV;
         entrypoint = "main";
     } else if (backend_formats & SDL_GPU_SHADERFORMAT_MSL) {
         int32_t len = SDL_snprintf(NULL, 0, "%s../data/%s.msl", base_path, filename);
-        full_path = stack_alloc(scratch, len + 1, MEM_DEFAULT_ALIGN);
-        SDL_snprintf(full_path, len + 1, "%s../data/%s.msl", base_path, filename);
+        full_path = stack_alloc(temp.stack, len + 1, MEM_DEFAULT_ALIGN);
+        if (full_path != NULL) {
+            SDL_snprintf(full_path, len + 1, "%s../data/%s.msl", base_path, filename);
+        }
         format = SDL_GPU_SHADERFORMAT_MSL;
         entrypoint = "main0";
     } else if (backend_formats & SDL_GPU_SHADERFORMAT_DXIL) {
         int32_t len = SDL_snprintf(NULL, 0, "%s../data/%s.dxil", base_path, filename);
-        full_path = stack_alloc(scratch, len + 1, MEM_DEFAULT_ALIGN);
-        SDL_snprintf(full_path, len + 1, "%s../data/%s.dxil", base_path, filename);
+        full_path = stack_alloc(temp.stack, len + 1, MEM_DEFAULT_ALIGN);
+        if (full_path != NULL) {
+            SDL_snprintf(full_path, len + 1, "%s../data/%s.dxil", base_path, filename);
+        }
         format = SDL_GPU_SHADERFORMAT_DXIL;
         entrypoint = "main";
     } else {
         log_error(LOG_CATEGORY_GPU, "Unsupported backend shader format.");
+        temp_end(temp);
         return NULL;
     }
 
-    size_t code_size;
-    void *code = SDL_LoadFile(full_path, &code_size);
-    if (code == NULL) {
-        log_error(LOG_CATEGORY_GPU, "Failed to load shader from path %s.", full_path);
-        stack_dealloc(scratch, full_path);
+    if (full_path == NULL) {
+        log_error(LOG_CATEGORY_GPU, "Failed to allocate the path of shader %s in scratch memory.", filename);
+        temp_end(temp);
         return NULL;
     }
 
-    stack_dealloc(scratch, full_path);
+    // The device compiles or copies the code while the shader is created, so the mapping is only needed until then.
+    file_view_t code;
+    if (!map_file(full_path, FILE_ACCESS_SEQUENTIAL, &code)) {
+        log_error(LOG_CATEGORY_GPU, "Failed to load shader from path %s, %s.", full_path, SDL_GetError());
+        temp_end(temp);
+        return NULL;
+    }
+
+    temp_end(temp);
 
     SDL_GPUShaderCreateInfo shader_info = {
-        .code = code,
-        .code_size = code_size,
+        .code = code.data,
+        .code_size = code.size,
         .entrypoint = entrypoint,
         .format = format,
         .stage = stage,
@@ -140,19 +206,117 @@ SDL_GPUShader *load_shader(SDL_GPUDevice *device, const char *filename, const in
     };
 
     SDL_GPUShader *shader = SDL_CreateGPUShader(device, &shader_info);
+    unmap_file(&code);
     if (shader == NULL) {
         log_error(LOG_CATEGORY_GPU, "Failed to create shader.");
-        SDL_free(code);
         return NULL;
     }
 
-    SDL_free(code);
     return shader;
 }
 
-int main(void)
+static metrics_counter_t g_shader_loads_metric = METRICS_COUNTER("shader_loads_total");
+static metrics_counter_t g_shader_load_us_metric = METRICS_COUNTER("shader_load_us_total");
+
+SDL_GPUShader *load_shader(SDL_GPUDevice *device, const char *filename, const int32_t sampler_count, const int32_t uniform_buffer_count)
 {
-    start_application();
+    PROFILE_BEGIN("load_shader");
+    const uint64_t begin = SDL_GetTicksNS();
+    SDL_GPUShader *shader = load_shader_file(device, filename, sampler_count, uniform_buffer_count);
+    metrics_counter_add(&g_shader_loads_metric, 1);
+    metrics_counter_add(&g_shader_load_us_metric, (int64_t)((SDL_GetTicksNS() - begin) / SDL_NS_PER_US));
+    PROFILE_END();
+    return shader;
+}
+
+// Frames to run headless, 0 to run with a window. Headless mode is selected with --headless or by setting
+// BODIES_HEADLESS to anything but 0, the frame count with --frames <n> or BODIES_HEADLESS_FRAMES.
+int32_t headless_frame_count(int argc, char **argv)
+{
+    const char *headless = SDL_getenv("BODIES_HEADLESS");
+    bool selected = headless != NULL && headless[0] != '\0' && SDL_strcmp(headless, "0") != 0;
+
+    const char *frames = SDL_getenv("BODIES_HEADLESS_FRAMES");
+    for (int i = 1; i < argc; ++i) {
+        if (SDL_strcmp(argv[i], "--headless") == 0) {
+            selected = true;
+        } else if (SDL_strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = argv[++i];
+        }
+    }
+
+    if (!selected) {
+        return 0;
+    }
+
+    const int32_t frame_count = frames != NULL ? SDL_atoi(frames) : 0;
+    return frame_count > 0 ? frame_count : HEADLESS_DEFAULT_FRAME_COUNT;
+}
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, const size_t size)
+{
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL; // FNV-1a.
+    }
+    return hash;
+}
+
+// Runs the CPU side of frame_count frames without a window or GPU device and prints throughput and frame timings. The
+// checksum covers the scene state every frame stepped to and the uniform built from it, so runs with matching
+// checksums simulated the same steps and built the same uniforms.
+int run_headless(const int32_t frame_count)
+{
+    start_application((application_desc_t){ .headless = true });
+
+    scene_t scene = make_scene();
+    uint64_t checksum = 0xcbf29ce484222325ULL;
+
+    const uint64_t begin = SDL_GetTicksNS();
+    for (int32_t frame = 0; frame < frame_count; ++frame) {
+        PROFILE_BEGIN("run_headless_frame");
+        begin_application_frame();
+
+        frame_stats_begin(FRAME_STAT_BUILD);
+
+        update_scene(&scene, SIMULATION_TIMESTEP);
+        const uniform_t uniform = build_frame_uniform(&scene);
+
+        checksum = hash_bytes(checksum, &scene.frame_index, sizeof(scene.frame_index));
+        checksum = hash_bytes(checksum, &scene.time, sizeof(scene.time));
+        checksum = hash_bytes(checksum, &uniform, sizeof(uniform));
+
+        frame_stats_end(FRAME_STAT_BUILD);
+        frame_stats_end_frame();
+        PROFILE_END();
+    }
+    const uint64_t elapsed = SDL_GetTicksNS() - begin;
+
+    printf("headless: %d frames, fixed timestep %.3f ms, %.3f simulated seconds\n", frame_count, SIMULATION_TIMESTEP * 1000.0, scene.time);
+    printf("%12s %12s %18s\n", "frames/s", "us/frame", "checksum");
+    printf("%12.0f %12.3f %18llx\n", frame_count / ((double)elapsed / SDL_NS_PER_SECOND), (double)elapsed / frame_count / 1000.0, (unsigned long long)checksum);
+
+    printf("%-15s %8s %10s %10s %10s %10s %10s %10s\n", "stat", "frames", "min us", "avg us", "p50 us", "p95 us", "p99 us", "max us");
+    for (int32_t i = 0; i < FRAME_STAT_COUNT; ++i) {
+        frame_stats_summary_t summary;
+        if (frame_stats_summary((frame_stat_t)i, FRAME_STATS_SAMPLE_COUNT, &summary)) {
+            printf("%-15s %8d %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n", frame_stat_name((frame_stat_t)i), summary.frame_count, summary.min_ms * 1000.0, summary.avg_ms * 1000.0, summary.p50_ms * 1000.0, summary.p95_ms * 1000.0, summary.p99_ms * 1000.0, summary.max_ms * 1000.0);
+        }
+    }
+
+    stop_application();
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const int32_t headless_frames = headless_frame_count(argc, argv);
+    if (headless_frames > 0) {
+        return run_headless(headless_frames);
+    }
+
+    start_application((application_desc_t){ 0 });
+
     create_window("Bodies", 1920, 1080);
 
     // todo: add FEATURE_GPU_DEBUG_MODE
@@ -384,38 +548,41 @@ int main(void)
     SDL_UnmapGPUTransferBuffer(device, default_texture_transfer_buffer);
 
     // Create Mondrian material.
-    image_t mondrian = load_image("images/mondrian.png");
-    // todo: make SDL_Surface part of image?
-    SDL_Surface *mondrian_surface = SDL_CreateSurfaceFrom(mondrian.width, mondrian.height, SDL_PIXELFORMAT_RGBA8888, mondrian.data, mondrian.pitch);
+    // The cooked texture is mapped from the texture cache with its mip chain, ready to be copied into the transfer buffer.
+    cooked_texture_t mondrian;
+    if (!load_cooked_texture("images/mondrian.png", &mondrian)) {
+        log_error(LOG_CATEGORY_IMAGE, "Failed to load the Mondrian material image.");
+        exit_application(IMAGE_LOAD_ERROR);
+    }
 
     SDL_GPUTexture *mondrian_texture = SDL_CreateGPUTexture(
         device,
         &(SDL_GPUTextureCreateInfo){
             .type = SDL_GPU_TEXTURETYPE_2D,
             .format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM, // todo: how do we use SRGB in SDL?
-            .width = mondrian_surface->w,
-            .height = mondrian_surface->h,
+            .width = mondrian.width,
+            .height = mondrian.height,
             .layer_count_or_depth = 1,
-            .num_levels = 1,
+            .num_levels = mondrian.level_count,
             .usage = SDL_GPU_TEXTUREUSAGE_SAMPLER,
         });
     SDL_SetGPUTextureName(device, mondrian_texture, "mondrian material");
 
-    int32_t bytes_per_pixel = image_bytes_per_pixel(&mondrian);
     SDL_GPUTransferBuffer *mondrian_transfer_buffer = SDL_CreateGPUTransferBuffer(
         device,
         &(SDL_GPUTransferBufferCreateInfo){
             .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
-            .size = mondrian_surface->w * mondrian_surface->h * bytes_per_pixel,
+            .size = (uint32_t)mondrian.data_size,
         });
 
     uint8_t *mondrian_transfer_data = SDL_MapGPUTransferBuffer(device, mondrian_transfer_buffer, false);
 
-    SDL_memcpy(mondrian_transfer_data, mondrian_surface->pixels, mondrian_surface->w * mondrian_surface->h * 4);
+    SDL_memcpy(mondrian_transfer_data, mondrian.levels[0].data, mondrian.data_size);
 
     SDL_UnmapGPUTransferBuffer(device, mondrian_transfer_buffer);
 
     // Upload the data to the GPU.
+    PROFILE_BEGIN("upload copy pass");
     SDL_GPUCommandBuffer *upload_cmd_buf = SDL_AcquireGPUCommandBuffer(device);
     SDL_GPUCopyPass *copy_pass = SDL_BeginGPUCopyPass(upload_cmd_buf);
 
@@ -459,43 +626,35 @@ int main(void)
         },
         false);
 
-    SDL_UploadToGPUTexture(
-        copy_pass,
-        &(SDL_GPUTextureTransferInfo){
-            .transfer_buffer = mondrian_transfer_buffer,
-            .offset = 0,
-        },
-        &(SDL_GPUTextureRegion){
-            .texture = mondrian_texture,
-            .w = mondrian_surface->w,
-            .h = mondrian_surface->h,
-            .d = 1,
-        },
-        false);
+    // The levels are tightly packed in the transfer buffer, in the same order as in the cooked texture.
+    for (int32_t level = 0; level < mondrian.level_count; ++level) {
+        SDL_UploadToGPUTexture(
+            copy_pass,
+            &(SDL_GPUTextureTransferInfo){
+                .transfer_buffer = mondrian_transfer_buffer,
+                .offset = (uint32_t)((const uint8_t *)mondrian.levels[level].data - (const uint8_t *)mondrian.levels[0].data),
+            },
+            &(SDL_GPUTextureRegion){
+                .texture = mondrian_texture,
+                .mip_level = level,
+                .w = mondrian.levels[level].width,
+                .h = mondrian.levels[level].height,
+                .d = 1,
+            },
+            false);
+    }
 
     SDL_EndGPUCopyPass(copy_pass);
     SDL_SubmitGPUCommandBuffer(upload_cmd_buf);
+    PROFILE_END();
     SDL_ReleaseGPUTransferBuffer(device, triangle_transfer_buffer);
     SDL_ReleaseGPUTransferBuffer(device, mondrian_transfer_buffer);
     SDL_ReleaseGPUTransferBuffer(device, default_texture_transfer_buffer);
+    free_cooked_texture(&mondrian);
 
     // ------------
 
-    camera_t camera = make_camera(glms_vec2_make((float[]){ 0.0f, 0.0f }), glms_vec2_make((float[]){ 1920.0f, 1080.0f }));
-    mat4s projection = get_camera_projection_matrix(&camera);
-    mat4s view = get_camera_view_matrix(&camera);
-
-    mat4s model = glms_mat4_mulN(
-        (mat4s *[]){
-            glms_scale_make(glms_vec3_make((float[]){ 1.0f, 1.0f, 0.0f })).raw,
-            glms_rotate_make(0.0f, glms_vec3_make((float[]){ 0.0f, 0.0f, 1.0f })).raw,
-            glms_translate_make(glms_vec3_make((float[]){ 0.0f, 0.0f, 0.0f })).raw,
-        },
-        3);
-
-    mat4s mvp = glms_mat4_mulN((mat4s *[]){ projection.raw, view.raw, model.raw }, 3);
-
-    uniform_t uniform = { .mvp = mvp };
+    scene_t scene = make_scene();
 
     while (run_window_event_loop()) {
         if (close_window_requested()) {
@@ -508,6 +667,11 @@ int main(void)
             // todo: resize render targets
         }
 
+        frame_stats_begin(FRAME_STAT_BUILD);
+
+        update_scene(&scene, SIMULATION_TIMESTEP);
+        const uniform_t uniform = build_frame_uniform(&scene);
+
         SDL_GPUCommandBuffer *cmd_buf = SDL_AcquireGPUCommandBuffer(device);
         if (cmd_buf == NULL) {
             log_error(LOG_CATEGORY_GPU, "AcquireGPUCommandBuffer failed: %s", SDL_GetError());
@@ -516,6 +680,8 @@ int main(void)
         }
 
         if (render_target != NULL) {
+            PROFILE_BEGIN("material render pass");
+
             SDL_GPUColorTargetInfo colorTargetInfo = {
                 .texture = render_target,
                 .clear_color = (SDL_FColor){ 0.3f, 0.9f, 0.3f, 1.0f },
@@ -535,22 +701,33 @@ int main(void)
             SDL_DrawGPUIndexedPrimitives(rpass, 3, 1, 0, 0, 0);
 
             SDL_EndGPURenderPass(rpass);
+
+            PROFILE_END();
         }
 
         SDL_GPUTexture *swapchain_texture;
         uint32_t swapchain_width;
         uint32_t swapchain_height;
-        if (!SDL_WaitAndAcquireGPUSwapchainTexture(cmd_buf, window_handle(), &swapchain_texture, &swapchain_width, &swapchain_height)) {
+        frame_stats_end(FRAME_STAT_BUILD);
+        frame_stats_begin(FRAME_STAT_SWAPCHAIN_WAIT);
+        PROFILE_BEGIN("acquire swapchain");
+        const bool acquired = SDL_WaitAndAcquireGPUSwapchainTexture(cmd_buf, window_handle(), &swapchain_texture, &swapchain_width, &swapchain_height);
+        PROFILE_END();
+        frame_stats_end(FRAME_STAT_SWAPCHAIN_WAIT);
+        frame_stats_begin(FRAME_STAT_BUILD);
+        if (!acquired) {
             log_error(LOG_CATEGORY_GPU, "WaitAndAcquireGPUSwapchainTexture failed: %s", SDL_GetError());
             exit_window_event_loop();
             continue;
         }
 
         if (swapchain_width != window_width || swapchain_height != window_height) {
-            log_warn(LOG_CATEGORY_GPU, "Swapchain size (%d x %d) differs from window size (%d x %d).", swapchain_width, swapchain_height, window_width, window_height);
+            log_limited(LOG_LEVEL_WARN, LOG_CATEGORY_GPU, "Swapchain size (%d x %d) differs from window size (%d x %d).", swapchain_width, swapchain_height, window_width, window_height);
         }
 
         if (swapchain_texture != NULL) {
+            PROFILE_BEGIN("swapchain render pass");
+
             SDL_GPUColorTargetInfo colorTargetInfo = {
                 .texture = swapchain_texture,
                 .clear_color = (SDL_FColor){ 0.3f, 0.3f, 0.9f, 1.0f },
@@ -565,14 +742,18 @@ int main(void)
             SDL_DrawGPUPrimitives(rpass, 3, 1, 0, 0);
 
             SDL_EndGPURenderPass(rpass);
+
+            PROFILE_END();
         }
 
+        PROFILE_BEGIN("submit");
         SDL_SubmitGPUCommandBuffer(cmd_buf);
-    }
+        PROFILE_END();
 
-    free_image(&mondrian);
+        frame_stats_end(FRAME_STAT_BUILD);
+        frame_stats_end_frame();
+    }
 
-    SDL_DestroySurface(mondrian_surface);
     SDL_DestroySurface(default_material_surface);
 
     SDL_ReleaseGPUGraphicsPipeline(device, material_pipeline);
@@ -6,267 +6,2143 @@
 #include <stdlib.h>
 #include <tlsf.h>
 
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "atomic.h"
 #include "log.h"
 
-typedef struct memory_system_t memory_system_t;
-struct memory_system_t
+typedef struct scratch_arena_t scratch_arena_t;
+
+typedef struct memory_system_t memory_system_t;
+struct memory_system_t
+{
+    heap_allocator_t system;
+    handle_heap_t handles;
+    size_t handle_compact_budget;
+    scratch_arena_t *scratch_arenas;
+    SDL_SpinLock scratch_lock;
+    SDL_TLSID scratch_tls;
+    size_t scratch_size;
+    size_t scratch_reserve_size;
+    bool huge_pages;
+    linear_allocator_t frames[FRAME_ARENA_MAX_COUNT];
+    int32_t frame_count;
+    int32_t frame;
+    frame_memory_stats_t frame_stats;
+    int32_t stats_dump_interval;
+};
+
+static memory_system_t g_memory_system;
+
+// O--------------------------------------------------------------------------O
+// | Forward Declarations                                                     |
+// O--------------------------------------------------------------------------O
+
+size_t memory_align(size_t size, size_t align);
+#if FEATURE_MEMORY_CALLSITES
+static void memory_callsite_log(const char *label, const memory_callsite_stats_t *callsite);
+#endif
+
+// O--------------------------------------------------------------------------O
+// | Memory Stats                                                             |
+// O--------------------------------------------------------------------------O
+
+#if FEATURE_MEMORY_STATS
+
+#define MEMORY_STATS_MAX_ALLOCATORS 32
+#define MEMORY_CALLSITE_DUMP_COUNT 8
+
+typedef struct memory_stats_entry_t memory_stats_entry_t;
+struct memory_stats_entry_t
+{
+    const char *name;
+    memory_counters_t *counters;
+    uint32_t last_frame_allocation_count;
+};
+
+static const char *g_memory_tag_names[MEMORY_TAG_COUNT] = {
+    "untagged",
+    "sdl",
+    "image",
+    "log",
+};
+
+static memory_counters_t g_memory_tag_counters[MEMORY_TAG_COUNT];
+static uint32_t g_memory_tag_last_frame_allocation_count[MEMORY_TAG_COUNT];
+static memory_stats_entry_t g_memory_stats_entries[MEMORY_STATS_MAX_ALLOCATORS];
+static int32_t g_memory_stats_entry_count;
+static SDL_SpinLock g_memory_stats_lock;
+static THREAD_LOCAL memory_tag_t t_memory_tag;
+
+static const char *g_frame_arena_names[FRAME_ARENA_MAX_COUNT] = { "frame 0", "frame 1", "frame 2", "frame 3" };
+
+static int32_t memory_size_class(size_t size)
+{
+    int32_t index = 0;
+    size_t limit = 16;
+    while (size > limit && index < MEMORY_SIZE_CLASS_COUNT - 1) {
+        limit <<= 2;
+        ++index;
+    }
+    return index;
+}
+
+static void memory_counters_reset(memory_counters_t *counters)
+{
+    SDL_zerop(counters);
+}
+
+static void memory_counters_count(memory_counters_t *counters, size_t size)
+{
+    atomic_add_i32(&counters->allocation_count, 1);
+    atomic_add_i32(&counters->frame_allocation_count, 1);
+    atomic_add_i32(&counters->size_classes[memory_size_class(size)], 1);
+}
+
+// Used by the single-threaded allocators, which already know their exact footprint including padding.
+static void memory_counters_set_in_use(memory_counters_t *counters, size_t in_use)
+{
+    atomic_store_i64(&counters->in_use, (int64_t)in_use);
+    atomic_max_i64(&counters->peak, (int64_t)in_use);
+}
+
+static void memory_counters_alloc(memory_counters_t *counters, size_t size)
+{
+    const int64_t in_use = atomic_add_i64(&counters->in_use, (int64_t)size) + (int64_t)size;
+    atomic_max_i64(&counters->peak, in_use);
+    memory_counters_count(counters, size);
+}
+
+static void memory_counters_free(memory_counters_t *counters, size_t size)
+{
+    atomic_add_i64(&counters->in_use, -(int64_t)size);
+}
+
+static void memory_counters_snapshot(memory_counters_t *counters, const char *name, uint32_t last_frame_allocation_count, memory_stats_t *stats)
+{
+    stats->name = name;
+    stats->in_use = (size_t)atomic_load_i64(&counters->in_use);
+    stats->peak = (size_t)atomic_load_i64(&counters->peak);
+    stats->allocation_count = (uint32_t)atomic_load_i32(&counters->allocation_count);
+    stats->frame_allocation_count = last_frame_allocation_count;
+    for (int32_t i = 0; i < MEMORY_SIZE_CLASS_COUNT; ++i) {
+        stats->size_classes[i] = (uint32_t)atomic_load_i32(&counters->size_classes[i]);
+    }
+}
+
+static void memory_stats_begin_frame(void)
+{
+    SDL_LockSpinlock(&g_memory_stats_lock);
+    for (int32_t i = 0; i < g_memory_stats_entry_count; ++i) {
+        memory_stats_entry_t *entry = &g_memory_stats_entries[i];
+        entry->last_frame_allocation_count = (uint32_t)atomic_exchange_i32(&entry->counters->frame_allocation_count, 0);
+    }
+    SDL_UnlockSpinlock(&g_memory_stats_lock);
+
+    for (int32_t i = 0; i < MEMORY_TAG_COUNT; ++i) {
+        g_memory_tag_last_frame_allocation_count[i] = (uint32_t)atomic_exchange_i32(&g_memory_tag_counters[i].frame_allocation_count, 0);
+    }
+}
+
+static void memory_stats_log(const memory_stats_t *stats)
+{
+    if (!log_enabled(LOG_CATEGORY_MEMORY, LOG_LEVEL_DEBUG)) {
+        return;
+    }
+
+    char classes[MEMORY_SIZE_CLASS_COUNT * 12];
+    int32_t len = 0;
+    for (int32_t i = 0; i < MEMORY_SIZE_CLASS_COUNT; ++i) {
+        len += SDL_snprintf(classes + len, sizeof(classes) - len, i == 0 ? "%u" : " %u", stats->size_classes[i]);
+    }
+
+    log_debug(LOG_CATEGORY_MEMORY, "Memory stats %s: in use %llu, peak %llu, allocations %u (%u last frame), size classes [%s].", stats->name, stats->in_use, stats->peak, stats->allocation_count, stats->frame_allocation_count, classes);
+}
+
+memory_tag_t mem_set_tag(memory_tag_t tag)
+{
+    const memory_tag_t previous = t_memory_tag;
+    t_memory_tag = tag;
+    return previous;
+}
+
+void mem_stats_register(const char *name, memory_counters_t *counters)
+{
+    SDL_LockSpinlock(&g_memory_stats_lock);
+    if (g_memory_stats_entry_count < MEMORY_STATS_MAX_ALLOCATORS) {
+        g_memory_stats_entries[g_memory_stats_entry_count++] = (memory_stats_entry_t){ .name = name, .counters = counters };
+    }
+    SDL_UnlockSpinlock(&g_memory_stats_lock);
+}
+
+void mem_stats_unregister(memory_counters_t *counters)
+{
+    SDL_LockSpinlock(&g_memory_stats_lock);
+    for (int32_t i = 0; i < g_memory_stats_entry_count; ++i) {
+        if (g_memory_stats_entries[i].counters == counters) {
+            g_memory_stats_entries[i] = g_memory_stats_entries[--g_memory_stats_entry_count];
+            break;
+        }
+    }
+    SDL_UnlockSpinlock(&g_memory_stats_lock);
+}
+
+#endif // FEATURE_MEMORY_STATS
+
+int32_t mem_stats_allocator_count(void)
+{
+#if FEATURE_MEMORY_STATS
+    return g_memory_stats_entry_count;
+#else
+    return 0;
+#endif
+}
+
+bool mem_stats_allocator(int32_t index, memory_stats_t *stats)
+{
+#if FEATURE_MEMORY_STATS
+    bool found = false;
+    SDL_LockSpinlock(&g_memory_stats_lock);
+    if (index >= 0 && index < g_memory_stats_entry_count) {
+        memory_stats_entry_t *entry = &g_memory_stats_entries[index];
+        memory_counters_snapshot(entry->counters, entry->name, entry->last_frame_allocation_count, stats);
+        found = true;
+    }
+    SDL_UnlockSpinlock(&g_memory_stats_lock);
+    return found;
+#else
+    (void)index;
+    (void)stats;
+    return false;
+#endif
+}
+
+bool mem_stats_tag(memory_tag_t tag, memory_stats_t *stats)
+{
+#if FEATURE_MEMORY_STATS
+    if (tag < 0 || tag >= MEMORY_TAG_COUNT) {
+        return false;
+    }
+
+    memory_counters_snapshot(&g_memory_tag_counters[tag], g_memory_tag_names[tag], g_memory_tag_last_frame_allocation_count[tag], stats);
+    return true;
+#else
+    (void)tag;
+    (void)stats;
+    return false;
+#endif
+}
+
+void mem_stats_dump(void)
+{
+#if FEATURE_MEMORY_STATS
+    memory_stats_t stats;
+    for (int32_t i = 0; mem_stats_allocator(i, &stats); ++i) {
+        memory_stats_log(&stats);
+    }
+    for (int32_t i = 0; i < MEMORY_TAG_COUNT; ++i) {
+        mem_stats_tag((memory_tag_t)i, &stats);
+        memory_stats_log(&stats);
+    }
+#endif
+
+#if FEATURE_MEMORY_CALLSITES
+    memory_callsite_stats_t callsites[MEMORY_CALLSITE_DUMP_COUNT];
+    int32_t count = mem_callsites_top(MEMORY_CALLSITE_BY_BYTES, callsites, MEMORY_CALLSITE_DUMP_COUNT);
+    for (int32_t i = 0; i < count; ++i) {
+        memory_callsite_log("Hot callsite by bytes", &callsites[i]);
+    }
+    count = mem_callsites_top(MEMORY_CALLSITE_BY_COUNT, callsites, MEMORY_CALLSITE_DUMP_COUNT);
+    for (int32_t i = 0; i < count; ++i) {
+        memory_callsite_log("Hot callsite by count", &callsites[i]);
+    }
+#endif
+}
+
+// O--------------------------------------------------------------------------O
+// | Memory Callsites                                                         |
+// O--------------------------------------------------------------------------O
+
+#if FEATURE_MEMORY_CALLSITES
+
+// Open addressed on the (file, line) pair. Slots are claimed once and never freed, so lookups only take the lock when
+// they find an empty slot. Index 0 collects anything that could not be attributed. The index is stored in the heap
+// stats header, so the capacity must fit in 16 bits.
+#define MEMORY_CALLSITE_CAPACITY 4096
+#define MEMORY_CALLSITE_MAX_PROBES 32
+#define MEMORY_CALLSITE_LEAK_REPORT_COUNT 32
+
+typedef struct memory_callsite_t memory_callsite_t;
+struct memory_callsite_t
+{
+    void *file; // Published after line, read with SDL's atomic pointer functions.
+    int32_t line;
+    int32_t live_count;
+    int32_t allocation_count;
+    int64_t in_use;
+    int64_t total_bytes;
+};
+
+static memory_callsite_t g_memory_callsites[MEMORY_CALLSITE_CAPACITY] = {
+    [0] = { .file = "(unattributed)" },
+};
+static SDL_SpinLock g_memory_callsites_lock;
+
+static uint16_t memory_callsite_index(const char *file, int32_t line)
+{
+    const uint32_t hash = (uint32_t)((uintptr_t)file >> 3) * 2654435761u ^ (uint32_t)line * 40503u;
+
+    for (uint32_t probe = 0; probe < MEMORY_CALLSITE_MAX_PROBES; ++probe) {
+        const uint32_t index = (hash + probe) & (MEMORY_CALLSITE_CAPACITY - 1);
+        if (index == 0) {
+            continue;
+        }
+
+        memory_callsite_t *site = &g_memory_callsites[index];
+        void *site_file = SDL_GetAtomicPointer(&site->file);
+        if (site_file == NULL) {
+            SDL_LockSpinlock(&g_memory_callsites_lock);
+            site_file = site->file;
+            if (site_file == NULL) {
+                site->line = line;
+                SDL_SetAtomicPointer(&site->file, (void *)file);
+                site_file = (void *)file;
+            }
+            SDL_UnlockSpinlock(&g_memory_callsites_lock);
+        }
+
+        if (site_file == file && site->line == line) {
+            return (uint16_t)index;
+        }
+    }
+
+    return 0;
+}
+
+static void memory_callsite_count(uint16_t index, size_t size)
+{
+    memory_callsite_t *site = &g_memory_callsites[index];
+    atomic_add_i32(&site->allocation_count, 1);
+    atomic_add_i64(&site->total_bytes, (int64_t)size);
+}
+
+static void memory_callsite_alloc(uint16_t index, size_t size)
+{
+    memory_callsite_t *site = &g_memory_callsites[index];
+    memory_callsite_count(index, size);
+    atomic_add_i32(&site->live_count, 1);
+    atomic_add_i64(&site->in_use, (int64_t)size);
+}
+
+static void memory_callsite_free(uint16_t index, size_t size)
+{
+    memory_callsite_t *site = &g_memory_callsites[index];
+    atomic_add_i32(&site->live_count, -1);
+    atomic_add_i64(&site->in_use, -(int64_t)size);
+}
+
+static uint64_t memory_callsite_key(const memory_callsite_stats_t *stats, memory_callsite_order_t order)
+{
+    switch (order) {
+    case MEMORY_CALLSITE_BY_BYTES:
+        return stats->total_bytes;
+    case MEMORY_CALLSITE_BY_COUNT:
+        return stats->allocation_count;
+    case MEMORY_CALLSITE_BY_IN_USE:
+        return stats->in_use;
+    }
+    return 0;
+}
+
+static const char *memory_callsite_file_name(const char *file)
+{
+    const char *name = file;
+    for (const char *c = file; *c != '\0'; ++c) {
+        if (*c == '/' || *c == '\\') {
+            name = c + 1;
+        }
+    }
+    return name;
+}
+
+static void memory_callsite_log(const char *label, const memory_callsite_stats_t *callsite)
+{
+    log_debug(LOG_CATEGORY_MEMORY, "%s %s:%d: %llu bytes in %u allocations, %llu bytes in %u live.", label, memory_callsite_file_name(callsite->file), callsite->line, callsite->total_bytes, callsite->allocation_count, callsite->in_use, callsite->live_count);
+}
+
+#endif // FEATURE_MEMORY_CALLSITES
+
+int32_t mem_callsites_top(memory_callsite_order_t order, memory_callsite_stats_t *callsites, int32_t max_count)
+{
+#if FEATURE_MEMORY_CALLSITES
+    // Keeps the best max_count callsites sorted by insertion; max_count is expected to be small.
+    int32_t count = 0;
+    for (int32_t i = 0; i < MEMORY_CALLSITE_CAPACITY && max_count > 0; ++i) {
+        memory_callsite_t *site = &g_memory_callsites[i];
+        const char *file = SDL_GetAtomicPointer(&site->file);
+        if (file == NULL) {
+            continue;
+        }
+
+        const memory_callsite_stats_t stats = {
+            .file = file,
+            .line = site->line,
+            .in_use = (size_t)atomic_load_i64(&site->in_use),
+            .live_count = (uint32_t)atomic_load_i32(&site->live_count),
+            .total_bytes = (size_t)atomic_load_i64(&site->total_bytes),
+            .allocation_count = (uint32_t)atomic_load_i32(&site->allocation_count),
+        };
+
+        const uint64_t key = memory_callsite_key(&stats, order);
+        if (key == 0) {
+            continue;
+        }
+
+        int32_t slot = count;
+        if (count < max_count) {
+            ++count;
+        } else if (key > memory_callsite_key(&callsites[max_count - 1], order)) {
+            slot = max_count - 1;
+        } else {
+            continue;
+        }
+
+        while (slot > 0 && memory_callsite_key(&callsites[slot - 1], order) < key) {
+            callsites[slot] = callsites[slot - 1];
+            --slot;
+        }
+        callsites[slot] = stats;
+    }
+    return count;
+#else
+    (void)order;
+    (void)callsites;
+    (void)max_count;
+    return 0;
+#endif
+}
+
+void mem_callsites_report_leaks(void)
+{
+#if FEATURE_MEMORY_CALLSITES
+    memory_callsite_stats_t callsites[MEMORY_CALLSITE_LEAK_REPORT_COUNT];
+    const int32_t count = mem_callsites_top(MEMORY_CALLSITE_BY_IN_USE, callsites, MEMORY_CALLSITE_LEAK_REPORT_COUNT);
+    for (int32_t i = 0; i < count; ++i) {
+        log_warn(LOG_CATEGORY_MEMORY, "Leaked %llu bytes in %u allocations from %s:%d.", callsites[i].in_use, callsites[i].live_count, memory_callsite_file_name(callsites[i].file), callsites[i].line);
+    }
+#endif
+}
+
+// O--------------------------------------------------------------------------O
+// | Virtual Memory                                                           |
+// O--------------------------------------------------------------------------O
+
+size_t vm_page_size(void)
+{
+    static size_t page_size;
+    if (page_size == 0) {
+        page_size = (size_t)SDL_GetSystemPageSize();
+        if (page_size == 0) {
+            page_size = KB(4);
+        }
+    }
+    return page_size;
+}
+
+void *vm_reserve(size_t size)
+{
+#if defined(_WIN32)
+    return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    void *mem = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return mem == MAP_FAILED ? NULL : mem;
+#endif
+}
+
+#if defined(MADV_HUGEPAGE)
+// madvise succeeds even when transparent huge pages are switched off, so ask the kernel whether they are in use.
+static bool vm_transparent_huge_pages_enabled(void)
+{
+    char mode[128] = { 0 };
+    int fd = open("/sys/kernel/mm/transparent_hugepage/enabled", O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    ssize_t len = read(fd, mode, sizeof(mode) - 1);
+    close(fd);
+    return len > 0 && SDL_strstr(mode, "[never]") == NULL;
+}
+#endif
+
+void *vm_reserve_huge(size_t size, vm_backing_t *backing)
+{
+    *backing = VM_BACKING_SMALL_PAGES;
+
+#if defined(_WIN32)
+    // Large pages on Windows need SeLockMemoryPrivilege and must be committed when they are reserved, which does not
+    // fit committing on demand, so they are never used.
+    return vm_reserve(size);
+#else
+    // Over-reserve and trim so the range starts on a huge page boundary.
+    uint8_t *mem = vm_reserve(size + VM_HUGE_PAGE_SIZE);
+    if (mem == NULL) {
+        return NULL;
+    }
+
+    uint8_t *aligned = (uint8_t *)memory_align((uintptr_t)mem, VM_HUGE_PAGE_SIZE);
+    if (aligned != mem) {
+        munmap(mem, aligned - mem);
+    }
+    munmap(aligned + size, mem + VM_HUGE_PAGE_SIZE - aligned);
+
+#if defined(MADV_HUGEPAGE)
+    if (vm_transparent_huge_pages_enabled() && madvise(aligned, size, MADV_HUGEPAGE) == 0) {
+        *backing = VM_BACKING_TRANSPARENT_HUGE_PAGES;
+    }
+#endif
+
+    return aligned;
+#endif
+}
+
+const char *vm_backing_name(vm_backing_t backing)
+{
+    switch (backing) {
+    case VM_BACKING_SMALL_PAGES:
+        return "small pages";
+    case VM_BACKING_TRANSPARENT_HUGE_PAGES:
+        return "transparent huge pages";
+    }
+    return "unknown";
+}
+
+bool vm_commit(void *mem, size_t size)
+{
+#if defined(_WIN32)
+    return VirtualAlloc(mem, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+#else
+    return mprotect(mem, size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+void vm_decommit(void *mem, size_t size)
+{
+#if defined(_WIN32)
+    VirtualFree(mem, size, MEM_DECOMMIT);
+#else
+    madvise(mem, size, MADV_DONTNEED);
+    mprotect(mem, size, PROT_NONE);
+#endif
+}
+
+void vm_release(void *mem, size_t size)
+{
+#if defined(_WIN32)
+    (void)size;
+    VirtualFree(mem, 0, MEM_RELEASE);
+#else
+    munmap(mem, size);
+#endif
+}
+
+// O--------------------------------------------------------------------------O
+// | Heap Allocator                                                           |
+// O--------------------------------------------------------------------------O
+
+#define HEAP_MAX_POOLS 64
+
+typedef struct heap_pool_t heap_pool_t;
+struct heap_pool_t
+{
+    uint8_t *base;
+    size_t size;
+    pool_t pool; // NULL while the pages are decommitted and the range is free for reuse.
+    size_t live_count;
+};
+
+// Each shard is a TLSF instance over its own slice of the heap's reserved address space, guarded by its own spinlock.
+// Threads are assigned a home shard the first time they allocate, so threads only contend when they share a home
+// shard. Blocks freed while their shard is busy, or from a thread other than the shard's own, are pushed onto a
+// lock-free remote free list which is handed back to TLSF in one batch the next time the shard lock is taken.
+//
+// Pools are committed on demand when TLSF runs out of space and given back to the OS once they empty. One empty pool
+// per shard is kept committed so that churn around a pool boundary does not keep hitting the OS.
+struct heap_shard_t
+{
+    _Alignas(CACHE_LINE_SIZE) SDL_SpinLock lock;
+    void *tlsf;
+    uint8_t *commit_end;
+    uint8_t *end;
+    size_t pool_size;
+    size_t commit_granularity;
+    size_t committed_size;
+    int32_t pool_count;
+    int32_t empty_pool;
+    heap_pool_t pools[HEAP_MAX_POOLS];
+    _Alignas(CACHE_LINE_SIZE) void *remote_frees; // Written by other threads, so kept off the lock's cache line.
+};
+
+static SDL_AtomicInt g_heap_thread_count;
+static THREAD_LOCAL int32_t t_heap_thread_index = -1;
+
+typedef struct heap_walk_t heap_walk_t;
+struct heap_walk_t
+{
+    size_t allocated_bytes;
+    size_t total_bytes;
+    int32_t allocation_count;
+};
+
+static void heap_pool_walker(void *mem, size_t size, int used, void *user)
+{
+    if (!used) {
+        return;
+    }
+
+    heap_walk_t *walk = (heap_walk_t *)user;
+    walk->allocated_bytes += size;
+    ++walk->allocation_count;
+
+    log_warn(LOG_CATEGORY_MEMORY, "Found active allocation. Address %p, size %llu.", mem, size);
+}
+
+static heap_shard_t *heap_home_shard(heap_allocator_t *a)
+{
+    if (t_heap_thread_index < 0) {
+        t_heap_thread_index = SDL_AddAtomicInt(&g_heap_thread_count, 1);
+    }
+
+    return &a->shards[t_heap_thread_index % a->shard_count];
+}
+
+static heap_shard_t *heap_owner_shard(heap_allocator_t *a, void *mem)
+{
+    size_t index = ((uint8_t *)mem - a->shard_base) / a->shard_span;
+    assert(index < (size_t)a->shard_count && "Pointer not owned by heap");
+    return &a->shards[index];
+}
+
+static heap_pool_t *heap_shard_find_pool(heap_shard_t *shard, void *mem)
+{
+    uint8_t *ptr = (uint8_t *)mem;
+    for (int32_t i = 0; i < shard->pool_count; ++i) {
+        heap_pool_t *pool = &shard->pools[i];
+        if (pool->pool != NULL && ptr >= pool->base && ptr < pool->base + pool->size) {
+            return pool;
+        }
+    }
+
+    assert(false && "Pointer not owned by any pool");
+    return NULL;
+}
+
+static void *heap_tlsf_alloc(void *tlsf, size_t size, size_t align)
+{
+    return align <= tlsf_align_size() ? tlsf_malloc(tlsf, size) : tlsf_memalign(tlsf, align, size);
+}
+
+// Must be called with the shard lock held.
+static bool heap_shard_grow(heap_shard_t *shard, size_t size, size_t align)
+{
+    // TLSF rounds large requests up to the next second level size class, which is 1/32 of the request's power of two,
+    // so the new pool has to cover that rounding or the retry will not find a block.
+    size_t required = size + size / 32 + align + tlsf_pool_overhead() + tlsf_alloc_overhead() + tlsf_block_size_min();
+    required = required < shard->pool_size ? shard->pool_size : memory_align(required, shard->commit_granularity);
+    if (required > tlsf_block_size_max()) {
+        return false;
+    }
+
+    // Prefer recommitting the smallest released range that fits over extending into fresh address space.
+    heap_pool_t *slot = NULL;
+    for (int32_t i = 0; i < shard->pool_count; ++i) {
+        heap_pool_t *pool = &shard->pools[i];
+        if (pool->pool == NULL && pool->size >= required && (slot == NULL || pool->size < slot->size)) {
+            slot = pool;
+        }
+    }
+
+    if (slot == NULL) {
+        if (shard->pool_count == HEAP_MAX_POOLS || required > (size_t)(shard->end - shard->commit_end)) {
+            return false;
+        }
+
+        slot = &shard->pools[shard->pool_count++];
+        slot->base = shard->commit_end;
+        slot->size = required;
+        slot->pool = NULL;
+        shard->commit_end += required;
+    }
+
+    if (!vm_commit(slot->base, slot->size)) {
+        return false;
+    }
+
+    slot->pool = tlsf_add_pool(shard->tlsf, slot->base, slot->size);
+    slot->live_count = 0;
+    if (slot->pool == NULL) {
+        vm_decommit(slot->base, slot->size);
+        return false;
+    }
+
+    shard->committed_size += slot->size;
+    return true;
+}
+
+// Must be called with the shard lock held.
+static void heap_shard_release_pool(heap_shard_t *shard, heap_pool_t *pool)
+{
+    tlsf_remove_pool(shard->tlsf, pool->pool);
+    vm_decommit(pool->base, pool->size);
+    pool->pool = NULL;
+    shard->committed_size -= pool->size;
+
+    // Hand the address range back to the bump region when it is the last one, so holes do not pile up at the end.
+    while (shard->pool_count > 0) {
+        heap_pool_t *last = &shard->pools[shard->pool_count - 1];
+        if (last->pool != NULL || last->base + last->size != shard->commit_end) {
+            break;
+        }
+
+        shard->commit_end = last->base;
+        --shard->pool_count;
+    }
+}
+
+// Must be called with the shard lock held.
+static void heap_shard_track_alloc(heap_shard_t *shard, void *mem)
+{
+    heap_pool_t *pool = heap_shard_find_pool(shard, mem);
+    if (pool->live_count++ == 0 && shard->empty_pool == (int32_t)(pool - shard->pools)) {
+        shard->empty_pool = -1;
+    }
+}
+
+// Must be called with the shard lock held.
+static void heap_shard_track_free(heap_shard_t *shard, heap_pool_t *pool)
+{
+    assert(pool->live_count > 0);
+    if (--pool->live_count > 0) {
+        return;
+    }
+
+    if (shard->empty_pool < 0) {
+        shard->empty_pool = (int32_t)(pool - shard->pools);
+    } else {
+        heap_shard_release_pool(shard, pool);
+    }
+}
+
+// Must be called with the shard lock held.
+static void heap_shard_free(heap_shard_t *shard, void *mem)
+{
+    heap_pool_t *pool = heap_shard_find_pool(shard, mem);
+
+    tlsf_free(shard->tlsf, mem);
+
+    heap_shard_track_free(shard, pool);
+}
+
+static void heap_shard_push_remote_free(heap_shard_t *shard, void *mem)
+{
+    // The freed block is at least tlsf_block_size_min() bytes, so it can hold the list link itself.
+    void **node = (void **)mem;
+    void *head;
+    do {
+        head = SDL_GetAtomicPointer(&shard->remote_frees);
+        *node = head;
+    } while (!SDL_CompareAndSwapAtomicPointer(&shard->remote_frees, head, mem));
+}
+
+// Must be called with the shard lock held.
+static void heap_shard_drain_remote_frees(heap_shard_t *shard)
+{
+    if (SDL_GetAtomicPointer(&shard->remote_frees) == NULL) {
+        return;
+    }
+
+    void *node = SDL_SetAtomicPointer(&shard->remote_frees, NULL);
+    while (node != NULL) {
+        void *next = *(void **)node;
+        heap_shard_free(shard, node);
+        node = next;
+    }
+}
+
+// Must be called with the shard lock held.
+static void *heap_shard_alloc(heap_shard_t *shard, size_t size, size_t align)
+{
+    heap_shard_drain_remote_frees(shard);
+
+    void *mem = heap_tlsf_alloc(shard->tlsf, size, align);
+    if (mem == NULL && heap_shard_grow(shard, size, align)) {
+        mem = heap_tlsf_alloc(shard->tlsf, size, align);
+    }
+
+    if (mem == NULL) {
+        return NULL;
+    }
+
+    heap_shard_track_alloc(shard, mem);
+    return mem;
+}
+
+bool heap_init(heap_allocator_t *a, size_t reserve_size, size_t pool_size, int32_t shard_count, bool huge_pages)
+{
+    assert(shard_count > 0 && shard_count <= HEAP_MAX_SHARDS);
+
+    const size_t page_size = vm_page_size();
+
+    a->backing = VM_BACKING_SMALL_PAGES;
+    if (huge_pages) {
+        reserve_size = memory_align(reserve_size, VM_HUGE_PAGE_SIZE);
+        a->mem = vm_reserve_huge(reserve_size, &a->backing);
+    } else {
+        a->mem = vm_reserve(reserve_size);
+    }
+
+    if (a->mem == NULL) {
+        log_error(LOG_CATEGORY_MEMORY, "Failed to reserve %llu bytes for heap allocator.", reserve_size);
+        return false;
+    }
+
+    a->reserve_size = reserve_size;
+    a->shard_count = shard_count;
+
+    // The shard headers live in the first pages of the reservation, followed by one equal span per shard. Each span
+    // starts with the shard's TLSF control structure and grows pools upwards from there. With huge pages every pool
+    // starts on a huge page boundary and is a whole number of huge pages; the gaps are reserved but never committed.
+    const size_t granularity = a->backing == VM_BACKING_TRANSPARENT_HUGE_PAGES ? VM_HUGE_PAGE_SIZE : page_size;
+    const size_t header_size = memory_align(sizeof(heap_shard_t) * shard_count, page_size);
+    const size_t control_size = memory_align(tlsf_size(), page_size);
+
+    a->shards = (heap_shard_t *)a->mem;
+    a->shard_base = (uint8_t *)a->mem + memory_align(header_size, granularity);
+    a->shard_span = ((reserve_size - (a->shard_base - (uint8_t *)a->mem)) / shard_count) & ~(granularity - 1);
+    assert(a->shard_span > memory_align(control_size, granularity) + pool_size);
+
+    if (!vm_commit(a->mem, header_size)) {
+        log_error(LOG_CATEGORY_MEMORY, "Failed to commit heap allocator header.");
+        vm_release(a->mem, a->reserve_size);
+        return false;
+    }
+
+    for (int32_t i = 0; i < shard_count; ++i) {
+        heap_shard_t *shard = &a->shards[i];
+        SDL_zerop(shard);
+
+        uint8_t *begin = a->shard_base + a->shard_span * i;
+        if (!vm_commit(begin, control_size)) {
+            log_error(LOG_CATEGORY_MEMORY, "Failed to commit heap allocator shard.");
+            vm_release(a->mem, a->reserve_size);
+            return false;
+        }
+
+        shard->tlsf = tlsf_create(begin);
+        shard->commit_end = begin + memory_align(control_size, granularity);
+        shard->end = begin + a->shard_span;
+        shard->pool_size = memory_align(pool_size, granularity);
+        shard->commit_granularity = granularity;
+        shard->committed_size = control_size;
+        shard->empty_pool = -1;
+    }
+
+#if FEATURE_MEMORY_STATS
+    memory_counters_reset(&a->counters);
+#endif
+
+    log_info(LOG_CATEGORY_MEMORY, "Heap allocator initialised with %llu bytes reserved across %d shards, backed by %s.", reserve_size, shard_count, vm_backing_name(a->backing));
+
+    return true;
+}
+
+void heap_deinit(heap_allocator_t *a)
+{
+    heap_walk_t walk = { .allocated_bytes = 0, .total_bytes = heap_committed_size(a), .allocation_count = 0 };
+    for (int32_t i = 0; i < a->shard_count; ++i) {
+        heap_shard_t *shard = &a->shards[i];
+        SDL_LockSpinlock(&shard->lock);
+        heap_shard_drain_remote_frees(shard);
+        for (int32_t p = 0; p < shard->pool_count; ++p) {
+            if (shard->pools[p].pool != NULL) {
+                tlsf_walk_pool(shard->pools[p].pool, heap_pool_walker, (void *)&walk);
+            }
+        }
+        SDL_UnlockSpinlock(&shard->lock);
+    }
+
+    if (walk.allocated_bytes) {
+        log_warn(LOG_CATEGORY_MEMORY, "Heap allocator deinitialised. Allocated memory detected. Size %llu, allocated %llu in %d blocks.", walk.total_bytes, walk.allocated_bytes, walk.allocation_count);
+    } else {
+        log_info(LOG_CATEGORY_MEMORY, "Heap allocator deinitialised. All memory free.");
+    }
+
+    // todo: assert that all memory is freed?
+
+    for (int32_t i = 0; i < a->shard_count; ++i) {
+        tlsf_destroy(a->shards[i].tlsf);
+    }
+
+#if FEATURE_MEMORY_STATS
+    mem_stats_unregister(&a->counters);
+#endif
+
+    vm_release(a->mem, a->reserve_size);
+    a->mem = NULL;
+    a->shards = NULL;
+}
+
+static void *heap_alloc_block(heap_allocator_t *a, size_t size, size_t align)
+{
+    heap_shard_t *home = heap_home_shard(a);
+
+    SDL_LockSpinlock(&home->lock);
+    void *mem = heap_shard_alloc(home, size, align);
+    SDL_UnlockSpinlock(&home->lock);
+
+    // The home shard has run out of address space, so borrow from the others.
+    for (int32_t i = 0; mem == NULL && i < a->shard_count; ++i) {
+        heap_shard_t *shard = &a->shards[i];
+        if (shard == home) {
+            continue;
+        }
+
+        SDL_LockSpinlock(&shard->lock);
+        mem = heap_shard_alloc(shard, size, align);
+        SDL_UnlockSpinlock(&shard->lock);
+    }
+
+    return mem;
+}
+
+static void heap_dealloc_block(heap_allocator_t *a, void *mem);
+
+static void *heap_realloc_block(heap_allocator_t *a, void *mem, size_t size, size_t align)
+{
+    void *new_mem = NULL;
+
+    // tlsf_realloc only keeps the default alignment when it has to move a block, so over-aligned blocks are moved
+    // here instead.
+    if (align <= tlsf_align_size()) {
+        heap_shard_t *shard = heap_owner_shard(a, mem);
+
+        SDL_LockSpinlock(&shard->lock);
+        heap_pool_t *pool = heap_shard_find_pool(shard, mem);
+
+        new_mem = tlsf_realloc(shard->tlsf, mem, size);
+
+        if (new_mem != NULL && new_mem != mem) {
+            heap_shard_track_alloc(shard, new_mem);
+            heap_shard_track_free(shard, pool);
+        }
+        SDL_UnlockSpinlock(&shard->lock);
+    } else if (size <= tlsf_block_size(mem)) {
+        return mem;
+    }
+
+    // The owning shard is full, so move the block to whichever shard has or can commit room.
+    if (new_mem == NULL) {
+        new_mem = heap_alloc_block(a, size, align);
+        if (new_mem != NULL) {
+            size_t original_size = tlsf_block_size(mem);
+            memcpy(new_mem, mem, original_size < size ? original_size : size);
+            heap_dealloc_block(a, mem);
+        }
+    }
+
+    return new_mem;
+}
+
+static void heap_dealloc_block(heap_allocator_t *a, void *mem)
+{
+    // Only the home shard is freed into directly; touching another shard's TLSF structures would pull its cache
+    // lines away from the threads allocating there.
+    heap_shard_t *shard = heap_owner_shard(a, mem);
+    if (shard == heap_home_shard(a) && SDL_TryLockSpinlock(&shard->lock)) {
+        heap_shard_free(shard, mem);
+        SDL_UnlockSpinlock(&shard->lock);
+    } else {
+        heap_shard_push_remote_free(shard, mem);
+    }
+}
+
+#if FEATURE_MEMORY_STATS
+// Stats builds put a small header in front of every heap allocation so that frees can be attributed to the tag,
+// callsite and size they were allocated with. Over-aligned allocations pad the header out to the alignment.
+typedef struct heap_stats_header_t heap_stats_header_t;
+struct heap_stats_header_t
+{
+    uint64_t size;
+    uint16_t tag;
+    uint16_t callsite;
+    uint32_t offset;
+};
+
+static size_t heap_stats_offset(size_t align)
+{
+    return align <= sizeof(heap_stats_header_t) ? sizeof(heap_stats_header_t) : align;
+}
+
+static void *heap_stats_track_alloc(heap_allocator_t *a, uint8_t *block, size_t size, size_t offset, memory_tag_t tag, uint16_t callsite)
+{
+    uint8_t *mem = block + offset;
+    heap_stats_header_t *header = (heap_stats_header_t *)mem - 1;
+    header->size = size;
+    header->tag = (uint16_t)tag;
+    header->callsite = callsite;
+    header->offset = (uint32_t)offset;
+
+    memory_counters_alloc(&a->counters, size);
+    memory_counters_alloc(&g_memory_tag_counters[tag], size);
+#if FEATURE_MEMORY_CALLSITES
+    memory_callsite_alloc(callsite, size);
+#endif
+    return mem;
+}
+
+static void heap_stats_track_free(heap_allocator_t *a, heap_stats_header_t *header)
+{
+    memory_counters_free(&a->counters, header->size);
+    memory_counters_free(&g_memory_tag_counters[header->tag], header->size);
+#if FEATURE_MEMORY_CALLSITES
+    memory_callsite_free(header->callsite, header->size);
+#endif
+}
+
+static void *heap_alloc_tracked(heap_allocator_t *a, size_t size, size_t align, uint16_t callsite)
+{
+    const size_t offset = heap_stats_offset(align);
+    uint8_t *block = heap_alloc_block(a, size + offset, align);
+    if (block == NULL) {
+        return NULL;
+    }
+
+    return heap_stats_track_alloc(a, block, size, offset, t_memory_tag, callsite);
+}
+
+// A callsite of 0 keeps the one the block was allocated from.
+static void *heap_realloc_tracked(heap_allocator_t *a, void *mem, size_t size, size_t align, uint16_t callsite)
+{
+    if (mem == NULL) {
+        return heap_alloc_tracked(a, size, align, callsite);
+    }
+
+    if (size == 0) {
+        heap_dealloc(a, mem);
+        return NULL;
+    }
+
+    heap_stats_header_t header = *((heap_stats_header_t *)mem - 1);
+    uint8_t *block = (uint8_t *)mem - header.offset;
+
+    // The header travels with the block contents, so it only needs refreshing.
+    uint8_t *new_block = heap_realloc_block(a, block, size + header.offset, align);
+    if (new_block == NULL) {
+        return NULL;
+    }
+
+    heap_stats_track_free(a, &header);
+    return heap_stats_track_alloc(a, new_block, size, header.offset, (memory_tag_t)header.tag, callsite != 0 ? callsite : header.callsite);
+}
+
+// The parentheses keep the FEATURE_MEMORY_CALLSITES macros from expanding the definitions.
+void *(heap_alloc)(heap_allocator_t *a, size_t size, size_t align)
+{
+    return heap_alloc_tracked(a, size, align, 0);
+}
+
+void *(heap_realloc)(heap_allocator_t *a, void *mem, size_t size, size_t align)
+{
+    return heap_realloc_tracked(a, mem, size, align, 0);
+}
+
+void heap_dealloc(heap_allocator_t *a, void *mem)
+{
+    if (mem == NULL) {
+        return;
+    }
+
+    heap_stats_header_t *header = (heap_stats_header_t *)mem - 1;
+    heap_stats_track_free(a, header);
+    heap_dealloc_block(a, (uint8_t *)mem - header->offset);
+}
+#else
+void *heap_alloc(heap_allocator_t *a, size_t size, size_t align)
+{
+    return heap_alloc_block(a, size, align);
+}
+
+void *heap_realloc(heap_allocator_t *a, void *mem, size_t size, size_t align)
+{
+    if (mem == NULL) {
+        return heap_alloc_block(a, size, align);
+    }
+
+    if (size == 0) {
+        heap_dealloc_block(a, mem);
+        return NULL;
+    }
+
+    return heap_realloc_block(a, mem, size, align);
+}
+
+void heap_dealloc(heap_allocator_t *a, void *mem)
+{
+    if (mem != NULL) {
+        heap_dealloc_block(a, mem);
+    }
+}
+#endif
+
+void *(heap_calloc)(heap_allocator_t *a, size_t count, size_t size, size_t align)
+{
+    size_t req;
+    if (!SDL_size_mul_check_overflow(count, size, &req)) {
+        return NULL;
+    }
+
+    void *mem = (heap_alloc)(a, req, align);
+    if (mem != NULL) {
+        memset(mem, 0, req);
+    }
+    return mem;
+}
+
+#if FEATURE_MEMORY_CALLSITES
+void *heap_alloc_at(heap_allocator_t *a, size_t size, size_t align, const char *file, int32_t line)
+{
+    return heap_alloc_tracked(a, size, align, memory_callsite_index(file, line));
+}
+
+void *heap_calloc_at(heap_allocator_t *a, size_t count, size_t size, size_t align, const char *file, int32_t line)
+{
+    size_t req;
+    if (!SDL_size_mul_check_overflow(count, size, &req)) {
+        return NULL;
+    }
+
+    void *mem = heap_alloc_tracked(a, req, align, memory_callsite_index(file, line));
+    if (mem != NULL) {
+        memset(mem, 0, req);
+    }
+    return mem;
+}
+
+void *heap_realloc_at(heap_allocator_t *a, void *mem, size_t size, size_t align, const char *file, int32_t line)
+{
+    return heap_realloc_tracked(a, mem, size, align, memory_callsite_index(file, line));
+}
+#endif
+
+size_t heap_committed_size(heap_allocator_t *a)
+{
+    size_t committed_size = memory_align(sizeof(heap_shard_t) * a->shard_count, vm_page_size());
+    for (int32_t i = 0; i < a->shard_count; ++i) {
+        heap_shard_t *shard = &a->shards[i];
+        SDL_LockSpinlock(&shard->lock);
+        committed_size += shard->committed_size;
+        SDL_UnlockSpinlock(&shard->lock);
+    }
+    return committed_size;
+}
+
+static void heap_usage_walker(void *mem, size_t size, int used, void *user)
+{
+    (void)mem;
+
+    heap_usage_t *usage = (heap_usage_t *)user;
+    if (used) {
+        usage->used_size += size;
+        ++usage->used_count;
+    } else {
+        usage->free_size += size;
+        ++usage->free_count;
+        if (size > usage->largest_free_size) {
+            usage->largest_free_size = size;
+        }
+    }
+}
+
+void heap_usage(heap_allocator_t *a, heap_usage_t *usage)
+{
+    SDL_zerop(usage);
+    usage->committed_size = heap_committed_size(a);
+
+    for (int32_t i = 0; i < a->shard_count; ++i) {
+        heap_shard_t *shard = &a->shards[i];
+        SDL_LockSpinlock(&shard->lock);
+        heap_shard_drain_remote_frees(shard);
+        for (int32_t p = 0; p < shard->pool_count; ++p) {
+            if (shard->pools[p].pool != NULL) {
+                tlsf_walk_pool(shard->pools[p].pool, heap_usage_walker, (void *)usage);
+            }
+        }
+        SDL_UnlockSpinlock(&shard->lock);
+    }
+}
+
+// O--------------------------------------------------------------------------O
+// | Virtual Arenas                                                           |
+// O--------------------------------------------------------------------------O
+
+// Linear and stack allocators created with *_init_virtual commit in steps of this size, so a growing arena does not
+// make a system call for every page it touches. Huge page backed arenas commit whole huge pages instead.
+#define ARENA_COMMIT_GRANULARITY KB(64)
+
+static void *arena_reserve(size_t *reserve_size, bool huge_pages, size_t *commit_granularity, vm_backing_t *backing)
+{
+    *backing = VM_BACKING_SMALL_PAGES;
+
+    void *mem;
+    if (huge_pages) {
+        *reserve_size = memory_align(*reserve_size, VM_HUGE_PAGE_SIZE);
+        mem = vm_reserve_huge(*reserve_size, backing);
+    } else {
+        *reserve_size = memory_align(*reserve_size, ARENA_COMMIT_GRANULARITY);
+        mem = vm_reserve(*reserve_size);
+    }
+
+    *commit_granularity = *backing == VM_BACKING_TRANSPARENT_HUGE_PAGES ? VM_HUGE_PAGE_SIZE : ARENA_COMMIT_GRANULARITY;
+    return mem;
+}
+
+static bool arena_grow(void *mem, size_t *committed_size, size_t total_size, size_t required_size, size_t commit_granularity)
+{
+    size_t new_committed_size = memory_align(required_size, commit_granularity);
+    if (new_committed_size > total_size) {
+        new_committed_size = total_size;
+    }
+
+    if (!vm_commit((uint8_t *)mem + *committed_size, new_committed_size - *committed_size)) {
+        log_error(LOG_CATEGORY_MEMORY, "Failed to commit arena memory. Committed %llu, required %llu.", *committed_size, required_size);
+        return false;
+    }
+
+    *committed_size = new_committed_size;
+    return true;
+}
+
+static void arena_trim(void *mem, size_t *committed_size, size_t retain_size, size_t commit_granularity)
+{
+    const size_t keep_size = memory_align(retain_size, commit_granularity);
+    if (*committed_size > keep_size) {
+        vm_decommit((uint8_t *)mem + keep_size, *committed_size - keep_size);
+        *committed_size = keep_size;
+    }
+}
+
+// O--------------------------------------------------------------------------O
+// | Linear Allocator                                                         |
+// O--------------------------------------------------------------------------O
+
+void linear_init(linear_allocator_t *a, size_t size, void *mem)
+{
+    a->mem = mem;
+    a->total_size = size;
+    a->allocated_size = 0;
+    a->committed_size = size;
+    a->retain_size = size;
+    a->commit_granularity = 0;
+    a->backing = VM_BACKING_SMALL_PAGES;
+    a->is_virtual = false;
+#if FEATURE_MEMORY_STATS
+    memory_counters_reset(&a->counters);
+#endif
+
+    log_info(LOG_CATEGORY_MEMORY, "Linear allocator initialised with size %llu bytes.", size);
+}
+
+bool linear_init_virtual(linear_allocator_t *a, size_t reserve_size, size_t retain_size, bool huge_pages)
+{
+    void *mem = arena_reserve(&reserve_size, huge_pages, &a->commit_granularity, &a->backing);
+    if (mem == NULL) {
+        log_error(LOG_CATEGORY_MEMORY, "Failed to reserve %llu bytes for linear allocator.", reserve_size);
+        return false;
+    }
+
+    a->mem = mem;
+    a->total_size = reserve_size;
+    a->allocated_size = 0;
+    a->committed_size = 0;
+    a->retain_size = retain_size;
+    a->is_virtual = true;
+#if FEATURE_MEMORY_STATS
+    memory_counters_reset(&a->counters);
+#endif
+
+    log_info(LOG_CATEGORY_MEMORY, "Linear allocator initialised with %llu bytes reserved, retaining %llu bytes, backed by %s.", reserve_size, retain_size, vm_backing_name(a->backing));
+    return true;
+}
+
+void *linear_deinit(linear_allocator_t *a)
+{
+    if (a->allocated_size != 0) {
+        log_warn(LOG_CATEGORY_MEMORY, "Linear allocator deinitialised. Allocated memory detected. Size %llu, allocated %llu.", a->total_size, a->allocated_size);
+    } else {
+        log_info(LOG_CATEGORY_MEMORY, "Linear allocator deinitialised. All memory free.");
+    }
+
+    linear_reset(a);
+#if FEATURE_MEMORY_STATS
+    mem_stats_unregister(&a->counters);
+#endif
+
+    if (a->is_virtual) {
+        vm_release(a->mem, a->total_size);
+        a->mem = NULL;
+        a->committed_size = 0;
+    }
+    return a->mem;
+}
+
+void *(linear_alloc)(linear_allocator_t *a, size_t size, size_t align)
+{
+    assert(size > 0);
+
+    size_t offset = memory_align(a->allocated_size, align);
+    assert(offset < a->total_size);
+
+    size_t allocated_size = offset + size;
+    if (allocated_size > a->total_size) {
+        assert(false && "Overflow");
+        return NULL;
+    }
+
+    if (allocated_size > a->committed_size && !arena_grow(a->mem, &a->committed_size, a->total_size, allocated_size, a->commit_granularity)) {
+        return NULL;
+    }
+
+    a->allocated_size = allocated_size;
+#if FEATURE_MEMORY_STATS
+    memory_counters_set_in_use(&a->counters, allocated_size);
+    memory_counters_count(&a->counters, size);
+#endif
+    return (uint8_t *)a->mem + offset;
+}
+
+#if FEATURE_MEMORY_CALLSITES
+void *linear_alloc_at(linear_allocator_t *a, size_t size, size_t align, const char *file, int32_t line)
+{
+    void *mem = (linear_alloc)(a, size, align);
+    if (mem != NULL) {
+        memory_callsite_count(memory_callsite_index(file, line), size);
+    }
+    return mem;
+}
+#endif
+
+void linear_reset(linear_allocator_t *a)
+{
+    a->allocated_size = 0;
+    if (a->is_virtual) {
+        arena_trim(a->mem, &a->committed_size, a->retain_size, a->commit_granularity);
+    }
+#if FEATURE_MEMORY_STATS
+    memory_counters_set_in_use(&a->counters, 0);
+#endif
+}
+
+// O--------------------------------------------------------------------------O
+// | Stack Allocator                                                          |
+// O--------------------------------------------------------------------------O
+
+void stack_init(stack_allocator_t *a, size_t size, void *mem)
+{
+    a->mem = mem;
+    a->total_size = size;
+    a->allocated_size = 0;
+    a->peak_size = 0;
+    a->committed_size = size;
+    a->retain_size = size;
+    a->commit_granularity = 0;
+    a->backing = VM_BACKING_SMALL_PAGES;
+    a->is_virtual = false;
+#if FEATURE_MEMORY_STATS
+    memory_counters_reset(&a->counters);
+#endif
+
+    log_info(LOG_CATEGORY_MEMORY, "Stack allocator initialised with size %llu bytes.", size);
+}
+
+bool stack_init_virtual(stack_allocator_t *a, size_t reserve_size, size_t retain_size, bool huge_pages)
+{
+    void *mem = arena_reserve(&reserve_size, huge_pages, &a->commit_granularity, &a->backing);
+    if (mem == NULL) {
+        log_error(LOG_CATEGORY_MEMORY, "Failed to reserve %llu bytes for stack allocator.", reserve_size);
+        return false;
+    }
+
+    a->mem = mem;
+    a->total_size = reserve_size;
+    a->allocated_size = 0;
+    a->peak_size = 0;
+    a->committed_size = 0;
+    a->retain_size = retain_size;
+    a->is_virtual = true;
+#if FEATURE_MEMORY_STATS
+    memory_counters_reset(&a->counters);
+#endif
+
+    log_info(LOG_CATEGORY_MEMORY, "Stack allocator initialised with %llu bytes reserved, retaining %llu bytes, backed by %s.", reserve_size, retain_size, vm_backing_name(a->backing));
+    return true;
+}
+
+void *stack_deinit(stack_allocator_t *a)
+{
+    if (a->allocated_size != 0) {
+        log_warn(LOG_CATEGORY_MEMORY, "Stack allocator deinitialised. Allocated memory detected. Size %llu, allocated %llu.", a->total_size, a->allocated_size);
+    } else {
+        log_info(LOG_CATEGORY_MEMORY, "Stack allocator deinitialised. All memory free.");
+    }
+
+    stack_reset(a);
+#if FEATURE_MEMORY_STATS
+    mem_stats_unregister(&a->counters);
+#endif
+
+    if (a->is_virtual) {
+        vm_release(a->mem, a->total_size);
+        a->mem = NULL;
+        a->committed_size = 0;
+    }
+    return a->mem;
+}
+
+void *(stack_alloc)(stack_allocator_t *a, size_t size, size_t align)
+{
+    if (a == NULL) {
+        return NULL;
+    }
+
+    size_t offset = memory_align(a->allocated_size, align);
+
+    size_t allocated_size = offset + size;
+    if (offset >= a->total_size || allocated_size > a->total_size) {
+        log_error(LOG_CATEGORY_MEMORY, "Stack allocator overflow. Requested %llu bytes with %llu of %llu in use, peak %llu.", size, a->allocated_size, a->total_size, a->peak_size);
+        assert(false && "Overflow");
+        return NULL;
+    }
+
+    if (allocated_size > a->committed_size && !arena_grow(a->mem, &a->committed_size, a->total_size, allocated_size, a->commit_granularity)) {
+        return NULL;
+    }
+
+    a->allocated_size = allocated_size;
+    if (allocated_size > a->peak_size) {
+        a->peak_size = allocated_size;
+    }
+#if FEATURE_MEMORY_STATS
+    memory_counters_set_in_use(&a->counters, allocated_size);
+    memory_counters_count(&a->counters, size);
+#endif
+    return (uint8_t *)a->mem + offset;
+}
+
+#if FEATURE_MEMORY_CALLSITES
+void *stack_alloc_at(stack_allocator_t *a, size_t size, size_t align, const char *file, int32_t line)
+{
+    void *mem = (stack_alloc)(a, size, align);
+    if (mem != NULL) {
+        memory_callsite_count(memory_callsite_index(file, line), size);
+    }
+    return mem;
+}
+#endif
+
+void stack_dealloc(stack_allocator_t *a, void *mem)
+{
+    uint8_t *ptr = (uint8_t *)mem;
+
+    assert(ptr >= (uint8_t *)a->mem);
+    assert(ptr < (uint8_t *)a->mem + a->total_size);
+    assert(ptr < (uint8_t *)a->mem + a->allocated_size);
+
+    size_t size = ptr - (uint8_t *)a->mem;
+    a->allocated_size = size;
+#if FEATURE_MEMORY_STATS
+    memory_counters_set_in_use(&a->counters, size);
+#endif
+}
+
+size_t stack_get_marker(stack_allocator_t *a)
+{
+    return a->allocated_size;
+}
+
+void stack_dealloc_marker(stack_allocator_t *a, size_t marker)
+{
+    assert(marker <= a->allocated_size && "Marker released out of order");
+
+    a->allocated_size = marker;
+#if FEATURE_MEMORY_STATS
+    memory_counters_set_in_use(&a->counters, marker);
+#endif
+}
+
+void stack_reset(stack_allocator_t *a)
+{
+    a->allocated_size = 0;
+    if (a->is_virtual) {
+        arena_trim(a->mem, &a->committed_size, a->retain_size, a->commit_granularity);
+    }
+#if FEATURE_MEMORY_STATS
+    memory_counters_set_in_use(&a->counters, 0);
+#endif
+}
+
+// O--------------------------------------------------------------------------O
+// | Pool Allocator                                                           |
+// O--------------------------------------------------------------------------O
+
+// Free blocks carry a tag next to their link so that deinit can tell live blocks from free ones when reporting leaks,
+// and so that double frees can be caught.
+typedef struct pool_free_block_t pool_free_block_t;
+struct pool_free_block_t
+{
+    pool_free_block_t *next;
+    uintptr_t tag;
+};
+
+typedef struct pool_slab_t pool_slab_t;
+struct pool_slab_t
+{
+    pool_slab_t *next;
+};
+
+static uintptr_t pool_free_tag(pool_allocator_t *a)
+{
+    return (uintptr_t)a ^ (uintptr_t)0xF4EEB10CF4EEB10CULL;
+}
+
+static size_t pool_slab_header_size(pool_allocator_t *a)
+{
+    return memory_align(sizeof(pool_slab_t), a->block_align);
+}
+
+static void pool_setup(pool_allocator_t *a, size_t block_size, size_t block_align)
+{
+    assert(block_align > 0 && (block_align & (block_align - 1)) == 0);
+
+    if (block_align < sizeof(void *)) {
+        block_align = sizeof(void *);
+    }
+    if (block_size < sizeof(pool_free_block_t)) {
+        block_size = sizeof(pool_free_block_t);
+    }
+
+    a->block_size = memory_align(block_size, block_align);
+    a->block_align = block_align;
+    a->free_list = NULL;
+    a->allocated_count = 0;
+#if FEATURE_MEMORY_STATS
+    memory_counters_reset(&a->counters);
+#endif
+}
+
+static bool pool_add_slab(pool_allocator_t *a)
+{
+    pool_slab_t *slab = heap_alloc(a->parent, a->slab_size, a->block_align);
+    if (slab == NULL) {
+        return false;
+    }
+
+    slab->next = (pool_slab_t *)a->slabs;
+    a->slabs = slab;
+    a->bump = (uint8_t *)slab + pool_slab_header_size(a);
+    a->bump_end = (uint8_t *)slab + a->slab_size;
+    a->total_size += a->slab_size;
+    return true;
+}
+
+static void pool_report_region(pool_allocator_t *a, uint8_t *begin, uint8_t *end)
+{
+    const uintptr_t tag = pool_free_tag(a);
+    for (uint8_t *block = begin; block + a->block_size <= end; block += a->block_size) {
+        if (((pool_free_block_t *)block)->tag != tag) {
+            log_warn(LOG_CATEGORY_MEMORY, "Found active allocation. Address %p, size %llu.", block, a->block_size);
+        }
+    }
+}
+
+void pool_init(pool_allocator_t *a, size_t block_size, size_t block_align, size_t size, void *mem)
+{
+    pool_setup(a, block_size, block_align);
+
+    a->mem = mem;
+    a->total_size = size;
+    a->parent = NULL;
+    a->slab_size = 0;
+    a->slabs = NULL;
+    a->bump = (uint8_t *)memory_align((uintptr_t)mem, a->block_align);
+    a->bump_end = (uint8_t *)mem + size;
+
+    log_info(LOG_CATEGORY_MEMORY, "Pool allocator initialised with size %llu bytes, block size %llu bytes.", size, a->block_size);
+}
+
+void pool_init_growable(pool_allocator_t *a, size_t block_size, size_t block_align, size_t slab_size, heap_allocator_t *parent)
+{
+    pool_setup(a, block_size, block_align);
+
+    a->mem = NULL;
+    a->total_size = 0;
+    a->parent = parent;
+    a->slab_size = slab_size;
+    a->slabs = NULL;
+    a->bump = NULL;
+    a->bump_end = NULL;
+
+    assert(slab_size >= pool_slab_header_size(a) + a->block_size);
+
+    log_info(LOG_CATEGORY_MEMORY, "Pool allocator initialised with slab size %llu bytes, block size %llu bytes.", slab_size, a->block_size);
+}
+
+void *pool_deinit(pool_allocator_t *a)
+{
+    if (a->allocated_count != 0) {
+        log_warn(LOG_CATEGORY_MEMORY, "Pool allocator deinitialised. Allocated memory detected. Size %llu, allocated %llu blocks of %llu bytes.", a->total_size, a->allocated_count, a->block_size);
+
+        if (a->parent == NULL) {
+            uint8_t *begin = (uint8_t *)memory_align((uintptr_t)a->mem, a->block_align);
+            pool_report_region(a, begin, a->bump);
+        } else {
+            // Only the newest slab is partially carved.
+            for (pool_slab_t *slab = a->slabs; slab != NULL; slab = slab->next) {
+                uint8_t *begin = (uint8_t *)slab + pool_slab_header_size(a);
+                uint8_t *end = slab == a->slabs ? a->bump : (uint8_t *)slab + a->slab_size;
+                pool_report_region(a, begin, end);
+            }
+        }
+    } else {
+        log_info(LOG_CATEGORY_MEMORY, "Pool allocator deinitialised. All memory free.");
+    }
+
+    pool_reset(a);
+#if FEATURE_MEMORY_STATS
+    mem_stats_unregister(&a->counters);
+#endif
+    return a->mem;
+}
+
+void *pool_alloc(pool_allocator_t *a)
+{
+    pool_free_block_t *block = (pool_free_block_t *)a->free_list;
+    if (block != NULL) {
+        a->free_list = block->next;
+        block->tag = 0;
+        ++a->allocated_count;
+#if FEATURE_MEMORY_STATS
+        memory_counters_alloc(&a->counters, a->block_size);
+#endif
+        return block;
+    }
+
+    // Blocks are carved from the current region lazily so that untouched pages are never written.
+    if (a->bump == NULL || a->bump + a->block_size > a->bump_end) {
+        if (a->parent == NULL) {
+            assert(false && "Overflow");
+            return NULL;
+        }
+
+        if (!pool_add_slab(a)) {
+            return NULL;
+        }
+    }
+
+    // The region may hold stale data from a previous user, so make sure the block does not look free.
+    pool_free_block_t *carved = (pool_free_block_t *)a->bump;
+    carved->tag = 0;
+    a->bump += a->block_size;
+    ++a->allocated_count;
+#if FEATURE_MEMORY_STATS
+    memory_counters_alloc(&a->counters, a->block_size);
+#endif
+    return carved;
+}
+
+void pool_dealloc(pool_allocator_t *a, void *mem)
+{
+    if (mem == NULL) {
+        return;
+    }
+
+    pool_free_block_t *block = (pool_free_block_t *)mem;
+    assert(block->tag != pool_free_tag(a) && "Double free");
+    assert(a->allocated_count > 0);
+
+    block->next = (pool_free_block_t *)a->free_list;
+    block->tag = pool_free_tag(a);
+    a->free_list = block;
+    --a->allocated_count;
+#if FEATURE_MEMORY_STATS
+    memory_counters_free(&a->counters, a->block_size);
+#endif
+}
+
+void pool_reset(pool_allocator_t *a)
 {
-    heap_allocator_t system;
-    stack_allocator_t scratch;
-};
+    a->free_list = NULL;
+    a->allocated_count = 0;
+#if FEATURE_MEMORY_STATS
+    memory_counters_set_in_use(&a->counters, 0);
+#endif
 
-static memory_system_t g_memory_system;
+    if (a->parent == NULL) {
+        a->bump = (uint8_t *)memory_align((uintptr_t)a->mem, a->block_align);
+        return;
+    }
 
-// O--------------------------------------------------------------------------O
-// | Forward Declarations                                                     |
-// O--------------------------------------------------------------------------O
+    pool_slab_t *slab = (pool_slab_t *)a->slabs;
+    while (slab != NULL) {
+        pool_slab_t *next = slab->next;
+        heap_dealloc(a->parent, slab);
+        slab = next;
+    }
 
-size_t memory_align(size_t size, size_t align);
+    a->slabs = NULL;
+    a->bump = NULL;
+    a->bump_end = NULL;
+    a->total_size = 0;
+}
 
 // O--------------------------------------------------------------------------O
-// | Memory Stats                                                             |
+// | Handle Heap                                                              |
 // O--------------------------------------------------------------------------O
 
-typedef struct memory_stats_t memory_stats_t;
-struct memory_stats_t
+#define HANDLE_HEAP_INDEX_BITS 20
+#define HANDLE_HEAP_INDEX_MASK (HANDLE_HEAP_MAX_HANDLES - 1)
+#define HANDLE_HEAP_GENERATION_MASK ((1u << (32 - HANDLE_HEAP_INDEX_BITS)) - 1)
+#define HANDLE_HEAP_NO_BLOCK SIZE_MAX
+#define HANDLE_HEAP_NO_ENTRY UINT32_MAX
+#define HANDLE_HEAP_FREE_BLOCK UINT32_MAX
+
+typedef struct handle_block_t handle_block_t;
+struct handle_block_t
 {
-    size_t allocated_bytes;
-    size_t total_bytes;
-    int32_t allocation_count;
+    _Alignas(HANDLE_HEAP_ALIGN) size_t size; // Including this header.
+    size_t prev_size;                        // Of the block right below, 0 for the first one.
+    uint32_t entry;                          // HANDLE_HEAP_FREE_BLOCK while free.
 };
 
-void memory_stats_add(memory_stats_t *stats, size_t size)
+// Free blocks keep their free list links where the payload would be, which sets the minimum block size.
+typedef struct handle_free_block_t handle_free_block_t;
+struct handle_free_block_t
 {
-    if (size) {
-        stats->allocated_bytes += size;
-        ++stats->allocation_count;
-    }
-}
+    handle_block_t header;
+    size_t prev;
+    size_t next;
+};
 
-// O--------------------------------------------------------------------------O
-// | Heap Allocator                                                           |
-// O--------------------------------------------------------------------------O
+struct handle_entry_t
+{
+    size_t offset; // Of the block while the handle is live, the next free entry while it is not.
+    uint32_t generation;
+    uint32_t pin_count;
+};
 
-static void heap_pool_walker(void *mem, size_t size, int used, void *user)
+static size_t handle_heap_entries_size(uint32_t max_handles)
 {
-    memory_stats_t *stats = (memory_stats_t *)user;
-    memory_stats_add(stats, used ? size : 0);
+    return memory_align(max_handles * sizeof(handle_entry_t), ARENA_COMMIT_GRANULARITY);
+}
 
-    if (used) {
-        log_warn(LOG_CATEGORY_MEMORY, "Found active allocation. Address %p, size %llu.", mem, size);
-    }
+static handle_block_t *handle_heap_block(handle_heap_t *h, size_t offset)
+{
+    return (handle_block_t *)(h->mem + offset);
 }
 
-void heap_init(heap_allocator_t *a, size_t size, void *mem)
+static handle_free_block_t *handle_heap_free_block(handle_heap_t *h, size_t offset)
 {
-    a->mem = mem;
-    a->total_size = size;
-    a->allocated_size = 0;
+    return (handle_free_block_t *)(h->mem + offset);
+}
 
-    a->tlsf = tlsf_create_with_pool(a->mem, a->total_size);
+static handle_entry_t *handle_heap_entry(handle_heap_t *h, mem_handle_t handle)
+{
+    const uint32_t index = handle & HANDLE_HEAP_INDEX_MASK;
+    assert(index < h->entry_count && h->entries[index].generation == handle >> HANDLE_HEAP_INDEX_BITS && "Stale or invalid handle");
+    return &h->entries[index];
+}
 
-    log_info(LOG_CATEGORY_MEMORY, "Heap allocator initialised with size %llu bytes.", size);
+// Writes a block's size and owner and keeps the boundary tag of the block above it in step.
+static void handle_heap_set_block(handle_heap_t *h, size_t offset, size_t size, uint32_t entry)
+{
+    handle_block_t *block = handle_heap_block(h, offset);
+    block->size = size;
+    block->entry = entry;
+    if (offset + size < h->top) {
+        handle_heap_block(h, offset + size)->prev_size = size;
+    } else {
+        h->last_size = size;
+    }
 }
 
-void *heap_deinit(heap_allocator_t *a)
+static void handle_heap_link_free(handle_heap_t *h, size_t offset, size_t size)
 {
-    memory_stats_t stats = { .allocated_bytes = 0, .total_bytes = a->total_size, .allocation_count = 0 };
-    pool_t pool = tlsf_get_pool(a->tlsf);
-    tlsf_walk_pool(pool, heap_pool_walker, (void *)&stats);
+    handle_heap_set_block(h, offset, size, HANDLE_HEAP_FREE_BLOCK);
+
+    handle_free_block_t *block = handle_heap_free_block(h, offset);
+    block->prev = HANDLE_HEAP_NO_BLOCK;
+    block->next = h->free_list;
+    if (h->free_list != HANDLE_HEAP_NO_BLOCK) {
+        handle_heap_free_block(h, h->free_list)->prev = offset;
+    }
+    h->free_list = offset;
+    h->free_size += size;
+    ++h->free_count;
+}
 
-    // todo: I don't think allocated_size is ever used and can probably be gotten rid of.
-    // todo: overhaul the MEMORY_STATS feature.
-    if (stats.allocated_bytes)  {
-        log_warn(LOG_CATEGORY_MEMORY, "Heap allocator deinitialised. Allocated memory detected. Size %llu, allocated %llu.", stats.total_bytes, stats.allocated_bytes);
+static void handle_heap_unlink_free(handle_heap_t *h, size_t offset)
+{
+    handle_free_block_t *block = handle_heap_free_block(h, offset);
+    if (block->prev != HANDLE_HEAP_NO_BLOCK) {
+        handle_heap_free_block(h, block->prev)->next = block->next;
     } else {
-        log_info(LOG_CATEGORY_MEMORY, "Heap allocator deinitialised. All memory free.");
+        h->free_list = block->next;
     }
+    if (block->next != HANDLE_HEAP_NO_BLOCK) {
+        handle_heap_free_block(h, block->next)->prev = block->prev;
+    }
+    h->free_size -= block->header.size;
+    --h->free_count;
+}
 
-    // todo: assert that all memory is freed?
+// Frees the block at offset, merging it with free neighbours, or hands it back to the bump range when nothing live
+// follows. Two free blocks are never next to each other and no free block ever touches the top.
+static void handle_heap_release_block(handle_heap_t *h, size_t offset, size_t size)
+{
+    const size_t next = offset + size;
+    if (next < h->top && handle_heap_block(h, next)->entry == HANDLE_HEAP_FREE_BLOCK) {
+        size += handle_heap_block(h, next)->size;
+        handle_heap_unlink_free(h, next);
+    }
 
-    tlsf_destroy(a->tlsf);
+    const size_t prev_size = handle_heap_block(h, offset)->prev_size;
+    if (prev_size > 0 && handle_heap_block(h, offset - prev_size)->entry == HANDLE_HEAP_FREE_BLOCK) {
+        offset -= prev_size;
+        size += prev_size;
+        handle_heap_unlink_free(h, offset);
+    }
 
-    return a->mem;
+    if (offset + size == h->top) {
+        h->top = offset;
+        h->last_size = handle_heap_block(h, offset)->prev_size;
+    } else {
+        handle_heap_link_free(h, offset, size);
+    }
 }
 
-void *heap_alloc(heap_allocator_t *a, size_t size, size_t align)
+// Takes the hole at offset for a block of size bytes and frees what is left above it. Takes the whole hole when the
+// remainder could not hold a free block. The caller writes the block itself.
+static void handle_heap_split_free(handle_heap_t *h, size_t offset, size_t *size)
 {
-#if FEATURE_MEMORY_STATS
-    void *mem = align == 1 ? tlsf_malloc(a->tlsf, size) : tlsf_memalign(a->tlsf, align, size);
-    size_t allocated_size = tlsf_block_size(mem);
-    a->allocated_size += allocated_size;
-    return mem;
-#else
-    void *mem = tlsf_malloc(a->tlsf, size);
-    return mem;
-#endif
+    const size_t hole_size = handle_heap_block(h, offset)->size;
+    handle_heap_unlink_free(h, offset);
+
+    if (hole_size - *size >= sizeof(handle_free_block_t)) {
+        handle_heap_block(h, offset + *size)->prev_size = *size;
+        handle_heap_link_free(h, offset + *size, hole_size - *size);
+    } else {
+        *size = hole_size;
+    }
 }
 
-void *heap_calloc(heap_allocator_t *a, size_t count, size_t size, size_t align)
+// First fit when allocating, lowest fit when compacting. Both are linear in the number of holes, which stays small
+// because handle heaps hold few, large blocks and neighbouring holes are always merged.
+static size_t handle_heap_find_free(handle_heap_t *h, size_t size, bool lowest)
 {
-    size_t req = count * size;
-#if FEATURE_MEMORY_STATS
-    void *mem = align == 1 ? tlsf_malloc(a->tlsf, req) : tlsf_memalign(a->tlsf, align, req);
-    size_t allocated_size = tlsf_block_size(mem);
-    a->allocated_size += allocated_size;
-    memset(mem, 0, allocated_size);
-    return mem;
-#else
-    void *mem = tlsf_malloc(a->tlsf, req);
-    memset(mem, 0, req);
-    return mem;
-#endif
+    size_t found = HANDLE_HEAP_NO_BLOCK;
+    for (size_t offset = h->free_list; offset != HANDLE_HEAP_NO_BLOCK; offset = handle_heap_free_block(h, offset)->next) {
+        if (handle_heap_block(h, offset)->size >= size && (found == HANDLE_HEAP_NO_BLOCK || offset < found)) {
+            found = offset;
+            if (!lowest) {
+                break;
+            }
+        }
+    }
+    return found;
 }
 
-void *heap_realloc(heap_allocator_t *a, void *mem, size_t size, size_t align)
+bool handle_heap_init(handle_heap_t *h, size_t reserve_size, size_t retain_size, uint32_t max_handles)
 {
-    // tlsf should have enough info in its header to handle alignment.
-    (void)align;
-
-#if FEATURE_MEMORY_STATS
-    size_t original_size = tlsf_block_size(mem);
+    assert(max_handles > 0 && max_handles <= HANDLE_HEAP_MAX_HANDLES);
 
-    void *new_mem = tlsf_realloc(a->tlsf, mem, size);
+    SDL_zerop(h);
+    h->total_size = memory_align(reserve_size, ARENA_COMMIT_GRANULARITY);
+    h->mem = (uint8_t *)vm_reserve(h->total_size);
+    if (h->mem == NULL) {
+        log_error(LOG_CATEGORY_MEMORY, "Failed to reserve %llu bytes for handle heap.", h->total_size);
+        return false;
+    }
 
-    if (new_mem && new_mem != mem) {
-        size_t allocated_size = tlsf_block_size(new_mem);
-        size_t diff = allocated_size - original_size;
-        a->allocated_size += diff;
+    h->entries = (handle_entry_t *)vm_reserve(handle_heap_entries_size(max_handles));
+    if (h->entries == NULL) {
+        log_error(LOG_CATEGORY_MEMORY, "Failed to reserve handle table for %u handles.", max_handles);
+        vm_release(h->mem, h->total_size);
+        h->mem = NULL;
+        return false;
     }
 
-    return new_mem;
-#else
-    void *new_mem = tlsf_realloc(a->tlsf, mem, size);
-    return new_mem;
+    h->retain_size = retain_size;
+    h->max_handles = max_handles;
+    h->free_list = HANDLE_HEAP_NO_BLOCK;
+    h->free_entry = HANDLE_HEAP_NO_ENTRY;
+#if FEATURE_MEMORY_STATS
+    memory_counters_reset(&h->counters);
 #endif
+
+    log_info(LOG_CATEGORY_MEMORY, "Handle heap initialised with %llu bytes reserved, retaining %llu bytes, for up to %u handles.", h->total_size, retain_size, max_handles);
+    return true;
 }
 
-void heap_dealloc(heap_allocator_t *a, void *mem)
+void handle_heap_deinit(handle_heap_t *h)
 {
+    if (h->used_count != 0) {
+        log_warn(LOG_CATEGORY_MEMORY, "Handle heap deinitialised. Allocated memory detected. %d blocks, %llu bytes.", h->used_count, h->used_size);
+    } else {
+        log_info(LOG_CATEGORY_MEMORY, "Handle heap deinitialised. All memory free. Compaction moved %llu bytes.", h->moved_size);
+    }
+
 #if FEATURE_MEMORY_STATS
-    size_t allocated_size = tlsf_block_size(mem);
-    a->allocated_size -= allocated_size;
-    tlsf_free(a->tlsf, mem);
-#else
-    tlsf_free(a->tlsf, mem);
+    mem_stats_unregister(&h->counters);
 #endif
-}
-
-// O--------------------------------------------------------------------------O
-// | Linear Allocator                                                         |
-// O--------------------------------------------------------------------------O
-
-void linear_init(linear_allocator_t *a, size_t size, void *mem)
-{
-    a->mem = mem;
-    a->total_size = size;
-    a->allocated_size = 0;
 
-    log_info(LOG_CATEGORY_MEMORY, "Linear allocator initialised with size %llu bytes.", size);
+    vm_release(h->entries, handle_heap_entries_size(h->max_handles));
+    vm_release(h->mem, h->total_size);
+    h->entries = NULL;
+    h->mem = NULL;
 }
 
-void *linear_deinit(linear_allocator_t *a)
+mem_handle_t handle_heap_alloc(handle_heap_t *h, size_t size)
 {
-    if (a->allocated_size != 0) {
-        log_warn(LOG_CATEGORY_MEMORY, "Linear allocator deinitialised. Allocated memory detected. Size %llu, allocated %llu.", a->total_size, a->allocated_size);
-    } else {
-        log_info(LOG_CATEGORY_MEMORY, "Linear allocator deinitialised. All memory free.");
+    size_t block_size = memory_align(sizeof(handle_block_t) + size, HANDLE_HEAP_ALIGN);
+    if (block_size < sizeof(handle_free_block_t)) {
+        block_size = sizeof(handle_free_block_t);
     }
 
-    linear_reset(a);
-    return a->mem;
-}
+    // Make sure there is an entry before taking a block, so a full table does not leave a block behind.
+    uint32_t index = h->free_entry;
+    if (index == HANDLE_HEAP_NO_ENTRY) {
+        if (h->entry_count == h->max_handles) {
+            log_error(LOG_CATEGORY_MEMORY, "Handle heap is out of handles. All %u are in use.", h->max_handles);
+            return MEM_HANDLE_NULL;
+        }
 
-void *linear_alloc(linear_allocator_t *a, size_t size, size_t align)
-{
-    assert(size > 0);
+        const size_t required = (h->entry_count + 1) * sizeof(handle_entry_t);
+        if (required > h->entries_committed_size && !arena_grow(h->entries, &h->entries_committed_size, handle_heap_entries_size(h->max_handles), required, ARENA_COMMIT_GRANULARITY)) {
+            return MEM_HANDLE_NULL;
+        }
 
-    size_t offset = memory_align(a->allocated_size, align);
-    assert(offset < a->total_size);
+        index = h->entry_count;
+    }
 
-    size_t allocated_size = offset + size;
-    if (allocated_size > a->total_size) {
-        assert(false && "Overflow");
-        return NULL;
+    size_t offset = handle_heap_find_free(h, block_size, false);
+    if (offset != HANDLE_HEAP_NO_BLOCK) {
+        handle_heap_split_free(h, offset, &block_size);
+    } else {
+        if (block_size > h->total_size - h->top) {
+            log_error(LOG_CATEGORY_MEMORY, "Handle heap is out of memory. Requested %llu bytes, %llu of %llu in use.", size, h->used_size, h->total_size);
+            return MEM_HANDLE_NULL;
+        }
+
+        if (h->top + block_size > h->committed_size && !arena_grow(h->mem, &h->committed_size, h->total_size, h->top + block_size, ARENA_COMMIT_GRANULARITY)) {
+            return MEM_HANDLE_NULL;
+        }
+
+        offset = h->top;
+        handle_heap_block(h, offset)->prev_size = h->last_size;
+        h->top += block_size;
     }
 
-    a->allocated_size = allocated_size;
-    return (uint8_t *)a->mem + offset;
+    handle_entry_t *entry = &h->entries[index];
+    if (index == h->entry_count) {
+        ++h->entry_count;
+        entry->generation = 1;
+    } else {
+        h->free_entry = (uint32_t)entry->offset;
+    }
+    entry->offset = offset;
+    entry->pin_count = 0;
+
+    handle_heap_set_block(h, offset, block_size, index);
+
+    h->used_size += block_size;
+    ++h->used_count;
+#if FEATURE_MEMORY_STATS
+    memory_counters_count(&h->counters, block_size);
+    memory_counters_set_in_use(&h->counters, h->used_size);
+#endif
+
+    return (entry->generation << HANDLE_HEAP_INDEX_BITS) | index;
 }
 
-void linear_reset(linear_allocator_t *a)
+void handle_heap_dealloc(handle_heap_t *h, mem_handle_t handle)
 {
-    a->allocated_size = 0;
-}
+    if (handle == MEM_HANDLE_NULL) {
+        return;
+    }
 
-// O--------------------------------------------------------------------------O
-// | Stack Allocator                                                          |
-// O--------------------------------------------------------------------------O
+    handle_entry_t *entry = handle_heap_entry(h, handle);
+    assert(entry->pin_count == 0 && "Freeing a pinned handle");
 
-void stack_init(stack_allocator_t *a, size_t size, void *mem)
-{
-    a->mem = mem;
-    a->total_size = size;
-    a->allocated_size = 0;
+    const size_t size = handle_heap_block(h, entry->offset)->size;
+    h->used_size -= size;
+    --h->used_count;
+#if FEATURE_MEMORY_STATS
+    memory_counters_set_in_use(&h->counters, h->used_size);
+#endif
 
-    log_info(LOG_CATEGORY_MEMORY, "Stack allocator initialised with size %llu bytes.", size);
+    handle_heap_release_block(h, entry->offset, size);
+
+    // Bumping the generation makes any copy of the handle stale. Generation 0 is skipped so no handle is ever 0.
+    entry->generation = (entry->generation + 1) & HANDLE_HEAP_GENERATION_MASK;
+    if (entry->generation == 0) {
+        entry->generation = 1;
+    }
+    entry->offset = h->free_entry;
+    h->free_entry = (uint32_t)(entry - h->entries);
 }
 
-void *stack_deinit(stack_allocator_t *a)
+void *handle_heap_resolve(handle_heap_t *h, mem_handle_t handle)
 {
-    if (a->allocated_size != 0) {
-        log_warn(LOG_CATEGORY_MEMORY, "Stack allocator deinitialised. Allocated memory detected. Size %llu, allocated %llu.", a->total_size, a->allocated_size);
-    } else {
-        log_info(LOG_CATEGORY_MEMORY, "Stack allocator deinitialised. All memory free.");
+    if (handle == MEM_HANDLE_NULL) {
+        return NULL;
     }
-
-    stack_reset(a);
-    return a->mem;
+    return h->mem + handle_heap_entry(h, handle)->offset + sizeof(handle_block_t);
 }
 
-void *stack_alloc(stack_allocator_t *a, size_t size, size_t align)
+void *handle_heap_pin(handle_heap_t *h, mem_handle_t handle)
 {
-    size_t offset = memory_align(a->allocated_size, align);
-    assert(offset < a->total_size);
-
-    size_t allocated_size = offset + size;
-    if (allocated_size > a->total_size) {
-        assert(false && "Overflow");
+    if (handle == MEM_HANDLE_NULL) {
         return NULL;
     }
 
-    a->allocated_size = allocated_size;
-    return (uint8_t *)a->mem + offset;
+    handle_entry_t *entry = handle_heap_entry(h, handle);
+    ++entry->pin_count;
+    return h->mem + entry->offset + sizeof(handle_block_t);
 }
 
-void stack_dealloc(stack_allocator_t *a, void *mem)
+void handle_heap_unpin(handle_heap_t *h, mem_handle_t handle)
 {
-    uint8_t *ptr = (uint8_t *)mem;
+    if (handle == MEM_HANDLE_NULL) {
+        return;
+    }
 
-    assert(ptr >= a->mem);
-    assert(ptr < (uint8_t *)a->mem + a->total_size);
-    assert(ptr < (uint8_t *)a->mem + a->allocated_size);
+    handle_entry_t *entry = handle_heap_entry(h, handle);
+    assert(entry->pin_count > 0 && "Unpinning a handle that is not pinned");
+    --entry->pin_count;
+}
 
-    size_t size = ptr - a->mem;
-    a->allocated_size = size;
+size_t handle_heap_size(handle_heap_t *h, mem_handle_t handle)
+{
+    if (handle == MEM_HANDLE_NULL) {
+        return 0;
+    }
+    return handle_heap_block(h, handle_heap_entry(h, handle)->offset)->size - sizeof(handle_block_t);
 }
 
-size_t stack_get_marker(stack_allocator_t *a)
+// Moves the block at from down to to, which is the start of the hole right below it or a hole that fits it.
+static void handle_heap_move_block(handle_heap_t *h, size_t from, size_t to, size_t size, size_t prev_size)
 {
-    return a->allocated_size;
+    SDL_memmove(h->mem + to, h->mem + from, size);
+
+    handle_block_t *block = handle_heap_block(h, to);
+    block->prev_size = prev_size;
+    h->entries[block->entry].offset = to;
 }
 
-void stack_dealloc_marker(stack_allocator_t *a, size_t marker)
+// The last block is moved into the lowest hole it fits, which shrinks the used range by a whole block per move. When
+// it is pinned or fits nowhere, the lowest hole in front of an unpinned block swaps places with that block instead,
+// so the hole moves up until it merges with the next one or reaches the top.
+size_t handle_heap_compact(handle_heap_t *h, size_t max_move_size)
 {
-    size_t diff = marker - a->allocated_size;
-    if (diff > 0) {
-        a->allocated_size = marker;
+    size_t moved_size = 0;
+
+    while (h->free_list != HANDLE_HEAP_NO_BLOCK) {
+        const size_t last = h->top - h->last_size;
+        handle_block_t *last_block = handle_heap_block(h, last);
+
+        size_t hole = HANDLE_HEAP_NO_BLOCK;
+        if (h->entries[last_block->entry].pin_count == 0) {
+            hole = handle_heap_find_free(h, last_block->size, true);
+        }
+
+        if (hole != HANDLE_HEAP_NO_BLOCK) {
+            const size_t size = last_block->size;
+            if (moved_size > 0 && moved_size + size > max_move_size) {
+                break;
+            }
+
+            const uint32_t entry = last_block->entry;
+            const size_t prev_size = handle_heap_block(h, hole)->prev_size;
+            size_t block_size = size;
+            handle_heap_split_free(h, hole, &block_size);
+            handle_heap_move_block(h, last, hole, size, prev_size);
+            handle_heap_set_block(h, hole, block_size, entry);
+            handle_heap_release_block(h, last, size);
+            h->used_size += block_size - size;
+            moved_size += size;
+        } else {
+            for (size_t offset = h->free_list; offset != HANDLE_HEAP_NO_BLOCK; offset = handle_heap_free_block(h, offset)->next) {
+                handle_block_t *next = handle_heap_block(h, offset + handle_heap_block(h, offset)->size);
+                if (h->entries[next->entry].pin_count == 0 && (hole == HANDLE_HEAP_NO_BLOCK || offset < hole)) {
+                    hole = offset;
+                }
+            }
+
+            if (hole == HANDLE_HEAP_NO_BLOCK) {
+                break;
+            }
+
+            const size_t hole_size = handle_heap_block(h, hole)->size;
+            const size_t size = handle_heap_block(h, hole + hole_size)->size;
+            if (moved_size > 0 && moved_size + size > max_move_size) {
+                break;
+            }
+
+            const size_t prev_size = handle_heap_block(h, hole)->prev_size;
+            handle_heap_unlink_free(h, hole);
+            handle_heap_move_block(h, hole + hole_size, hole, size, prev_size);
+            handle_heap_block(h, hole + size)->prev_size = size;
+            handle_heap_release_block(h, hole + size, hole_size);
+            moved_size += size;
+        }
+
+        if (moved_size >= max_move_size) {
+            break;
+        }
     }
+
+    h->moved_size += moved_size;
+
+    // Keep one step of slack above the top so a heap that hovers around a commit boundary does not thrash.
+    const size_t keep_size = h->top + ARENA_COMMIT_GRANULARITY;
+    arena_trim(h->mem, &h->committed_size, keep_size > h->retain_size ? keep_size : h->retain_size, ARENA_COMMIT_GRANULARITY);
+
+    return moved_size;
 }
 
-void stack_reset(stack_allocator_t *a)
+void handle_heap_usage(handle_heap_t *h, heap_usage_t *usage)
 {
-    a->allocated_size = 0;
+    const size_t tail_size = h->committed_size - h->top;
+
+    usage->committed_size = h->committed_size;
+    usage->used_size = h->used_size;
+    usage->free_size = h->free_size + tail_size;
+    usage->largest_free_size = tail_size;
+    usage->used_count = h->used_count;
+    usage->free_count = h->free_count + (tail_size > 0 ? 1 : 0);
+
+    for (size_t offset = h->free_list; offset != HANDLE_HEAP_NO_BLOCK; offset = handle_heap_free_block(h, offset)->next) {
+        const size_t size = handle_heap_block(h, offset)->size;
+        if (size > usage->largest_free_size) {
+            usage->largest_free_size = size;
+        }
+    }
 }
 
 // O--------------------------------------------------------------------------O
@@ -276,7 +2152,9 @@ void stack_reset(stack_allocator_t *a)
 static void *SDL_malloc_on_heap(size_t size)
 {
     heap_allocator_t *system = mem_system_allocator();
+    memory_tag_t tag = mem_set_tag(MEMORY_TAG_SDL);
     void *mem = heap_alloc(system, size, MEM_DEFAULT_ALIGN);
+    mem_set_tag(tag);
     return mem;
 }
 
@@ -286,14 +2164,18 @@ static void *SDL_calloc_on_heap(size_t nmemb, size_t size)
     assert(size > 0);
 
     heap_allocator_t *system = mem_system_allocator();
+    memory_tag_t tag = mem_set_tag(MEMORY_TAG_SDL);
     void *mem = heap_calloc(system, nmemb, size, MEM_DEFAULT_ALIGN);
+    mem_set_tag(tag);
     return mem;
 }
 
 void *SDL_realloc_on_heap(void *mem, size_t size)
 {
     heap_allocator_t *system = mem_system_allocator();
+    memory_tag_t tag = mem_set_tag(MEMORY_TAG_SDL);
     void *new_mem = heap_realloc(system, mem, size, MEM_DEFAULT_ALIGN);
+    mem_set_tag(tag);
     return new_mem;
 }
 
@@ -303,6 +2185,74 @@ void SDL_free_on_heap(void *mem)
     heap_dealloc(system, mem);
 }
 
+struct scratch_arena_t
+{
+    stack_allocator_t stack;
+    scratch_arena_t *next;
+    SDL_ThreadID thread_id;
+    char name[32];
+};
+
+static THREAD_LOCAL scratch_arena_t *t_scratch_arena;
+
+// Runs on the owning thread when it exits, or from stop_memory_system for whatever is left.
+static void scratch_arena_release(void *value)
+{
+    memory_system_t *ms = &g_memory_system;
+    scratch_arena_t *arena = (scratch_arena_t *)value;
+
+    SDL_LockSpinlock(&ms->scratch_lock);
+    for (scratch_arena_t **it = &ms->scratch_arenas; *it != NULL; it = &(*it)->next) {
+        if (*it == arena) {
+            *it = arena->next;
+            break;
+        }
+    }
+    SDL_UnlockSpinlock(&ms->scratch_lock);
+
+    if (t_scratch_arena == arena) {
+        t_scratch_arena = NULL;
+    }
+
+    log_info(LOG_CATEGORY_MEMORY, "Scratch arena for thread %llu peaked at %llu of %llu bytes.", arena->thread_id, arena->stack.peak_size, arena->stack.total_size);
+    stack_deinit(&arena->stack);
+    heap_dealloc(&ms->system, arena);
+}
+
+static scratch_arena_t *scratch_arena_create(void)
+{
+    memory_system_t *ms = &g_memory_system;
+
+    // The arena header and its memory share one allocation unless the arena reserves its own address space.
+    const size_t header_size = memory_align(sizeof(scratch_arena_t), CACHE_LINE_SIZE);
+    const size_t buffer_size = ms->scratch_reserve_size > 0 ? 0 : ms->scratch_size;
+    scratch_arena_t *arena = heap_alloc(&ms->system, header_size + buffer_size, CACHE_LINE_SIZE);
+    if (arena == NULL) {
+        log_error(LOG_CATEGORY_MEMORY, "Failed to allocate %llu byte scratch arena.", ms->scratch_size);
+        return NULL;
+    }
+
+    if (buffer_size > 0) {
+        stack_init(&arena->stack, buffer_size, (uint8_t *)arena + header_size);
+    } else if (!stack_init_virtual(&arena->stack, ms->scratch_reserve_size, ms->scratch_size, ms->huge_pages)) {
+        heap_dealloc(&ms->system, arena);
+        return NULL;
+    }
+    arena->thread_id = SDL_GetCurrentThreadID();
+    SDL_snprintf(arena->name, sizeof(arena->name), "scratch %llu", (unsigned long long)arena->thread_id);
+#if FEATURE_MEMORY_STATS
+    mem_stats_register(arena->name, &arena->stack.counters);
+#endif
+
+    SDL_LockSpinlock(&ms->scratch_lock);
+    arena->next = ms->scratch_arenas;
+    ms->scratch_arenas = arena;
+    SDL_UnlockSpinlock(&ms->scratch_lock);
+
+    SDL_SetTLS(&ms->scratch_tls, arena, scratch_arena_release);
+    return arena;
+}
+
 bool start_memory_system(memory_system_desc_t desc)
 {
     // Tell SDL to use our memory allocation functions.
@@ -311,11 +2261,52 @@ bool start_memory_system(memory_system_desc_t desc)
         return false;
     }
 
-    void *system_mem = malloc(desc.system_memory_size);
-    heap_init(&g_memory_system.system, desc.system_memory_size, system_mem);
+    int32_t shard_count = desc.system_heap_shard_count;
+    if (shard_count <= 0) {
+        shard_count = SDL_clamp(SDL_GetNumLogicalCPUCores(), 1, HEAP_MAX_SHARDS);
+    }
+
+    if (!heap_init(&g_memory_system.system, desc.system_reserve_size, desc.system_pool_size, shard_count, desc.huge_pages)) {
+        return false;
+    }
+
+#if FEATURE_MEMORY_STATS
+    mem_stats_register("system", &g_memory_system.system.counters);
+#endif
+
+    if (desc.handle_reserve_size > 0) {
+        const uint32_t max_handles = desc.handle_max_count > 0 ? desc.handle_max_count : HANDLE_HEAP_MAX_HANDLES;
+        if (!handle_heap_init(&g_memory_system.handles, desc.handle_reserve_size, 0, max_handles)) {
+            return false;
+        }
+#if FEATURE_MEMORY_STATS
+        mem_stats_register("handles", &g_memory_system.handles.counters);
+#endif
+        g_memory_system.handle_compact_budget = desc.handle_compact_budget;
+    }
 
-    void *scratch_mem = heap_alloc(&g_memory_system.system, desc.scratch_memory_size, MEM_DEFAULT_ALIGN);
-    stack_init(&g_memory_system.scratch, desc.scratch_memory_size, scratch_mem);
+    g_memory_system.scratch_size = desc.scratch_memory_size;
+    g_memory_system.scratch_reserve_size = desc.scratch_reserve_size;
+    g_memory_system.huge_pages = desc.huge_pages;
+
+    g_memory_system.frame_count = desc.frame_arena_count > 0 ? desc.frame_arena_count : 2;
+    assert(g_memory_system.frame_count <= FRAME_ARENA_MAX_COUNT);
+    for (int32_t i = 0; i < g_memory_system.frame_count; ++i) {
+        if (desc.frame_reserve_size > 0) {
+            if (!linear_init_virtual(&g_memory_system.frames[i], desc.frame_reserve_size, desc.frame_memory_size, desc.huge_pages)) {
+                return false;
+            }
+        } else {
+            void *frame_mem = heap_alloc(&g_memory_system.system, desc.frame_memory_size, CACHE_LINE_SIZE);
+            linear_init(&g_memory_system.frames[i], desc.frame_memory_size, frame_mem);
+        }
+#if FEATURE_MEMORY_STATS
+        mem_stats_register(g_frame_arena_names[i], &g_memory_system.frames[i].counters);
+#endif
+    }
+    g_memory_system.frame = 0;
+    g_memory_system.frame_stats = (frame_memory_stats_t){ .arena_size = g_memory_system.frames[0].total_size };
+    g_memory_system.stats_dump_interval = desc.stats_dump_interval;
 
     log_info(LOG_CATEGORY_MEMORY, "Memory system started.");
 
@@ -326,11 +2317,33 @@ void stop_memory_system(void)
 {
     log_info(LOG_CATEGORY_MEMORY, "Memory system stopped.");
 
-    void *scratch_mem = stack_deinit(&g_memory_system.scratch);
-    heap_dealloc(&g_memory_system.system, scratch_mem);
+    mem_stats_dump();
 
-    void *system_mem = heap_deinit(&g_memory_system.system);
-    free(system_mem);
+    log_info(LOG_CATEGORY_MEMORY, "Frame arenas peaked at %llu of %llu bytes.", g_memory_system.frame_stats.peak_frame_size, g_memory_system.frame_stats.arena_size);
+    for (int32_t i = 0; i < g_memory_system.frame_count; ++i) {
+        // Whatever the last frames allocated is expected to still be there.
+        linear_reset(&g_memory_system.frames[i]);
+        void *frame_mem = linear_deinit(&g_memory_system.frames[i]);
+        heap_dealloc(&g_memory_system.system, frame_mem);
+    }
+
+    // The calling thread's arena is released here rather than by its thread exit callback.
+    SDL_SetTLS(&g_memory_system.scratch_tls, NULL, NULL);
+    while (g_memory_system.scratch_arenas != NULL) {
+        scratch_arena_t *arena = g_memory_system.scratch_arenas;
+        if (arena->thread_id != SDL_GetCurrentThreadID()) {
+            log_warn(LOG_CATEGORY_MEMORY, "Scratch arena for thread %llu released while the thread may still be running.", arena->thread_id);
+        }
+        scratch_arena_release(arena);
+    }
+
+    if (g_memory_system.handles.mem != NULL) {
+        handle_heap_deinit(&g_memory_system.handles);
+    }
+
+    mem_callsites_report_leaks();
+
+    heap_deinit(&g_memory_system.system);
 }
 
 heap_allocator_t *mem_system_allocator(void)
@@ -338,9 +2351,81 @@ heap_allocator_t *mem_system_allocator(void)
     return &g_memory_system.system;
 }
 
+handle_heap_t *mem_handle_allocator(void)
+{
+    return g_memory_system.handles.mem != NULL ? &g_memory_system.handles : NULL;
+}
+
 stack_allocator_t *mem_scratch_allocator(void)
 {
-    return &g_memory_system.scratch;
+    if (t_scratch_arena == NULL) {
+        t_scratch_arena = scratch_arena_create();
+        if (t_scratch_arena == NULL) {
+            return NULL;
+        }
+    }
+    return &t_scratch_arena->stack;
+}
+
+temp_memory_t temp_begin(void)
+{
+    stack_allocator_t *stack = mem_scratch_allocator();
+    if (stack == NULL) {
+        return (temp_memory_t){};
+    }
+    return (temp_memory_t){ .stack = stack, .marker = stack_get_marker(stack) };
+}
+
+void temp_end(temp_memory_t temp)
+{
+    if (temp.stack == NULL) {
+        return;
+    }
+
+    // Scratch arenas are never reset explicitly, so the outermost scope does it to give back pages above the
+    // retained size.
+    if (temp.marker == 0) {
+        stack_reset(temp.stack);
+    } else {
+        stack_dealloc_marker(temp.stack, temp.marker);
+    }
+}
+
+void mem_begin_frame(void)
+{
+    memory_system_t *ms = &g_memory_system;
+
+    const size_t frame_size = ms->frames[ms->frame].allocated_size;
+    ms->frame_stats.last_frame_size = frame_size;
+    if (frame_size > ms->frame_stats.peak_frame_size) {
+        ms->frame_stats.peak_frame_size = frame_size;
+    }
+
+    // The arena being reset was last filled frame_count frames ago, the ones in between are left untouched.
+    ms->frame = (ms->frame + 1) % ms->frame_count;
+    linear_reset(&ms->frames[ms->frame]);
+    ++ms->frame_stats.frame_index;
+
+    if (ms->handles.mem != NULL && ms->handle_compact_budget > 0) {
+        handle_heap_compact(&ms->handles, ms->handle_compact_budget);
+    }
+
+#if FEATURE_MEMORY_STATS
+    memory_stats_begin_frame();
+    if (ms->stats_dump_interval > 0 && ms->frame_stats.frame_index % ms->stats_dump_interval == 0) {
+        mem_stats_dump();
+    }
+#endif
+}
+
+linear_allocator_t *mem_frame_allocator(void)
+{
+    return &g_memory_system.frames[g_memory_system.frame];
+}
+
+frame_memory_stats_t mem_frame_stats(void)
+{
+    return g_memory_system.frame_stats;
 }
 
 // O--------------------------------------------------------------------------O
@@ -2,90 +2,430 @@
 #define MEMORY_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+// O--------------------------------------------------------------------------O
+// | Helper Macros                                                            |
+// O--------------------------------------------------------------------------O
+
+#define KB(x) ((size_t)(x) * 1024)
+#define MB(x) ((size_t)(x) * 1024 * 1024)
+#define GB(x) ((size_t)(x) * 1024 * 1024 * 1024)
+
+#define CACHE_LINE_SIZE 64
+
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+// O--------------------------------------------------------------------------O
+// | Virtual Memory                                                           |
+// O--------------------------------------------------------------------------O
+
+#define VM_HUGE_PAGE_SIZE MB(2)
+
+typedef enum vm_backing_t vm_backing_t;
+enum vm_backing_t
+{
+    VM_BACKING_SMALL_PAGES,
+    VM_BACKING_TRANSPARENT_HUGE_PAGES,
+};
+
+size_t vm_page_size(void);
+void *vm_reserve(size_t size);
+// Reserves a VM_HUGE_PAGE_SIZE aligned range and asks the OS to back it with huge pages once committed. Falls back to
+// small pages where that is not possible; backing reports what was actually obtained.
+void *vm_reserve_huge(size_t size, vm_backing_t *backing);
+const char *vm_backing_name(vm_backing_t backing);
+bool vm_commit(void *mem, size_t size);
+void vm_decommit(void *mem, size_t size);
+void vm_release(void *mem, size_t size);
+
+// O--------------------------------------------------------------------------O
+// | Memory Stats                                                             |
+// O--------------------------------------------------------------------------O
+
+// Allocations on a heap are attributed to the calling thread's current tag, set with mem_set_tag. Linear, stack and
+// pool allocators are only counted per allocator.
+typedef enum memory_tag_t memory_tag_t;
+enum memory_tag_t
+{
+    MEMORY_TAG_UNTAGGED,
+    MEMORY_TAG_SDL,
+    MEMORY_TAG_IMAGE,
+    MEMORY_TAG_LOG,
+    MEMORY_TAG_COUNT,
+};
+
+// Size classes are powers of four: <=16, <=64, <=256, ... <=1M, >1M bytes.
+#define MEMORY_SIZE_CLASS_COUNT 10
+
+typedef struct memory_stats_t memory_stats_t;
+struct memory_stats_t
+{
+    const char *name;
+    size_t in_use;
+    size_t peak;
+    uint32_t allocation_count;
+    uint32_t frame_allocation_count; // During the last completed frame.
+    uint32_t size_classes[MEMORY_SIZE_CLASS_COUNT];
+};
+
+#if FEATURE_MEMORY_STATS
+// Live counters, updated with relaxed atomics from any thread. Exactly one cache line.
+typedef struct memory_counters_t memory_counters_t;
+struct memory_counters_t
+{
+    _Alignas(CACHE_LINE_SIZE) int64_t in_use;
+    int64_t peak;
+    int32_t allocation_count;
+    int32_t frame_allocation_count;
+    int32_t size_classes[MEMORY_SIZE_CLASS_COUNT];
+};
+
+memory_tag_t mem_set_tag(memory_tag_t tag);
+void mem_stats_register(const char *name, memory_counters_t *counters);
+void mem_stats_unregister(memory_counters_t *counters);
+#else
+static inline memory_tag_t mem_set_tag(memory_tag_t tag) { return tag; }
+#endif
+
+// The queries are always available and report nothing when FEATURE_MEMORY_STATS is off.
+int32_t mem_stats_allocator_count(void);
+bool mem_stats_allocator(int32_t index, memory_stats_t *stats);
+bool mem_stats_tag(memory_tag_t tag, memory_stats_t *stats);
+void mem_stats_dump(void);
+
+// O--------------------------------------------------------------------------O
+// | Memory Callsites                                                         |
+// O--------------------------------------------------------------------------O
+
+// With FEATURE_MEMORY_CALLSITES the heap, linear and stack allocation functions become macros that pass __FILE__ and
+// __LINE__ along. Heap allocations remember their callsite so leaks can be grouped by where they were made; linear
+// and stack allocations only count towards the hot callsite report.
+#if FEATURE_MEMORY_CALLSITES && !FEATURE_MEMORY_STATS
+#error "FEATURE_MEMORY_CALLSITES requires FEATURE_MEMORY_STATS."
+#endif
+
+typedef struct memory_callsite_stats_t memory_callsite_stats_t;
+struct memory_callsite_stats_t
+{
+    const char *file;
+    int32_t line;
+    size_t in_use;
+    uint32_t live_count;
+    size_t total_bytes;
+    uint32_t allocation_count;
+};
+
+typedef enum memory_callsite_order_t memory_callsite_order_t;
+enum memory_callsite_order_t
+{
+    MEMORY_CALLSITE_BY_BYTES,
+    MEMORY_CALLSITE_BY_COUNT,
+    MEMORY_CALLSITE_BY_IN_USE,
+};
+
+// Both report nothing when FEATURE_MEMORY_CALLSITES is off.
+int32_t mem_callsites_top(memory_callsite_order_t order, memory_callsite_stats_t *callsites, int32_t max_count);
+void mem_callsites_report_leaks(void);
+
 // O--------------------------------------------------------------------------O
 // | Heap Allocator                                                           |
 // O--------------------------------------------------------------------------O
 
+#define HEAP_MAX_SHARDS 8
+
+typedef struct heap_shard_t heap_shard_t;
+
+// Safe to use from any thread. The reserved address space is split between up to HEAP_MAX_SHARDS independently
+// locked TLSF instances and each thread allocates from its own home shard. Memory is committed in pools of at least
+// pool_size bytes as the heap grows and decommitted again when pools empty.
 typedef struct heap_allocator_t heap_allocator_t;
 struct heap_allocator_t
 {
-    void *tlsf;
+    heap_shard_t *shards;
+    int32_t shard_count;
     void *mem;
-    size_t total_size;
-    size_t allocated_size;
+    size_t reserve_size;
+    uint8_t *shard_base;
+    size_t shard_span;
+    vm_backing_t backing;
+#if FEATURE_MEMORY_STATS
+    memory_counters_t counters;
+#endif
 };
 
-void heap_init(heap_allocator_t *a, size_t size, void *mem);
-void *heap_deinit(heap_allocator_t *a);
+bool heap_init(heap_allocator_t *a, size_t reserve_size, size_t pool_size, int32_t shard_count, bool huge_pages);
+void heap_deinit(heap_allocator_t *a);
 void *heap_alloc(heap_allocator_t *a, size_t size, size_t alignment);
 void *heap_calloc(heap_allocator_t *a, size_t count, size_t size, size_t align);
 void *heap_realloc(heap_allocator_t *a, void *mem, size_t size, size_t align);
 void heap_dealloc(heap_allocator_t *a, void *mem);
+size_t heap_committed_size(heap_allocator_t *a);
+
+typedef struct heap_usage_t heap_usage_t;
+struct heap_usage_t
+{
+    size_t committed_size;
+    size_t used_size;
+    size_t free_size;
+    size_t largest_free_size;
+    int32_t used_count;
+    int32_t free_count;
+};
+
+// Walks every block in every shard, so it is meant for diagnostics rather than per-frame use. Fragmentation is
+// 1 - largest_free_size / free_size.
+void heap_usage(heap_allocator_t *a, heap_usage_t *usage);
+
+#if FEATURE_MEMORY_CALLSITES
+void *heap_alloc_at(heap_allocator_t *a, size_t size, size_t align, const char *file, int32_t line);
+void *heap_calloc_at(heap_allocator_t *a, size_t count, size_t size, size_t align, const char *file, int32_t line);
+void *heap_realloc_at(heap_allocator_t *a, void *mem, size_t size, size_t align, const char *file, int32_t line);
+
+#define heap_alloc(a, size, align)          heap_alloc_at(a, size, align, __FILE__, __LINE__)
+#define heap_calloc(a, count, size, align)  heap_calloc_at(a, count, size, align, __FILE__, __LINE__)
+#define heap_realloc(a, mem, size, align)   heap_realloc_at(a, mem, size, align, __FILE__, __LINE__)
+#endif
 
 // O--------------------------------------------------------------------------O
 // | Linear Allocator                                                         |
 // O--------------------------------------------------------------------------O
 
+// Either hands out a fixed buffer given to linear_init, or with linear_init_virtual reserves reserve_size bytes of
+// address space and commits pages as the offset grows, so pointers stay stable and nothing is ever copied. A virtual
+// arena decommits everything above retain_size when it is reset; pass reserve_size to keep all pages committed.
 typedef struct linear_allocator_t linear_allocator_t;
 struct linear_allocator_t
 {
     void *mem;
     size_t total_size;
     size_t allocated_size;
+    size_t committed_size;
+    size_t retain_size;
+    size_t commit_granularity;
+    vm_backing_t backing;
+    bool is_virtual;
+#if FEATURE_MEMORY_STATS
+    memory_counters_t counters;
+#endif
 };
 
 void linear_init(linear_allocator_t *a, size_t size, void *mem);
-void *linear_deinit(linear_allocator_t *a);
+bool linear_init_virtual(linear_allocator_t *a, size_t reserve_size, size_t retain_size, bool huge_pages);
+void *linear_deinit(linear_allocator_t *a); // Returns the buffer given to linear_init, NULL for virtual arenas.
 void *linear_alloc(linear_allocator_t *a, size_t size, size_t alignment);
 void linear_reset(linear_allocator_t *a);
 
+#if FEATURE_MEMORY_CALLSITES
+void *linear_alloc_at(linear_allocator_t *a, size_t size, size_t align, const char *file, int32_t line);
+
+#define linear_alloc(a, size, align) linear_alloc_at(a, size, align, __FILE__, __LINE__)
+#endif
+
 // O--------------------------------------------------------------------------O
 // | Stack Allocator                                                          |
 // O--------------------------------------------------------------------------O
 
+// Backed the same way as the linear allocator, see linear_init_virtual.
 typedef struct stack_allocator_t stack_allocator_t;
 struct stack_allocator_t
 {
     void *mem;
     size_t total_size;
     size_t allocated_size;
+    size_t peak_size;
+    size_t committed_size;
+    size_t retain_size;
+    size_t commit_granularity;
+    vm_backing_t backing;
+    bool is_virtual;
+#if FEATURE_MEMORY_STATS
+    memory_counters_t counters;
+#endif
 };
 
 void stack_init(stack_allocator_t *a, size_t size, void *mem);
-void *stack_deinit(stack_allocator_t *a);
+bool stack_init_virtual(stack_allocator_t *a, size_t reserve_size, size_t retain_size, bool huge_pages);
+void *stack_deinit(stack_allocator_t *a); // Returns the buffer given to stack_init, NULL for virtual arenas.
 void *stack_alloc(stack_allocator_t *a, size_t size, size_t alignment);
 void stack_dealloc(stack_allocator_t *a, void *mem);
 size_t stack_get_marker(stack_allocator_t *a);
 void stack_dealloc_marker(stack_allocator_t *a, size_t marker);
 void stack_reset(stack_allocator_t *a);
 
+#if FEATURE_MEMORY_CALLSITES
+void *stack_alloc_at(stack_allocator_t *a, size_t size, size_t align, const char *file, int32_t line);
+
+#define stack_alloc(a, size, align) stack_alloc_at(a, size, align, __FILE__, __LINE__)
+#endif
+
+// O--------------------------------------------------------------------------O
+// | Pool Allocator                                                           |
+// O--------------------------------------------------------------------------O
+
+// Hands out fixed-size blocks in O(1) from an intrusive free list. A pool either owns a fixed region given to
+// pool_init, or grows by allocating slabs of slab_size bytes from a parent heap. Blocks are block_align aligned and
+// spaced so that no two blocks share an alignment boundary; pass CACHE_LINE_SIZE to keep blocks on separate lines.
+typedef struct pool_allocator_t pool_allocator_t;
+struct pool_allocator_t
+{
+    void *mem;
+    size_t total_size;
+    size_t block_size;
+    size_t block_align;
+    heap_allocator_t *parent;
+    size_t slab_size;
+    void *slabs;
+    uint8_t *bump;
+    uint8_t *bump_end;
+    void *free_list;
+    size_t allocated_count;
+#if FEATURE_MEMORY_STATS
+    memory_counters_t counters;
+#endif
+};
+
+void pool_init(pool_allocator_t *a, size_t block_size, size_t block_align, size_t size, void *mem);
+void pool_init_growable(pool_allocator_t *a, size_t block_size, size_t block_align, size_t slab_size, heap_allocator_t *parent);
+void *pool_deinit(pool_allocator_t *a);
+void *pool_alloc(pool_allocator_t *a);
+void pool_dealloc(pool_allocator_t *a, void *mem);
+void pool_reset(pool_allocator_t *a);
+
+// O--------------------------------------------------------------------------O
+// | Handle Heap                                                              |
+// O--------------------------------------------------------------------------O
+
+// Handles are an index into the heap's handle table plus a generation, so a stale handle is caught instead of reading
+// whatever block took its slot. 0 is never a valid handle.
+typedef uint32_t mem_handle_t;
+
+#define MEM_HANDLE_NULL 0
+#define HANDLE_HEAP_MAX_HANDLES (1u << 20)
+#define HANDLE_HEAP_ALIGN 16
+
+typedef struct handle_entry_t handle_entry_t;
+
+// Hands out handles instead of pointers so blocks can be moved. Blocks are placed first fit into the holes left by
+// freed blocks, or bumped from the end of the used range, which commits pages from reserve_size bytes of address
+// space as it grows. handle_heap_compact moves live blocks down into the holes a bounded number of bytes at a time,
+// so free space merges back into the end of the range, where everything above retain_size is decommitted.
+//
+// A pointer from handle_heap_resolve is only valid until the next compaction step. Pinned blocks are never moved, so
+// pin a handle for as long as a pointer to its block is held across frames or handed to another system. Blocks are
+// HANDLE_HEAP_ALIGN aligned. Not thread safe.
+typedef struct handle_heap_t handle_heap_t;
+struct handle_heap_t
+{
+    uint8_t *mem;
+    size_t total_size;
+    size_t committed_size;
+    size_t retain_size;
+    size_t top;        // End of the last block, everything above is free.
+    size_t last_size;  // Of the block that ends at top.
+    size_t free_list;  // First free block below top.
+    size_t used_size;
+    size_t free_size;  // In holes below top.
+    size_t moved_size; // Total bytes moved by compaction.
+    int32_t used_count;
+    int32_t free_count;
+    handle_entry_t *entries;
+    size_t entries_committed_size;
+    uint32_t entry_count;
+    uint32_t max_handles;
+    uint32_t free_entry;
+#if FEATURE_MEMORY_STATS
+    memory_counters_t counters;
+#endif
+};
+
+bool handle_heap_init(handle_heap_t *h, size_t reserve_size, size_t retain_size, uint32_t max_handles);
+void handle_heap_deinit(handle_heap_t *h);
+mem_handle_t handle_heap_alloc(handle_heap_t *h, size_t size);
+void handle_heap_dealloc(handle_heap_t *h, mem_handle_t handle);
+void *handle_heap_resolve(handle_heap_t *h, mem_handle_t handle);
+void *handle_heap_pin(handle_heap_t *h, mem_handle_t handle);
+void handle_heap_unpin(handle_heap_t *h, mem_handle_t handle);
+size_t handle_heap_size(handle_heap_t *h, mem_handle_t handle); // Usable size, at least the size asked for.
+
+// Moves live, unpinned blocks until about max_move_size bytes have been moved and returns how many were. A single
+// block larger than the budget is still moved when it is the first one in the step, so compaction always progresses.
+size_t handle_heap_compact(handle_heap_t *h, size_t max_move_size);
+
+// Only walks the free list, so it is cheap enough to sample every frame. The committed space above the last block
+// counts as one free block.
+void handle_heap_usage(handle_heap_t *h, heap_usage_t *usage);
+
 // O--------------------------------------------------------------------------O
 // | Memory System                                                            |
 // O--------------------------------------------------------------------------O
 
 static size_t MEM_DEFAULT_ALIGN = 8; // 64-bits for x64 architectures. Is this sensible?
 
+#define FRAME_ARENA_MAX_COUNT 4
+
 typedef struct memory_system_desc_t memory_system_desc_t;
 struct memory_system_desc_t
 {
-    size_t system_memory_size;
-    size_t scratch_memory_size;
+    size_t system_reserve_size; // Address space only, pages are committed as the system heap grows.
+    size_t system_pool_size;
+    size_t scratch_memory_size;      // Per thread, each thread's scratch arena is created on first use.
+    int32_t system_heap_shard_count; // 0 picks one shard per logical core, up to HEAP_MAX_SHARDS.
+    size_t scratch_reserve_size;     // When set, scratch arenas reserve this much and commit as they grow.
+    size_t frame_memory_size;        // Per frame arena.
+    size_t frame_reserve_size;       // When set, frame arenas reserve this much and commit as they grow.
+    bool huge_pages;                 // Back the system heap and virtual arenas with huge pages where available.
+    int32_t frame_arena_count;       // 0 means double-buffered, up to FRAME_ARENA_MAX_COUNT.
+    int32_t stats_dump_interval;     // Frames between memory stats dumps to the log, 0 to never dump.
+    size_t handle_reserve_size;      // Address space for the system handle heap, 0 to go without one.
+    uint32_t handle_max_count;       // 0 means HANDLE_HEAP_MAX_HANDLES, the table is only committed as it fills.
+    size_t handle_compact_budget;    // Bytes the system handle heap may move on each mem_begin_frame.
+};
+
+typedef struct frame_memory_stats_t frame_memory_stats_t;
+struct frame_memory_stats_t
+{
+    uint64_t frame_index;
+    size_t last_frame_size;
+    size_t peak_frame_size;
+    size_t arena_size;
 };
 
 bool start_memory_system(memory_system_desc_t desc);
 void stop_memory_system(void);
 
 heap_allocator_t *mem_system_allocator(void);
+
+// NULL when the memory system was started without a handle heap. Compacted on every mem_begin_frame, so it belongs
+// to the thread that runs the frame loop.
+handle_heap_t *mem_handle_allocator(void);
+
+// Every thread gets its own scratch arena on first use, released when the thread exits. Threads other than the one
+// that started the memory system must exit before it is stopped.
 stack_allocator_t *mem_scratch_allocator(void);
 
-// O--------------------------------------------------------------------------O
-// | Helper Macros                                                            |
-// O--------------------------------------------------------------------------O
+// A scope on the calling thread's scratch arena. Everything allocated from stack after temp_begin is released by the
+// matching temp_end, so error paths need a single call instead of unwinding each allocation in order. Scopes nest.
+// When the thread's arena cannot be created stack is NULL, stack_alloc then returns NULL and temp_end does nothing.
+typedef struct temp_memory_t temp_memory_t;
+struct temp_memory_t
+{
+    stack_allocator_t *stack;
+    size_t marker;
+};
+
+temp_memory_t temp_begin(void);
+void temp_end(temp_memory_t temp);
 
-#define KB(x) ((x) * 1024)
-#define MB(x) ((x) * 1024 * 1024)
-#define GB(x) ((x) * 1024 * 1024 * 1024)
+// Frame arenas hold transient data for a single frame. They rotate on every mem_begin_frame, so memory allocated
+// during frame N stays valid until frame arena count further frames have begun.
+void mem_begin_frame(void);
+linear_allocator_t *mem_frame_allocator(void);
+frame_memory_stats_t mem_frame_stats(void);
 
 #endif // MEMORY_H
@@ -0,0 +1,337 @@
+#include "metrics.h"
+
+#include <SDL3/SDL.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <afunix.h>
+#else
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "atomic.h"
+#include "log.h"
+
+#define METRICS_SERVER_POLL_MS 100
+#define METRICS_TEXT_SIZE      (16 * 1024)
+
+#if defined(_WIN32)
+typedef SOCKET metrics_socket_t;
+typedef WSAPOLLFD metrics_pollfd_t;
+#define METRICS_INVALID_SOCKET INVALID_SOCKET
+#else
+typedef int metrics_socket_t;
+typedef struct pollfd metrics_pollfd_t;
+#define METRICS_INVALID_SOCKET (-1)
+#endif
+
+// Suppresses SIGPIPE when a client hangs up before reading, where send supports it.
+#if defined(MSG_NOSIGNAL)
+#define METRICS_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define METRICS_SEND_FLAGS 0
+#endif
+
+typedef struct metric_t metric_t;
+struct metric_t
+{
+    const char *name;
+    metrics_sample_t sample;
+    void *user;
+    int64_t value; // Updated with relaxed atomics, unused when there is a sample function.
+};
+
+// The snapshot readers copy, sequence is odd while the frame thread rewrites it.
+typedef struct metrics_published_t metrics_published_t;
+struct metrics_published_t
+{
+    SDL_AtomicU32 sequence;
+    metrics_snapshot_t snapshot;
+};
+
+typedef struct metrics_server_t metrics_server_t;
+struct metrics_server_t
+{
+    char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    metrics_socket_t listener;
+    SDL_Thread *thread;
+    SDL_AtomicInt stopping;
+    char text[METRICS_TEXT_SIZE];
+};
+
+// Entries below g_metric_count are complete and never change, registering writes the entry before raising the count.
+static metric_t g_metrics[METRICS_MAX_COUNT];
+static SDL_AtomicInt g_metric_count;
+static SDL_SpinLock g_metrics_register_lock;
+static metrics_published_t g_published;
+static uint64_t g_publish_interval_ns = METRICS_DEFAULT_PUBLISH_INTERVAL_MS * SDL_NS_PER_MS;
+static uint64_t g_last_publish_ns;
+static metrics_server_t g_metrics_server;
+
+static void close_metrics_socket(const metrics_socket_t socket)
+{
+#if defined(_WIN32)
+    closesocket(socket);
+#else
+    close(socket);
+#endif
+}
+
+static bool metrics_server_listen(metrics_server_t *server, const char *path)
+{
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    if (SDL_strlcpy(address.sun_path, path, sizeof(address.sun_path)) >= sizeof(address.sun_path)) {
+        return SDL_SetError("Metrics socket path is longer than %d characters", (int32_t)sizeof(address.sun_path) - 1);
+    }
+
+#if defined(_WIN32)
+    WSADATA wsa_data;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
+        return SDL_SetError("WSAStartup failed with %d", WSAGetLastError());
+    }
+#endif
+
+    // A socket left behind by a process that did not stop cleanly would make bind fail.
+    SDL_RemovePath(path);
+
+    const metrics_socket_t listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener == METRICS_INVALID_SOCKET) {
+        return SDL_SetError("Failed to create the metrics socket");
+    }
+
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 4) != 0) {
+        close_metrics_socket(listener);
+        return SDL_SetError("Failed to listen on %s", path);
+    }
+
+    server->listener = listener;
+    SDL_strlcpy(server->path, path, sizeof(server->path));
+    return true;
+}
+
+static void metrics_server_close(metrics_server_t *server)
+{
+    close_metrics_socket(server->listener);
+    SDL_RemovePath(server->path);
+#if defined(_WIN32)
+    WSACleanup();
+#endif
+    server->listener = METRICS_INVALID_SOCKET;
+}
+
+// A snapshot is a few kilobytes and fits in the socket buffer, so sending does not wait for the client to read.
+static void metrics_server_respond(metrics_server_t *server, const metrics_socket_t client)
+{
+    metrics_snapshot_t snapshot;
+    metrics_read(&snapshot);
+    const int32_t length = metrics_format_text(&snapshot, server->text, sizeof(server->text));
+
+    int32_t sent = 0;
+    while (sent < length) {
+        const int32_t result = (int32_t)send(client, server->text + sent, length - sent, METRICS_SEND_FLAGS);
+        if (result <= 0) {
+            break;
+        }
+        sent += result;
+    }
+}
+
+static int metrics_server_thread(void *user)
+{
+    metrics_server_t *server = user;
+
+    while (!SDL_GetAtomicInt(&server->stopping)) {
+        metrics_pollfd_t poll_fd = { .fd = server->listener, .events = POLLIN };
+#if defined(_WIN32)
+        const int32_t ready = WSAPoll(&poll_fd, 1, METRICS_SERVER_POLL_MS);
+#else
+        const int32_t ready = poll(&poll_fd, 1, METRICS_SERVER_POLL_MS);
+#endif
+        if (ready <= 0) {
+            continue;
+        }
+
+        const metrics_socket_t client = accept(server->listener, NULL, NULL);
+        if (client == METRICS_INVALID_SOCKET) {
+            continue;
+        }
+
+#if defined(SO_NOSIGPIPE)
+        const int32_t no_sigpipe = 1;
+        setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &no_sigpipe, sizeof(no_sigpipe));
+#endif
+
+        metrics_server_respond(server, client);
+        close_metrics_socket(client);
+    }
+
+    return 0;
+}
+
+bool start_metrics_system(const metrics_system_desc_t desc)
+{
+    const int32_t interval_ms = desc.publish_interval_ms > 0 ? desc.publish_interval_ms : METRICS_DEFAULT_PUBLISH_INTERVAL_MS;
+    g_publish_interval_ns = (uint64_t)interval_ms * SDL_NS_PER_MS;
+
+    metrics_server_t *server = &g_metrics_server;
+    if (desc.socket_path == NULL || server->thread != NULL) {
+        return true;
+    }
+
+    if (!metrics_server_listen(server, desc.socket_path)) {
+        return false;
+    }
+
+    SDL_SetAtomicInt(&server->stopping, 0);
+    server->thread = SDL_CreateThread(metrics_server_thread, "metrics server", server);
+    if (server->thread == NULL) {
+        metrics_server_close(server);
+        return false;
+    }
+
+    log_info(LOG_CATEGORY_APPLICATION, "Serving metrics on %s.", server->path);
+    return true;
+}
+
+void stop_metrics_system(void)
+{
+    metrics_server_t *server = &g_metrics_server;
+    if (server->thread == NULL) {
+        return;
+    }
+
+    SDL_SetAtomicInt(&server->stopping, 1);
+    SDL_WaitThread(server->thread, NULL);
+    server->thread = NULL;
+    metrics_server_close(server);
+}
+
+int32_t metrics_register(const char *name, const metrics_sample_t sample, void *user)
+{
+    SDL_LockSpinlock(&g_metrics_register_lock);
+
+    const int32_t count = SDL_GetAtomicInt(&g_metric_count);
+    int32_t id = -1;
+    for (int32_t i = 0; i < count; ++i) {
+        if (SDL_strcmp(g_metrics[i].name, name) == 0) {
+            id = i;
+            break;
+        }
+    }
+
+    if (id < 0 && count < METRICS_MAX_COUNT) {
+        g_metrics[count] = (metric_t){ .name = name, .sample = sample, .user = user };
+        SDL_SetAtomicInt(&g_metric_count, count + 1);
+        id = count;
+    }
+
+    SDL_UnlockSpinlock(&g_metrics_register_lock);
+
+    if (id < 0) {
+        log_limited(LOG_LEVEL_WARN, LOG_CATEGORY_APPLICATION, "Failed to register metric %s, all %d metrics are in use.", name, METRICS_MAX_COUNT);
+    }
+    return id;
+}
+
+void metrics_set(const int32_t id, const int64_t value)
+{
+    if (id >= 0) {
+        atomic_store_i64(&g_metrics[id].value, value);
+    }
+}
+
+void metrics_add(const int32_t id, const int64_t delta)
+{
+    if (id >= 0) {
+        atomic_add_i64(&g_metrics[id].value, delta);
+    }
+}
+
+void metrics_counter_add(metrics_counter_t *counter, const int64_t delta)
+{
+    int32_t id = SDL_GetAtomicInt(&counter->id) - 1;
+    if (id < 0) {
+        // Threads racing here all get the same id, registering an existing name only looks it up.
+        id = metrics_register(counter->name, NULL, NULL);
+        if (id < 0) {
+            return;
+        }
+        SDL_SetAtomicInt(&counter->id, id + 1);
+    }
+    metrics_add(id, delta);
+}
+
+void metrics_publish(void)
+{
+    metrics_published_t *published = &g_published;
+
+    const uint64_t now = SDL_GetTicksNS();
+    if (published->snapshot.publish_count > 0 && now - g_last_publish_ns < g_publish_interval_ns) {
+        return;
+    }
+    g_last_publish_ns = now;
+
+    // Sample functions may take a while, so they run before the snapshot is opened and readers start retrying.
+    const int32_t count = SDL_GetAtomicInt(&g_metric_count);
+    int64_t values[METRICS_MAX_COUNT];
+    for (int32_t i = 0; i < count; ++i) {
+        metric_t *metric = &g_metrics[i];
+        values[i] = metric->sample != NULL ? metric->sample(metric->user) : atomic_load_i64(&metric->value);
+    }
+
+    const uint32_t sequence = SDL_GetAtomicU32(&published->sequence);
+    SDL_SetAtomicU32(&published->sequence, sequence + 1);
+
+    metrics_snapshot_t *snapshot = &published->snapshot;
+    ++snapshot->publish_count;
+    snapshot->timestamp_ns = now;
+    snapshot->count = count;
+    for (int32_t i = 0; i < count; ++i) {
+        snapshot->names[i] = g_metrics[i].name;
+        snapshot->values[i] = values[i];
+    }
+
+    SDL_MemoryBarrierRelease();
+    SDL_SetAtomicU32(&published->sequence, sequence + 2);
+}
+
+bool metrics_read(metrics_snapshot_t *snapshot)
+{
+    metrics_published_t *published = &g_published;
+
+    for (;;) {
+        const uint32_t sequence = SDL_GetAtomicU32(&published->sequence);
+        if (sequence & 1) {
+            SDL_CPUPauseInstruction();
+            continue;
+        }
+
+        *snapshot = published->snapshot;
+
+        SDL_MemoryBarrierAcquire();
+        if (SDL_GetAtomicU32(&published->sequence) == sequence) {
+            break;
+        }
+    }
+
+    return snapshot->publish_count > 0;
+}
+
+int32_t metrics_format_text(const metrics_snapshot_t *snapshot, char *out, const int32_t capacity)
+{
+    if (capacity <= 0) {
+        return 0;
+    }
+
+    int32_t length = SDL_snprintf(out, capacity, "# bodies metrics, publish %llu at %llu ns\n", (unsigned long long)snapshot->publish_count, (unsigned long long)snapshot->timestamp_ns);
+    for (int32_t i = 0; i < snapshot->count && length < capacity; ++i) {
+        length += SDL_snprintf(out + length, capacity - length, "%s %lld\n", snapshot->names[i], (long long)snapshot->values[i]);
+    }
+
+    return SDL_min(length, capacity - 1);
+}
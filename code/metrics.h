@@ -0,0 +1,71 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Named integer metrics that can be read while the application runs. A metric either holds a value updated with
+// metrics_set and metrics_add, from any thread, or is sampled by calling a function on every publish.
+//
+// The frame thread calls metrics_publish once per frame. At most every publish interval it samples the metrics and
+// copies all values into a snapshot guarded by a sequence lock. Readers copy the snapshot and retry when a publish
+// overlapped the copy, so reading never blocks the frame thread.
+//
+// The optional server thread listens on a Unix domain socket and writes the newest snapshot to every client that
+// connects, in the Prometheus text format: one "name value" line per metric. `nc -U <path>` or
+// `socat - UNIX-CONNECT:<path>` scrapes it.
+
+#define METRICS_MAX_COUNT                   128
+#define METRICS_DEFAULT_PUBLISH_INTERVAL_MS 100
+
+typedef int64_t (*metrics_sample_t)(void *user);
+
+// A counter for hot paths, registered by its first update. After that an update is one atomic load and add, where
+// metrics_register takes the registry lock and compares names. Declare one static per metric with METRICS_COUNTER.
+typedef struct metrics_counter_t metrics_counter_t;
+struct metrics_counter_t
+{
+    const char *name;
+    SDL_AtomicInt id; // The metric id plus one, 0 until registered.
+};
+
+#define METRICS_COUNTER(counter_name) { .name = (counter_name) }
+
+typedef struct metrics_system_desc_t metrics_system_desc_t;
+struct metrics_system_desc_t
+{
+    int32_t publish_interval_ms; // 0 means METRICS_DEFAULT_PUBLISH_INTERVAL_MS.
+    const char *socket_path;     // Where the server listens, NULL to run without a server.
+};
+
+typedef struct metrics_snapshot_t metrics_snapshot_t;
+struct metrics_snapshot_t
+{
+    uint64_t publish_count;
+    uint64_t timestamp_ns; // SDL_GetTicksNS when published.
+    int32_t count;
+    const char *names[METRICS_MAX_COUNT];
+    int64_t values[METRICS_MAX_COUNT];
+};
+
+bool start_metrics_system(metrics_system_desc_t desc);
+void stop_metrics_system(void);
+
+// Returns the id of the metric called name, registering it first if needed, or -1 when the registry is full. Names
+// are not copied and should be string literals made of letters, digits and underscores. sample is only used when the
+// metric is first registered, NULL makes a metric that holds its value. Thread safe, so call sites may register lazily.
+int32_t metrics_register(const char *name, metrics_sample_t sample, void *user);
+// Both ignore an id of -1.
+void metrics_set(int32_t id, int64_t value);
+void metrics_add(int32_t id, int64_t delta);
+// Registers the counter's metric on first use, then adds delta like metrics_add. Thread safe.
+void metrics_counter_add(metrics_counter_t *counter, int64_t delta);
+
+void metrics_publish(void);
+// Copies the newest snapshot. Returns false when nothing was published yet.
+bool metrics_read(metrics_snapshot_t *snapshot);
+// Writes snapshot as Prometheus text into out, truncating to capacity. Returns the length of the text written.
+int32_t metrics_format_text(const metrics_snapshot_t *snapshot, char *out, int32_t capacity);
+
+#endif // METRICS_H
@@ -0,0 +1,272 @@
+#include "profile.h"
+
+#include <SDL3/SDL.h>
+
+#if FEATURE_PROFILER
+
+#include "atomic.h"
+#include "memory.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PROFILE_USE_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILE_USE_TSC 1
+#else
+#define PROFILE_USE_TSC 0
+#endif
+
+#define PROFILE_WRITE_BUFFER_SIZE (16 * 1024)
+#define PROFILE_NAME_MAX          256
+
+typedef struct profile_event_t profile_event_t;
+struct profile_event_t
+{
+    const char *name;
+    uint64_t begin;
+    uint64_t end;
+};
+
+// Single-producer ring of completed zones owned by one thread. The owner writes the event at head, then publishes it by
+// advancing head with a release store. The dump copies events without stopping the owner and afterwards discards the
+// ones head has lapped since, the same way a seqlock reader retries.
+typedef struct profile_thread_t profile_thread_t;
+struct profile_thread_t
+{
+    const char *name;
+    int32_t depth;
+    const char *open_names[PROFILE_MAX_DEPTH];
+    uint64_t open_begins[PROFILE_MAX_DEPTH];
+    _Alignas(CACHE_LINE_SIZE) int64_t head; // Zones completed so far, the newest is at head - 1.
+    profile_event_t events[PROFILE_EVENT_COUNT];
+};
+
+_Static_assert((PROFILE_EVENT_COUNT & (PROFILE_EVENT_COUNT - 1)) == 0, "PROFILE_EVENT_COUNT must be a power of two.");
+
+// Where and when the timestamp clock and SDL_GetPerformanceCounter were read together, set by the first thread to record.
+// With the time stamp counter the dump reads both clocks again and scales ticks by how far each has moved since.
+typedef struct profile_epoch_t profile_epoch_t;
+struct profile_epoch_t
+{
+    uint64_t ticks;
+    uint64_t counter;
+};
+
+// Slots are claimed on a thread's first zone and never given back, threads beyond PROFILE_MAX_THREADS are not recorded.
+static profile_thread_t g_profile_threads[PROFILE_MAX_THREADS];
+static SDL_AtomicInt g_profile_thread_count;
+static THREAD_LOCAL profile_thread_t *t_profile_thread;
+static THREAD_LOCAL bool t_profile_no_slot;
+static profile_epoch_t g_profile_epoch;
+static SDL_AtomicInt g_profile_epoch_state; // 0 unset, 1 being set, 2 set.
+
+// Reading the time stamp counter costs a fraction of SDL_GetPerformanceCounter, which matters with two reads per zone.
+static inline uint64_t profile_timestamp(void)
+{
+#if PROFILE_USE_TSC
+    return __rdtsc();
+#else
+    return SDL_GetPerformanceCounter();
+#endif
+}
+
+static profile_thread_t *profile_thread(void)
+{
+    if (t_profile_thread == NULL && !t_profile_no_slot) {
+        if (SDL_CompareAndSwapAtomicInt(&g_profile_epoch_state, 0, 1)) {
+            g_profile_epoch.counter = SDL_GetPerformanceCounter();
+            g_profile_epoch.ticks = profile_timestamp();
+            SDL_SetAtomicInt(&g_profile_epoch_state, 2);
+        }
+
+        const int32_t index = SDL_AddAtomicInt(&g_profile_thread_count, 1);
+        if (index >= PROFILE_MAX_THREADS) {
+            t_profile_no_slot = true;
+            return NULL;
+        }
+        t_profile_thread = &g_profile_threads[index];
+    }
+    return t_profile_thread;
+}
+
+void profile_begin(const char *name)
+{
+    profile_thread_t *thread = profile_thread();
+    if (thread == NULL) {
+        return;
+    }
+
+    const int32_t depth = thread->depth++;
+    if (depth < PROFILE_MAX_DEPTH) {
+        thread->open_names[depth] = name;
+        thread->open_begins[depth] = profile_timestamp();
+    }
+}
+
+void profile_end(void)
+{
+    const uint64_t end = profile_timestamp();
+
+    profile_thread_t *thread = t_profile_thread;
+    if (thread == NULL || thread->depth == 0) {
+        return;
+    }
+
+    const int32_t depth = --thread->depth;
+    if (depth >= PROFILE_MAX_DEPTH) {
+        return;
+    }
+
+    const int64_t head = thread->head;
+    profile_event_t *event = &thread->events[head & (PROFILE_EVENT_COUNT - 1)];
+    event->name = thread->open_names[depth];
+    event->begin = thread->open_begins[depth];
+    event->end = end;
+
+    SDL_MemoryBarrierRelease();
+    atomic_store_i64(&thread->head, head + 1);
+}
+
+void profile_set_thread_name(const char *name)
+{
+    profile_thread_t *thread = profile_thread();
+    if (thread != NULL) {
+        thread->name = name;
+    }
+}
+
+// O--------------------------------------------------------------------------O
+// | Chrome Trace                                                             |
+// O--------------------------------------------------------------------------O
+
+typedef struct profile_writer_t profile_writer_t;
+struct profile_writer_t
+{
+    SDL_IOStream *io;
+    bool failed;
+    size_t used;
+    char buffer[PROFILE_WRITE_BUFFER_SIZE];
+};
+
+static void profile_writer_flush(profile_writer_t *writer)
+{
+    if (writer->used > 0 && !writer->failed && SDL_WriteIO(writer->io, writer->buffer, writer->used) != writer->used) {
+        writer->failed = true;
+    }
+    writer->used = 0;
+}
+
+static void profile_write(profile_writer_t *writer, const char *fmt, ...)
+{
+    for (int32_t attempt = 0; attempt < 2; ++attempt) {
+        const size_t available = sizeof(writer->buffer) - writer->used;
+
+        va_list ap;
+        va_start(ap, fmt);
+        const int32_t length = SDL_vsnprintf(writer->buffer + writer->used, available, fmt, ap);
+        va_end(ap);
+
+        if (length >= 0 && (size_t)length < available) {
+            writer->used += length;
+            return;
+        }
+        profile_writer_flush(writer);
+    }
+}
+
+// Zone names are expected to be plain identifiers, anything JSON would choke on is replaced.
+static const char *profile_escape_name(const char *name, char *out, const size_t capacity)
+{
+    size_t length = 0;
+    for (; name[length] != '\0' && length + 1 < capacity; ++length) {
+        const char c = name[length];
+        out[length] = (c == '"' || c == '\\' || (unsigned char)c < 0x20) ? '_' : c;
+    }
+    out[length] = '\0';
+    return out;
+}
+
+bool profile_dump_chrome_trace(const char *path)
+{
+    SDL_IOStream *io = SDL_IOFromFile(path, "wb");
+    if (io == NULL) {
+        return false;
+    }
+
+    profile_writer_t *writer = SDL_malloc(sizeof(profile_writer_t));
+    if (writer == NULL) {
+        SDL_CloseIO(io);
+        return false;
+    }
+    writer->io = io;
+    writer->failed = false;
+    writer->used = 0;
+
+    // Microseconds since the performance counter started, so traces from other tools line up.
+    const double us_per_counter = 1e6 / (double)SDL_GetPerformanceFrequency();
+    const profile_epoch_t epoch = g_profile_epoch;
+    const double epoch_us = (double)epoch.counter * us_per_counter;
+    double us_per_tick = us_per_counter;
+#if PROFILE_USE_TSC
+    const uint64_t now_counter = SDL_GetPerformanceCounter();
+    const uint64_t now_ticks = profile_timestamp();
+    if (now_ticks > epoch.ticks) {
+        us_per_tick = (double)(now_counter - epoch.counter) * us_per_counter / (double)(now_ticks - epoch.ticks);
+    }
+#endif
+    char name[PROFILE_NAME_MAX];
+
+    profile_write(writer, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    profile_write(writer, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"bodies\"}}");
+
+    const int32_t thread_count = SDL_GetAtomicInt(&g_profile_epoch_state) == 2 ? SDL_min(SDL_GetAtomicInt(&g_profile_thread_count), PROFILE_MAX_THREADS) : 0;
+    for (int32_t t = 0; t < thread_count; ++t) {
+        profile_thread_t *thread = &g_profile_threads[t];
+
+        const int64_t head = atomic_load_i64(&thread->head);
+        SDL_MemoryBarrierAcquire();
+        if (head == 0) {
+            continue;
+        }
+
+        if (thread->name != NULL) {
+            profile_write(writer, ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", t, profile_escape_name(thread->name, name, sizeof(name)));
+        }
+
+        for (int64_t i = SDL_max(head - PROFILE_EVENT_COUNT, 0); i < head; ++i) {
+            const profile_event_t event = thread->events[i & (PROFILE_EVENT_COUNT - 1)];
+
+            // The owner may have lapped the copy, and it may be writing the slot after its newest zone right now.
+            SDL_MemoryBarrierAcquire();
+            if (atomic_load_i64(&thread->head) - i >= PROFILE_EVENT_COUNT) {
+                continue;
+            }
+
+            const double ts = epoch_us + (double)(int64_t)(event.begin - epoch.ticks) * us_per_tick;
+            const double dur = (double)(event.end - event.begin) * us_per_tick;
+            profile_write(writer, ",\n{\"ph\":\"X\",\"name\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", profile_escape_name(event.name, name, sizeof(name)), t, ts, dur);
+        }
+    }
+
+    profile_write(writer, "\n]}\n");
+    profile_writer_flush(writer);
+
+    const bool failed = writer->failed;
+    SDL_free(writer);
+
+    if (!SDL_CloseIO(io) || failed) {
+        return SDL_SetError("Failed to write %s", path);
+    }
+    return true;
+}
+
+#else
+
+bool profile_dump_chrome_trace(const char *path)
+{
+    (void)path;
+    return SDL_SetError("Profiling is disabled, build with FEATURE_PROFILER");
+}
+
+#endif // FEATURE_PROFILER
@@ -0,0 +1,44 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// CPU profiler recording named zones. Each thread writes the zones it completes into its own ring buffer, holding the
+// last PROFILE_EVENT_COUNT zones, so recording never takes a lock and never allocates. Timestamps come from the time
+// stamp counter on x86 and SDL_GetPerformanceCounter elsewhere. The rings can be dumped at any time as a Chrome
+// trace-event JSON file, which opens in chrome://tracing, Perfetto or Speedscope.
+//
+// Zone names are not copied and must outlive the dump, which holds for string literals.
+//
+// Everything compiles out when FEATURE_PROFILER is off; profile_dump_chrome_trace then writes nothing and fails.
+
+#define PROFILE_MAX_THREADS 16
+#define PROFILE_MAX_DEPTH   32    // Nested zones deeper than this are not recorded.
+#define PROFILE_EVENT_COUNT 16384 // Per thread, must be a power of two.
+
+#if FEATURE_PROFILER
+void profile_begin(const char *name);
+void profile_end(void);
+// Names the calling thread in the trace. Call it before the first zone on that thread.
+void profile_set_thread_name(const char *name);
+
+#define PROFILE_BEGIN(name) profile_begin(name)
+#define PROFILE_END()       profile_end()
+// Profiles the statement or block that follows. Leaving the block with break, continue, return or goto skips the end of
+// the zone, use PROFILE_BEGIN and PROFILE_END around code that does.
+#define PROFILE_SCOPE(name) for (int32_t profile_scope_ = (profile_begin(name), 0); profile_scope_ == 0; profile_end(), profile_scope_ = 1)
+#else
+static inline void profile_set_thread_name(const char *name) { (void)name; }
+
+// The name is only looked at by sizeof, so it is not evaluated but still counts as used.
+#define PROFILE_BEGIN(name) ((void)sizeof(name))
+#define PROFILE_END()       ((void)0)
+#define PROFILE_SCOPE(name)
+#endif
+
+// Writes the zones currently held by every thread's ring. Threads may keep recording while this runs, zones they
+// overwrite during the dump are left out.
+bool profile_dump_chrome_trace(const char *path);
+
+#endif // PROFILE_H
@@ -0,0 +1,322 @@
+#include "texture_cache.h"
+
+#include <SDL3/SDL.h>
+
+#include "log.h"
+#include "memory.h"
+#include "metrics.h"
+#include "profile.h"
+
+#define TEXTURE_CACHE_PATH_MAX  512
+#define TEXTURE_FILE_EXTENSION  ".btex"
+#define TEXTURE_BYTES_PER_PIXEL 4
+
+typedef struct texture_cache_t texture_cache_t;
+struct texture_cache_t
+{
+    char directory[TEXTURE_CACHE_PATH_MAX]; // Empty when cooked files are not kept.
+};
+
+static texture_cache_t g_texture_cache;
+static metrics_counter_t g_texture_cache_hits_metric = METRICS_COUNTER("texture_cache_hits_total");
+static metrics_counter_t g_texture_cache_cooks_metric = METRICS_COUNTER("texture_cache_cooks_total");
+
+void start_texture_cache(const texture_cache_desc_t desc)
+{
+    texture_cache_t *cache = &g_texture_cache;
+    cache->directory[0] = '\0';
+
+    if (desc.directory == NULL) {
+        return;
+    }
+
+    if (SDL_strlcpy(cache->directory, desc.directory, sizeof(cache->directory)) >= sizeof(cache->directory)) {
+        log_warn(LOG_CATEGORY_IMAGE, "Texture cache directory %s is too long, textures are cooked on every load.", desc.directory);
+        cache->directory[0] = '\0';
+        return;
+    }
+
+    // Fails when the directory already exists, anything worse shows up when the first cooked file is written.
+    SDL_CreateDirectory(cache->directory);
+}
+
+void stop_texture_cache(void)
+{
+    g_texture_cache.directory[0] = '\0';
+}
+
+// The cooked file of images/mondrian.png is images_mondrian.png.btex, directly in the cache directory.
+static bool get_texture_file_path(const char *filename, char *path, const size_t path_size)
+{
+    const texture_cache_t *cache = &g_texture_cache;
+    if (cache->directory[0] == '\0') {
+        return false;
+    }
+
+    const int32_t len = SDL_snprintf(path, path_size, "%s/%s%s", cache->directory, filename, TEXTURE_FILE_EXTENSION);
+    if (len < 0 || (size_t)len >= path_size) {
+        return false;
+    }
+
+    for (char *c = path + SDL_strlen(cache->directory) + 1; *c != '\0'; ++c) {
+        if (*c == '/' || *c == '\\') {
+            *c = '_';
+        }
+    }
+    return true;
+}
+
+static uint64_t rotate_left(const uint64_t x, const int32_t r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+// Eight bytes at a time with the mixing of MurmurHash3, a source file is hashed on every load so this has to stay well
+// below the cost of decoding it.
+static uint64_t hash_source(const void *data, const size_t size)
+{
+    const uint8_t *bytes = data;
+    uint64_t hash = 0x9E3779B97F4A7C15ULL ^ size;
+
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        SDL_memcpy(&word, bytes + i, sizeof(word));
+        hash ^= rotate_left(word * 0x87C37B91114253D5ULL, 31) * 0x4CF5AD432745937FULL;
+        hash = rotate_left(hash, 27) * 5 + 0x52DCE729;
+    }
+
+    uint64_t tail = 0;
+    for (size_t shift = 0; i < size; ++i, shift += 8) {
+        tail |= (uint64_t)bytes[i] << shift;
+    }
+    hash ^= rotate_left(tail * 0x87C37B91114253D5ULL, 31) * 0x4CF5AD432745937FULL;
+
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// Checks that data holds a complete cooked file of the given source and points the texture's levels into it.
+static bool read_texture_file(const void *data, const size_t size, const uint64_t source_hash, const uint64_t source_size, cooked_texture_t *texture)
+{
+    texture_file_header_t header;
+    if (data == NULL || size < sizeof(header)) {
+        return false;
+    }
+    SDL_memcpy(&header, data, sizeof(header));
+
+    if (header.magic != TEXTURE_FILE_MAGIC || header.version != TEXTURE_FILE_VERSION || header.source_hash != source_hash || header.source_size != source_size) {
+        return false;
+    }
+    if (header.format != IMAGE_FORMAT_R8G8B8A8_UNORM || header.level_count == 0 || header.level_count > TEXTURE_MAX_LEVELS) {
+        return false;
+    }
+
+    uint64_t offset = sizeof(header);
+    for (uint32_t i = 0; i < header.level_count; ++i) {
+        const texture_file_level_t *level = &header.levels[i];
+        const uint32_t width = SDL_max(header.width >> i, 1);
+        const uint32_t height = SDL_max(header.height >> i, 1);
+        if (level->offset != offset || level->width != width || level->height != height || level->size != (uint64_t)width * height * TEXTURE_BYTES_PER_PIXEL || level->size > size - offset) {
+            return false;
+        }
+
+        texture->levels[i] = (texture_level_t){
+            .data = (const uint8_t *)data + level->offset,
+            .size = level->size,
+            .width = (int32_t)width,
+            .height = (int32_t)height,
+        };
+        offset += level->size;
+    }
+
+    texture->width = (int32_t)header.width;
+    texture->height = (int32_t)header.height;
+    texture->format = (image_format_t)header.format;
+    texture->level_count = (int32_t)header.level_count;
+    texture->data_size = offset - sizeof(header);
+    return true;
+}
+
+// The source rows or columns behind output index i of a level size wide: 2i and 2i + 1, and also 2i + 2 for the last
+// one when the source is odd, so no source pixel is dropped. A source of one pixel maps to itself.
+static uint32_t downsample_span(const uint32_t i, const uint32_t size, const uint32_t src_size)
+{
+    if (src_size == 1) {
+        return 1;
+    }
+    return i == size - 1 && (src_size & 1) ? 3 : 2;
+}
+
+// Box filters src into dst, half its size rounded down. The last row or column of an odd sized level is folded into
+// the last one of dst, which then averages three source rows or columns.
+static void downsample_level(const uint8_t *src, const uint32_t src_width, const uint32_t src_height, uint8_t *dst, const uint32_t width, const uint32_t height)
+{
+    const size_t src_pitch = (size_t)src_width * TEXTURE_BYTES_PER_PIXEL;
+
+    for (uint32_t y = 0; y < height; ++y) {
+        const uint32_t rows = downsample_span(y, height, src_height);
+
+        for (uint32_t x = 0; x < width; ++x) {
+            const uint32_t columns = downsample_span(x, width, src_width);
+            const uint32_t count = rows * columns;
+
+            uint32_t sums[TEXTURE_BYTES_PER_PIXEL] = { 0 };
+            for (uint32_t sy = 0; sy < rows; ++sy) {
+                const uint8_t *pixel = src + (size_t)(y * 2 + sy) * src_pitch + (size_t)x * 2 * TEXTURE_BYTES_PER_PIXEL;
+                for (uint32_t sx = 0; sx < columns; ++sx, pixel += TEXTURE_BYTES_PER_PIXEL) {
+                    for (int32_t c = 0; c < TEXTURE_BYTES_PER_PIXEL; ++c) {
+                        sums[c] += pixel[c];
+                    }
+                }
+            }
+
+            for (int32_t c = 0; c < TEXTURE_BYTES_PER_PIXEL; ++c) {
+                *dst++ = (uint8_t)((sums[c] + count / 2) / count);
+            }
+        }
+    }
+}
+
+// Decodes source and builds its mip chain in a new system heap block laid out exactly like the cooked file. Returns
+// NULL when decoding failed.
+static void *cook_texture(const image_source_t *source, const uint64_t source_hash, size_t *cooked_size)
+{
+    texture_file_header_t header = {
+        .magic = TEXTURE_FILE_MAGIC,
+        .version = TEXTURE_FILE_VERSION,
+        .source_hash = source_hash,
+        .source_size = source->file.size,
+        .width = (uint32_t)source->width,
+        .height = (uint32_t)source->height,
+        .format = IMAGE_FORMAT_R8G8B8A8_UNORM,
+    };
+
+    uint64_t offset = sizeof(header);
+    for (uint32_t i = 0; i < TEXTURE_MAX_LEVELS; ++i) {
+        const uint32_t width = SDL_max(header.width >> i, 1);
+        const uint32_t height = SDL_max(header.height >> i, 1);
+        header.levels[i] = (texture_file_level_t){
+            .offset = offset,
+            .size = (uint64_t)width * height * TEXTURE_BYTES_PER_PIXEL,
+            .width = width,
+            .height = height,
+        };
+        offset += header.levels[i].size;
+        header.level_count = i + 1;
+
+        if (width == 1 && height == 1) {
+            break;
+        }
+    }
+
+    heap_allocator_t *heap = mem_system_allocator();
+    memory_tag_t tag = mem_set_tag(MEMORY_TAG_IMAGE);
+    uint8_t *cooked = heap_alloc(heap, offset, MEM_DEFAULT_ALIGN);
+    mem_set_tag(tag);
+    if (cooked == NULL) {
+        log_error(LOG_CATEGORY_IMAGE, "Failed to allocate %llu bytes to cook a texture.", (unsigned long long)offset);
+        return NULL;
+    }
+
+    // The largest level is decoded into its place in the file, every other level is filtered down from the one before it.
+    if (!decode_image(source, cooked + header.levels[0].offset, source->width * TEXTURE_BYTES_PER_PIXEL)) {
+        heap_dealloc(heap, cooked);
+        return NULL;
+    }
+    for (uint32_t i = 1; i < header.level_count; ++i) {
+        const texture_file_level_t *src = &header.levels[i - 1];
+        const texture_file_level_t *dst = &header.levels[i];
+        downsample_level(cooked + src->offset, src->width, src->height, cooked + dst->offset, dst->width, dst->height);
+    }
+
+    SDL_memcpy(cooked, &header, sizeof(header));
+    *cooked_size = offset;
+    return cooked;
+}
+
+// Writes next to path first and renames over it, so a cooked file is either complete or not there at all.
+static bool write_texture_file(const char *path, const void *cooked, const size_t size)
+{
+    char temp_path[TEXTURE_CACHE_PATH_MAX + 8];
+    SDL_snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    SDL_IOStream *io = SDL_IOFromFile(temp_path, "wb");
+    if (io == NULL) {
+        return false;
+    }
+
+    const bool written = SDL_WriteIO(io, cooked, size) == size;
+    if (!SDL_CloseIO(io) || !written || !SDL_RenamePath(temp_path, path)) {
+        SDL_RemovePath(temp_path);
+        return false;
+    }
+    return true;
+}
+
+bool load_cooked_texture(const char *filename, cooked_texture_t *texture)
+{
+    *texture = (cooked_texture_t){};
+
+    PROFILE_BEGIN("load_cooked_texture");
+
+    image_source_t source;
+    if (!open_image(filename, &source)) {
+        PROFILE_END();
+        return false;
+    }
+
+    const uint64_t source_hash = hash_source(source.file.data, source.file.size);
+    const uint64_t source_size = source.file.size;
+
+    char path[TEXTURE_CACHE_PATH_MAX];
+    const bool cached = get_texture_file_path(filename, path, sizeof(path));
+    if (cached && map_file(path, FILE_ACCESS_SEQUENTIAL, &texture->file)) {
+        if (read_texture_file(texture->file.data, texture->file.size, source_hash, source_size, texture)) {
+            close_image(&source);
+            metrics_counter_add(&g_texture_cache_hits_metric, 1);
+            PROFILE_END();
+            return true;
+        }
+
+        log_info(LOG_CATEGORY_IMAGE, "Cooked texture %s is stale, cooking it again.", path);
+        unmap_file(&texture->file);
+    }
+
+    size_t cooked_size = 0;
+    void *cooked = cook_texture(&source, source_hash, &cooked_size);
+    close_image(&source);
+    if (cooked == NULL) {
+        log_error(LOG_CATEGORY_IMAGE, "Failed to cook texture %s.", filename);
+        PROFILE_END();
+        return false;
+    }
+    metrics_counter_add(&g_texture_cache_cooks_metric, 1);
+
+    if (cached && !write_texture_file(path, cooked, cooked_size)) {
+        log_warn(LOG_CATEGORY_IMAGE, "Failed to write cooked texture %s, %s.", path, SDL_GetError());
+    }
+
+    read_texture_file(cooked, cooked_size, source_hash, source_size, texture);
+    texture->cooked = cooked;
+
+    PROFILE_END();
+    return true;
+}
+
+void free_cooked_texture(cooked_texture_t *texture)
+{
+    if (texture == NULL) {
+        return;
+    }
+
+    unmap_file(&texture->file);
+    if (texture->cooked != NULL) {
+        heap_dealloc(mem_system_allocator(), texture->cooked);
+    }
+    *texture = (cooked_texture_t){};
+}
@@ -0,0 +1,83 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "file.h"
+#include "image.h"
+
+// Cooked textures skip decoding at startup. The first time an image is loaded it is decoded, its mip chain is built
+// and both are written to the cache directory as one cooked file: a texture_file_header_t followed by the levels,
+// tightly packed from the largest down. Later loads map that file and hand out pointers into it, ready to be copied
+// into a transfer buffer as they are.
+//
+// A cooked file is keyed by a hash of its source file's contents, so an edited source is cooked again on its next load.
+// Cooked files are in the native byte order of the machine that wrote them and only meant for that machine's cache.
+
+#define TEXTURE_MAX_LEVELS   16
+#define TEXTURE_FILE_MAGIC   0x58455442u // "BTEX"
+#define TEXTURE_FILE_VERSION 2
+
+typedef struct texture_file_level_t texture_file_level_t;
+struct texture_file_level_t
+{
+    uint64_t offset; // From the start of the file.
+    uint64_t size;
+    uint32_t width;
+    uint32_t height;
+};
+
+typedef struct texture_file_header_t texture_file_header_t;
+struct texture_file_header_t
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_hash;
+    uint64_t source_size;
+    uint32_t width;
+    uint32_t height;
+    uint32_t format; // image_format_t
+    uint32_t level_count;
+    texture_file_level_t levels[TEXTURE_MAX_LEVELS];
+};
+
+typedef struct texture_cache_desc_t texture_cache_desc_t;
+struct texture_cache_desc_t
+{
+    const char *directory; // Where cooked files are kept, created when missing. NULL cooks every load in memory.
+};
+
+typedef struct texture_level_t texture_level_t;
+struct texture_level_t
+{
+    const void *data;
+    size_t size;
+    int32_t width;
+    int32_t height;
+};
+
+typedef struct cooked_texture_t cooked_texture_t;
+struct cooked_texture_t
+{
+    int32_t width;
+    int32_t height;
+    image_format_t format;
+    int32_t level_count;
+    texture_level_t levels[TEXTURE_MAX_LEVELS]; // Contiguous, levels[0].data starts data_size bytes of pixels.
+    size_t data_size;
+    file_view_t file; // The cooked file, when it came from the cache.
+    void *cooked;     // The cooked file on the system heap, when this load cooked it.
+};
+
+void start_texture_cache(texture_cache_desc_t desc);
+void stop_texture_cache(void);
+
+// Loads filename, relative to the data directory like load_image, from its cooked file and cooks it first when that is
+// missing or stale. Writing the cooked file is best effort, the texture is still returned when it fails. Safe to call
+// from any thread, but two threads should not load the same image at the same time.
+bool load_cooked_texture(const char *filename, cooked_texture_t *texture);
+void free_cooked_texture(cooked_texture_t *texture);
+
+#endif // TEXTURE_CACHE_H
@@ -0,0 +1,41 @@
+#include <SDL3/SDL.h>
+#include <stdio.h>
+
+#include "log_binary.h"
+
+#define DECODE_TEXT_SIZE 4096
+
+// Renders a binary log written with log_system_desc_t.binary_path as text, one message per line, with the time since
+// the log was opened.
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <binary log>\n", argv[0]);
+        return 1;
+    }
+
+    log_binary_reader_t reader;
+    if (!log_binary_reader_open(&reader, argv[1])) {
+        fprintf(stderr, "Failed to open binary log %s, %s\n", argv[1], SDL_GetError());
+        return 1;
+    }
+
+    int32_t count = 0;
+    log_binary_message_t message;
+    while (log_binary_read(&reader, &message)) {
+        char text[DECODE_TEXT_SIZE];
+        log_binary_format(message.fmt, message.args, message.args_size, text, sizeof(text));
+
+        const double seconds = (double)(message.timestamp_ns - reader.start_ns) / 1e9;
+        printf("%12.6f %-11s %-8s %s\n", seconds, log_binary_category_name(message.category), log_binary_priority_name(message.priority), text);
+        ++count;
+    }
+
+    const int exit_code = reader.offset < reader.size ? 1 : 0;
+    if (exit_code != 0) {
+        fprintf(stderr, "Stopped at byte %llu of %llu, the rest of the log is damaged.\n", (unsigned long long)reader.offset, (unsigned long long)reader.size);
+    }
+
+    log_binary_reader_close(&reader);
+    return exit_code;
+}
@@ -7,7 +7,9 @@
 
 #include "application.h"
 #include "error.h"
+#include "frame_stats.h"
 #include "log.h"
+#include "profile.h"
 
 static SDL_Window *g_window;
 static bool g_was_close_requested;
@@ -41,8 +43,14 @@ void destroy_window(void)
 
 bool run_window_event_loop(void)
 {
+    PROFILE_BEGIN("run_window_event_loop");
+
+    begin_application_frame();
+
     g_size_changed = false;
 
+    frame_stats_begin(FRAME_STAT_EVENTS);
+
     SDL_Event event;
     while (SDL_PollEvent(&event)) {
         switch (event.type) {
@@ -68,7 +76,9 @@ bool run_window_event_loop(void)
             break;
         }
     }
+    frame_stats_end(FRAME_STAT_EVENTS);
 
+    PROFILE_END();
     return g_keep_running;
 }
 